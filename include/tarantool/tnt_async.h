@@ -0,0 +1,237 @@
+#ifndef TNT_ASYNC_H_INCLUDED
+#define TNT_ASYNC_H_INCLUDED
+
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_async.h
+ * \brief Asynchronous reply dispatching by request sync id
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <tarantool/tnt_net.h>
+
+struct tnt_stream;
+struct tnt_reply;
+
+/**
+ * \brief Callback type for request completion
+ *
+ * \param s     stream, that request was sent to
+ * \param r     reply object (NULL if request failed without reply)
+ * \param error TNT_EOK if reply was received, error code otherwise
+ * \param arg   callback context, that was passed on registration
+ *
+ * Reply object is freed after callback returns. To keep the reply
+ * buffer, copy the reply structure and set r->buf to NULL.
+ *
+ * Callback is executed for every chunk (TNT_CHUNK) of the request,
+ * and it's unregistered after final reply.
+ */
+typedef void (*tnt_async_cb_t)(struct tnt_stream *s, struct tnt_reply *r,
+			       enum tnt_error error, void *arg);
+
+/**
+ * \brief Register completion callback for request with given sync
+ *
+ * \param s    tnt_net stream pointer
+ * \param sync request sync id
+ * \param cb   callback to execute on reply
+ * \param arg  callback context
+ *
+ * \returns status
+ * \retval  0 ok
+ * \retval -1 oom or sync is already registered
+ *
+ * \code{.c}
+ * tnt_select(s, 512, 0, 1, 0, TNT_ITER_EQ, key);
+ * tnt_async_register(s, tnt_async_last(s), on_select, ctx);
+ * tnt_call(s, "slow", 4, args);
+ * tnt_async_register(s, tnt_async_last(s), on_call, ctx);
+ * tnt_async_dispatch(s, 0);
+ * \endcode
+ */
+int
+tnt_async_register(struct tnt_stream *s, uint64_t sync, tnt_async_cb_t cb,
+		   void *arg);
+
+/**
+ * \brief Get sync id of the last request written into stream
+ */
+uint64_t
+tnt_async_last(struct tnt_stream *s);
+
+/**
+ * \brief Unregister callback for request with given sync
+ *
+ * Reply for this request will be dropped, when it arrives.
+ *
+ * \retval  0 ok
+ * \retval -1 request wasn't registered
+ */
+int
+tnt_async_cancel(struct tnt_stream *s, uint64_t sync);
+
+/**
+ * \brief Set deadline for request with registered callback
+ *
+ * If there's no reply within \a timeout milliseconds, callback is executed
+ * with TNT_ETMOUT and unregistered, and reply is dropped by its sync, when
+ * it arrives. Connection stays usable. Deadlines are tracked in a
+ * hierarchical timer wheel with 1ms tick, and are checked when replies are
+ * dispatched (\sa tnt_async_expire). Setting deadline again re-arms it.
+ *
+ * \param s       tnt_net stream pointer
+ * \param sync    request sync id
+ * \param timeout timeout in milliseconds
+ *
+ * \retval  0 ok
+ * \retval -1 oom or request wasn't registered
+ *
+ * \code{.c}
+ * tnt_select(s, 512, 0, 1, 0, TNT_ITER_EQ, key);
+ * tnt_async_register(s, tnt_async_last(s), on_select, ctx);
+ * tnt_async_deadline(s, tnt_async_last(s), 50);
+ * struct pollfd pfd = { tnt_fd(s), POLLIN, 0 };
+ * while (tnt_async_count(s) > 0) {
+ * 	poll(&pfd, 1, tnt_async_timeout(s));
+ * 	tnt_process_io(s);
+ * }
+ * \endcode
+ */
+int
+tnt_async_deadline(struct tnt_stream *s, uint64_t sync, uint32_t timeout);
+
+/**
+ * \brief Fail requests, that are past their deadlines
+ *
+ * Callbacks of expired requests are executed with TNT_ETMOUT.
+ *
+ * \returns count of expired requests
+ */
+int
+tnt_async_expire(struct tnt_stream *s);
+
+/**
+ * \brief Get time till the nearest deadline (to use as poll timeout)
+ *
+ * \returns timeout in milliseconds
+ * \retval  -1 no deadlines are set
+ */
+int
+tnt_async_timeout(struct tnt_stream *s);
+
+/**
+ * \brief Read replies from stream and execute their callbacks
+ *
+ * Send buffer is flushed before reading. Replies are processed in the
+ * order they arrive, replies without registered callback are dropped.
+ * On network error all pending callbacks are executed with error set.
+ * Then requests past their deadlines are failed (\sa tnt_async_deadline).
+ *
+ * In blocking mode with \a count 0 replies are read until there's no
+ * requests in flight, so late replies of expired requests are waited for
+ * too; use non-blocking stream to keep latency budgets.
+ *
+ * \param s     tnt_net stream pointer
+ * \param count maximum count of replies to process (0 - process
+ *              replies until there's no requests in flight)
+ *
+ * \returns count of processed replies and expired requests
+ * \retval  -1 network/parsing error
+ */
+int
+tnt_async_dispatch(struct tnt_stream *s, int count);
+
+/**
+ * \brief Get count of requests with registered callbacks
+ */
+uint32_t
+tnt_async_count(struct tnt_stream *s);
+
+/**
+ * \internal
+ * \brief Execute callback for reply, if one is registered
+ *
+ * \retval 1 callback was executed
+ * \retval 0 no callback registered for this reply
+ */
+int
+tnt_async_complete(struct tnt_stream *s, struct tnt_reply *r);
+
+/**
+ * \internal
+ * \brief Same as tnt_async_dispatch, but without flushing send buffer
+ */
+int
+tnt_async_process(struct tnt_stream *s, int count);
+
+/**
+ * \internal
+ * \brief Check, if callback is registered for request
+ */
+int
+tnt_async_pending(struct tnt_stream *s, uint64_t sync);
+
+/**
+ * \internal
+ * \brief Execute callback of request, that was lost on reconnect
+ *
+ * \retval 1 callback was executed with TNT_ELOST
+ * \retval 0 no callback registered for this request
+ */
+int
+tnt_async_lost(struct tnt_stream *s, uint64_t sync);
+
+/**
+ * \internal
+ * \brief Execute all pending callbacks with error and unregister them
+ */
+void
+tnt_async_fail(struct tnt_stream *s, enum tnt_error error);
+
+/**
+ * \internal
+ * \brief Free pending requests storage
+ */
+void
+tnt_async_free(struct tnt_stream *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_ASYNC_H_INCLUDED */
@@ -0,0 +1,176 @@
+#ifndef TNT_BULK_H_INCLUDED
+#define TNT_BULK_H_INCLUDED
+
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_bulk.h
+ * \brief Pipelined bulk loading of tuples
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <tarantool/tnt_proto.h>
+
+struct tnt_stream;
+struct tnt_reply;
+
+/**
+ * \brief Tuple source callback
+ *
+ * \param tuple empty tnt_object stream to encode next tuple into
+ * \param arg   callback context
+ *
+ * \retval 1 tuple is encoded
+ * \retval 0 no tuples left
+ */
+typedef int (*tnt_bulk_source_t)(struct tnt_stream *tuple, void *arg);
+
+/**
+ * \brief Tuple error callback
+ *
+ * \param n   number of tuple in order of source (starting from 0)
+ * \param r   reply with error
+ * \param arg callback context
+ */
+typedef void (*tnt_bulk_error_t)(uint64_t n, struct tnt_reply *r, void *arg);
+
+/**
+ * \brief Bulk loader
+ *
+ * Loader sends insert/replace requests for tuples from source, keeping at
+ * most 'window' of them in flight. When window is full, send buffer is
+ * flushed and replies are read, until half of window is free again.
+ * Failed tuples are reported to error callback, and loading continues.
+ */
+struct tnt_bulk {
+	struct tnt_stream *s; /*!< tnt_net stream to load into */
+	uint32_t space; /*!< space number */
+	enum tnt_request_t op; /*!< TNT_OP_INSERT or TNT_OP_REPLACE */
+	uint32_t window; /*!< maximal count of requests in flight */
+	tnt_bulk_source_t source; /*!< tuple source */
+	void *source_arg; /*!< tuple source context */
+	tnt_bulk_error_t error; /*!< tuple error callback, maybe NULL */
+	void *error_arg; /*!< tuple error callback context */
+	struct tnt_stream *tuple; /*!< tuple, that's filled by source */
+	uint64_t sent; /*!< count of sent tuples */
+	uint64_t loaded; /*!< count of successfully loaded tuples */
+	uint64_t failed; /*!< count of tuples, that failed */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create bulk loader
+ *
+ * \param b     loader pointer, maybe NULL
+ * \param s     connected tnt_net stream
+ * \param space space number
+ * \param op    TNT_OP_INSERT or TNT_OP_REPLACE
+ *
+ * If loader pointer is NULL, then new loader will be allocated. Window is
+ * 1024 requests by default.
+ *
+ * \returns loader pointer
+ * \retval  NULL oom or bad operation
+ *
+ * \code{.c}
+ * static int
+ * next_tuple(struct tnt_stream *tuple, void *arg)
+ * {
+ * 	int *i = arg;
+ * 	if (*i == 1000000)
+ * 		return 0;
+ * 	tnt_object_format(tuple, "[%d%s]", *i, "value");
+ * 	++*i;
+ * 	return 1;
+ * }
+ *
+ * int i = 0;
+ * struct tnt_bulk *b = tnt_bulk(NULL, s, 512, TNT_OP_REPLACE);
+ * tnt_bulk_source(b, next_tuple, &i);
+ * tnt_bulk_on_error(b, log_error, NULL);
+ * if (tnt_bulk_run(b) == -1)
+ * 	fprintf(stderr, "%s\n", tnt_strerror(s));
+ * printf("loaded %lu, failed %lu\n", b->loaded, b->failed);
+ * tnt_bulk_free(b);
+ * \endcode
+ */
+struct tnt_bulk *
+tnt_bulk(struct tnt_bulk *b, struct tnt_stream *s, uint32_t space,
+	 enum tnt_request_t op);
+
+/**
+ * \brief Set maximal count of requests in flight (must be > 0)
+ */
+void
+tnt_bulk_window(struct tnt_bulk *b, uint32_t window);
+
+/**
+ * \brief Set tuple source
+ */
+void
+tnt_bulk_source(struct tnt_bulk *b, tnt_bulk_source_t source, void *arg);
+
+/**
+ * \brief Set callback for failed tuples
+ */
+void
+tnt_bulk_on_error(struct tnt_bulk *b, tnt_bulk_error_t error, void *arg);
+
+/**
+ * \brief Load all tuples from source
+ *
+ * Stream must have no requests in flight. Non-blocking streams are waited
+ * for with poll(2).
+ *
+ * \returns status
+ * \retval  0 all tuples are sent and their replies are received
+ * \retval -1 network error (stream error is set), tuples, that were in
+ *            flight, are neither loaded nor failed
+ */
+int
+tnt_bulk_run(struct tnt_bulk *b);
+
+/**
+ * \brief Free bulk loader
+ */
+void
+tnt_bulk_free(struct tnt_bulk *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_BULK_H_INCLUDED */
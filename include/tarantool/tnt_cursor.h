@@ -0,0 +1,178 @@
+#ifndef TNT_CURSOR_H_INCLUDED
+#define TNT_CURSOR_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_cursor.h
+ * \brief Paginated full scan over an index
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tarantool/tnt_reply.h>
+
+struct tnt_stream;
+
+/**
+ * \brief Index cursor
+ *
+ * Cursor selects index in pages of fixed size. Every next page is selected
+ * with TNT_ITER_GT from key of the last tuple of previous page (for
+ * non-unique indexes - with TNT_ITER_GE, skipping tuples with this key,
+ * that were seen already), so memory usage doesn't depend on space size.
+ * Request for the next page is sent as soon as current page is received,
+ * so it's transferred while current page is processed.
+ *
+ * Key parts are taken from index definition in stream's schema.
+ */
+struct tnt_cursor {
+	struct tnt_stream *s; /*!< tnt_net stream to select from */
+	uint32_t space; /*!< space number */
+	uint32_t index; /*!< index number */
+	uint32_t page; /*!< count of tuples per page */
+	int unique; /*!< 1 if index is unique */
+	uint32_t part_count; /*!< count of key parts */
+	uint32_t *parts; /*!< 0-based field numbers of key parts */
+	const char **fields; /*!< field pointers, when key is extracted */
+	const char **tuples; /*!< tuples of current page (non-unique index) */
+	uint32_t tuples_alloc; /*!< allocated size of tuples */
+	struct tnt_stream *key; /*!< key of the last received tuple */
+	struct tnt_stream *cmp; /*!< scratch key for duplicate search */
+	struct tnt_stream *to; /*!< upper bound (exclusive), maybe NULL */
+	int iterator; /*!< iterator of the next page request */
+	uint32_t dup; /*!< count of received tuples with key equal to 'key' */
+	struct tnt_reply reply; /*!< current page (or error reply) */
+	const char *tuple; /*!< next tuple of current page */
+	uint32_t left; /*!< count of tuples left in current page */
+	uint64_t sync; /*!< sync of page request in flight */
+	int fetching; /*!< 1 if page request is in flight */
+	int eof; /*!< 1 if the last page is received */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create cursor over index
+ *
+ * \param c     cursor pointer, maybe NULL
+ * \param s     connected tnt_net stream with loaded schema
+ * \param space space number
+ * \param index index number
+ *
+ * If cursor pointer is NULL, then new cursor will be allocated. Page is
+ * 1000 tuples by default.
+ *
+ * \returns cursor pointer
+ * \retval  NULL oom or index (or its parts) isn't found in schema
+ *
+ * \code{.c}
+ * struct tnt_cursor *c = tnt_cursor(NULL, s, 512, 0);
+ * tnt_cursor_page(c, 512);
+ * const char *tuple;
+ * size_t size;
+ * int rc;
+ * while ((rc = tnt_cursor_next(c, &tuple, &size)) == 1)
+ * 	process(tuple, size);
+ * if (rc == -1)
+ * 	fprintf(stderr, "%s\n", c->reply.error ? c->reply.error :
+ * 		tnt_strerror(s));
+ * tnt_cursor_free(c);
+ * \endcode
+ */
+struct tnt_cursor *
+tnt_cursor(struct tnt_cursor *c, struct tnt_stream *s, uint32_t space,
+	   uint32_t index);
+
+/**
+ * \brief Set count of tuples per page (must be > 0)
+ *
+ * Must be set before the first tnt_cursor_next.
+ */
+void
+tnt_cursor_page(struct tnt_cursor *c, uint32_t page);
+
+/**
+ * \brief Limit cursor to key range
+ *
+ * Must be set before the first tnt_cursor_next. Keys are copied and may be
+ * partial, then only their parts are compared (so [10] as upper bound stops
+ * the scan at the first tuple, which first key part is >= 10). Keys are
+ * compared in tarantool's order for scalar types with binary collation of
+ * strings.
+ *
+ * \param c    cursor pointer
+ * \param from lower bound (inclusive), NULL - from the first tuple
+ * \param to   upper bound (exclusive), NULL - till the last tuple
+ *
+ * \retval  0 ok
+ * \retval -1 oom
+ */
+int
+tnt_cursor_range(struct tnt_cursor *c, struct tnt_stream *from,
+		 struct tnt_stream *to);
+
+/**
+ * \brief Get next tuple
+ *
+ * Stream must have no requests in flight, when the first page is requested,
+ * and must not be used for other requests, until the cursor is exhausted or
+ * freed. Non-blocking streams are waited for with poll(2).
+ *
+ * \param c     cursor pointer
+ * \param tuple pointer to tuple (valid until the next call)
+ * \param size  tuple size
+ *
+ * \returns status
+ * \retval  1 tuple is returned
+ * \retval  0 no tuples left
+ * \retval -1 error (server error is in c->reply, otherwise stream error
+ *            is set)
+ */
+int
+tnt_cursor_next(struct tnt_cursor *c, const char **tuple, size_t *size);
+
+/**
+ * \brief Free cursor
+ *
+ * If page request is in flight, its reply is read and dropped.
+ */
+void
+tnt_cursor_free(struct tnt_cursor *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_CURSOR_H_INCLUDED */
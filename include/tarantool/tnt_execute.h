@@ -21,4 +21,34 @@ ssize_t
 tnt_execute(struct tnt_stream *s, const char *expr, size_t elen,
 	    struct tnt_stream *params);
 
+/**
+ * \brief Construct SQL prepare request and write it into stream
+ *
+ * Reply contains statement id (\sa tnt_reply::stmt_id), count of
+ * parameters and column metadata of the statement.
+ *
+ * \param s    stream object to write request to
+ * \param expr SQL query string
+ * \param elen query length
+ *
+ * \retval number of bytes written to stream
+ */
+ssize_t
+tnt_prepare(struct tnt_stream *s, const char *expr, size_t elen);
+
+/**
+ * \brief Construct request, that executes prepared SQL statement, and write
+ * it into stream
+ *
+ * \param s       stream object to write request to
+ * \param stmt_id statement id, returned by prepare request
+ * \param params  tnt_object instance with messagepack array with params
+ *                to bind to the request
+ *
+ * \retval number of bytes written to stream
+ */
+ssize_t
+tnt_execute_id(struct tnt_stream *s, uint64_t stmt_id,
+	       struct tnt_stream *params);
+
 #endif /* TNT_EXECUTE_H_INCLUDED */
\ No newline at end of file
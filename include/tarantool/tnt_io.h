@@ -39,11 +39,20 @@
  * \brief Basic network layer io
  */
 
+/* minimal free space in recv buffer before reading into it */
+#define TNT_IO_RECV_MIN 4096
+/* recv buffer, that has grown more than this times for a large reply, is
+ * shrunk back to its initial size, when it's drained */
+#define TNT_IO_RECV_SLACK 4
+
 enum tnt_error
 tnt_io_connect(struct tnt_stream_net *s);
 void
 tnt_io_close(struct tnt_stream_net *s);
 
+enum tnt_error
+tnt_io_set_nonblock(struct tnt_stream_net *s, int set);
+
 ssize_t
 tnt_io_flush(struct tnt_stream_net *s);
 
@@ -62,6 +71,15 @@ ssize_t
 tnt_io_sendv(struct tnt_stream_net *s, struct iovec *iov, int count);
 ssize_t
 tnt_io_recv(struct tnt_stream_net *s, char *buf, size_t size);
+ssize_t
+tnt_io_recv_more(struct tnt_stream_net *s, size_t size);
+
+/* fill iov with data, that isn't sent yet; returns count of entries */
+int
+tnt_io_pending(struct tnt_stream_net *s, struct iovec *iov, int count);
+/* drop first size bytes of pending data after they were sent */
+void
+tnt_io_sent(struct tnt_stream_net *s, size_t size);
 
 int getiovmax();
 #endif /* TNT_IO_H_INCLUDED */
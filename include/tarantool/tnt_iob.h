@@ -33,12 +33,25 @@
 /**
  * \internal
  * \file tnt_iob.h
- * \brief Basic network layer static sized buffer
+ * \brief Basic network layer buffer
  */
 
+struct tnt_mem_ctx;
+struct tnt_mem_stats;
+
 typedef ssize_t (*tnt_iob_tx_t)(void *ptr, const char *buf, size_t size);
 typedef ssize_t (*tnt_iob_txv_t)(void *ptr, struct iovec *iov, int count);
 
+/**
+ * Reference counted buffer memory, that is shared with replies, which
+ * are parsed in place (one reference is held by buffer itself). Counter
+ * is atomic, so replies may be freed on other threads.
+ */
+struct tnt_iob_chunk {
+	int refs;
+	char *buf;
+};
+
 struct tnt_iob {
 	char *buf;
 	size_t off;
@@ -47,11 +60,27 @@ struct tnt_iob {
 	tnt_iob_tx_t tx;
 	tnt_iob_txv_t txv;
 	void *ptr;
+	struct tnt_iob_chunk *chunk;
+	struct tnt_mem_ctx *mem;
+	struct tnt_mem_stats *stats;
+};
+
+/**
+ * Queue of fragments to send. Entry with NULL iov_base stands for the
+ * next iov_len bytes of send buffer, others reference caller's memory.
+ */
+struct tnt_iovq {
+	struct iovec *iov;
+	int count;
+	int size;
+	struct tnt_mem_ctx *mem;
+	struct tnt_mem_stats *stats;
 };
 
 int
 tnt_iob_init(struct tnt_iob *iob, size_t size, tnt_iob_tx_t tx,
-	     tnt_iob_txv_t txv, void *ptr);
+	     tnt_iob_txv_t txv, void *ptr, struct tnt_mem_ctx *mem,
+	     struct tnt_mem_stats *stats);
 
 void
 tnt_iob_clear(struct tnt_iob *iob);
@@ -59,4 +88,28 @@ tnt_iob_clear(struct tnt_iob *iob);
 void
 tnt_iob_free(struct tnt_iob *iob);
 
+int
+tnt_iob_grow(struct tnt_iob *iob, size_t size);
+
+int
+tnt_iob_reserve(struct tnt_iob *iob, size_t size);
+
+void
+tnt_iob_shrink(struct tnt_iob *iob, size_t size);
+
+int
+tnt_iob_share(struct tnt_iob *iob);
+
+struct tnt_iob_chunk *
+tnt_iob_ref(struct tnt_iob *iob);
+
+void
+tnt_iob_unref(void *chunk);
+
+int
+tnt_iovq_reserve(struct tnt_iovq *q, int count);
+
+void
+tnt_iovq_free(struct tnt_iovq *q);
+
 #endif /* TNT_IOB_H_INCLUDED */
@@ -36,6 +36,8 @@
  * \brief Basic memory functions
  */
 
+#include <stddef.h>
+
 #define tntfunction_unused __attribute__((unused))
 
 #if !defined __GNUC_MINOR__ || defined __INTEL_COMPILER || \
@@ -99,4 +101,265 @@ tnt_mem_dup(char *sz);
 void
 tnt_mem_free(void *ptr);
 
+/**
+ * \brief Categories of memory, that is accounted separately
+ */
+enum tnt_mem_tag {
+	TNT_MEM_OTHER = 0, /*!< not categorized */
+	TNT_MEM_REPLY, /*!< replies and their buffers */
+	TNT_MEM_IOB, /*!< network send/receive buffers */
+	TNT_MEM_SCHEMA, /*!< schema and hash tables */
+	TNT_MEM_OBJECT, /*!< object and buffer streams */
+	TNT_MEM_ITER, /*!< iterators, cursors and scans */
+	TNT_MEM_REQUEST, /*!< requests, journaled and async requests, routing */
+	TNT_MEM_TAG_MAX
+};
+
+/**
+ * \brief Memory usage of one category
+ */
+struct tnt_mem_stat {
+	size_t live; /*!< bytes in use (with headers of blocks) */
+	size_t peak; /*!< high-water mark of live bytes */
+	size_t count; /*!< blocks in use */
+	size_t allocs; /*!< count of allocations */
+};
+
+/**
+ * \internal
+ * \brief Memory usage of an owner (a stream)
+ *
+ * Every block of the owner holds a reference to it, so blocks (replies)
+ * may outlive the owner.
+ */
+struct tnt_mem_stats {
+	struct tnt_mem_stat tag[TNT_MEM_TAG_MAX]; /*!< usage by category */
+	int refs; /*!< owner and its blocks in use */
+};
+
+/**
+ * \brief Get process-wide memory usage
+ *
+ * \param stat array of TNT_MEM_TAG_MAX elements, indexed by enum tnt_mem_tag
+ *
+ * \code{.c}
+ * struct tnt_mem_stat stat[TNT_MEM_TAG_MAX];
+ * tnt_mem_usage(stat);
+ * printf("replies: %zu bytes, %zu at most\n",
+ *        stat[TNT_MEM_REPLY].live, stat[TNT_MEM_REPLY].peak);
+ * \endcode
+ */
+void
+tnt_mem_usage(struct tnt_mem_stat *stat);
+
+/**
+ * \brief Internal function
+ */
+void *
+tnt_mem_alloc_tag(size_t size, enum tnt_mem_tag tag);
+
+/**
+ * \brief Internal function
+ */
+void *
+tnt_mem_realloc_tag(void *ptr, size_t size, enum tnt_mem_tag tag);
+
+/**
+ * \internal
+ * \brief Create memory usage of an owner
+ */
+struct tnt_mem_stats *
+tnt_mem_stats_new(void);
+
+/**
+ * \internal
+ * \brief Drop a reference to memory usage of an owner
+ */
+void
+tnt_mem_stats_unref(struct tnt_mem_stats *stats);
+
+struct tnt_mem_ctx;
+
+/**
+ * \internal
+ * \brief Allocate block of an owner from context
+ *
+ * \param ctx   allocator context, maybe NULL
+ * \param stats memory usage of owner, maybe NULL
+ * \param size  size of block
+ * \param tag   category of block
+ */
+void *
+tnt_mem_alloc_ex(struct tnt_mem_ctx *ctx, struct tnt_mem_stats *stats,
+		 size_t size, enum tnt_mem_tag tag);
+
+/**
+ * \internal
+ * \brief Reallocate block of an owner (ctx, stats and tag are used, if
+ * ptr is NULL)
+ */
+void *
+tnt_mem_realloc_ex(struct tnt_mem_ctx *ctx, struct tnt_mem_stats *stats,
+		   void *ptr, size_t size, enum tnt_mem_tag tag);
+
+/**
+ * \brief Allocator context
+ *
+ * Memory of some components (buffers and replies of a stream, nodes of a
+ * schema) may be taken from a context instead of the global allocation
+ * function. \sa TNT_OPT_MEM
+ *
+ * alloc and free are called with the full size of block, free gets the
+ * same size, that was passed to alloc. Memory must be aligned on 16 bytes.
+ */
+struct tnt_mem_ctx {
+	void *(*alloc)(struct tnt_mem_ctx *ctx, size_t size); /*!< allocate block */
+	void (*free)(struct tnt_mem_ctx *ctx, void *ptr, size_t size); /*!< free block */
+};
+
+/**
+ * \brief Allocate memory from context
+ *
+ * \param ctx  allocator context, NULL for the global allocation function
+ * \param size size of block
+ *
+ * Every block remembers its context, so it's freed with tnt_mem_ctx_free()
+ * without it.
+ *
+ * \retval pointer to newly allocated block
+ * \retval NULL on error
+ */
+void *
+tnt_mem_ctx_alloc(struct tnt_mem_ctx *ctx, size_t size);
+
+/**
+ * \brief Reallocate memory from context
+ *
+ * \param ctx  allocator context (used if ptr is NULL)
+ * \param ptr  block, allocated with tnt_mem_ctx_alloc(), maybe NULL
+ * \param size new size of block, 0 to free it
+ *
+ * Block, that is big enough, is returned as is.
+ *
+ * \retval pointer to reallocated block
+ * \retval NULL on error/free
+ */
+void *
+tnt_mem_ctx_realloc(struct tnt_mem_ctx *ctx, void *ptr, size_t size);
+
+/**
+ * \brief Free memory, allocated with tnt_mem_ctx_alloc() (the same as
+ * tnt_mem_free())
+ *
+ * \param ptr block, maybe NULL
+ */
+void
+tnt_mem_ctx_free(void *ptr);
+
+struct tnt_mem_page;
+
+/* Size classes of slab allocator: 16, 32, ..., 64K */
+#define TNT_SLAB_CLASSES 13
+/* Size of memory chunk, that blocks are cut from */
+#define TNT_SLAB_PAGE (256 * 1024)
+
+/**
+ * \brief Size-class slab allocator
+ *
+ * Freed blocks are kept in free lists by power of two size class and are
+ * reused without calling the global allocation function and without
+ * zeroing. Blocks of more than 64K are taken from the global allocation
+ * function. Memory of pages is returned by tnt_mem_slab_free() only.
+ * It isn't thread safe.
+ */
+struct tnt_mem_slab {
+	struct tnt_mem_ctx base; /*!< allocator context */
+	void *free_list[TNT_SLAB_CLASSES]; /*!< free blocks by size class */
+	struct tnt_mem_page *pages; /*!< allocated pages */
+	size_t page_used; /*!< used bytes of the last page */
+	size_t used; /*!< size of blocks in use */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create slab allocator
+ *
+ * \param slab slab pointer, maybe NULL
+ *
+ * \code{.c}
+ * struct tnt_mem_slab *slab = tnt_mem_slab(NULL);
+ * tnt_set(s, TNT_OPT_MEM, &slab->base);
+ * tnt_connect(s);
+ * ...
+ * tnt_stream_free(s);
+ * tnt_mem_slab_free(slab);
+ * \endcode
+ *
+ * \returns slab pointer
+ * \retval  NULL oom
+ */
+struct tnt_mem_slab *
+tnt_mem_slab(struct tnt_mem_slab *slab);
+
+/**
+ * \brief Free slab allocator with all its memory
+ *
+ * All blocks must be freed (or be unused) by now.
+ */
+void
+tnt_mem_slab_free(struct tnt_mem_slab *slab);
+
+/**
+ * \brief Bump arena allocator
+ *
+ * Blocks are cut one after another from chunks of memory. Only the last
+ * allocated block may be really freed, the rest of memory is released at
+ * once with tnt_mem_arena_reset(). It's meant for scratch memory of a batch
+ * of requests. It isn't thread safe.
+ */
+struct tnt_mem_arena {
+	struct tnt_mem_ctx base; /*!< allocator context */
+	struct tnt_mem_page *chunks; /*!< allocated chunks, the last first */
+	size_t chunk_size; /*!< default size of chunk */
+	size_t chunk_used; /*!< used bytes of the last chunk */
+	size_t used; /*!< size of allocated blocks */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create arena allocator
+ *
+ * \param arena arena pointer, maybe NULL
+ * \param chunk size of chunk (64K if 0)
+ *
+ * \code{.c}
+ * struct tnt_mem_arena *arena = tnt_mem_arena(NULL, 0);
+ * while (...) {
+ * 	char *key = tnt_mem_ctx_alloc(&arena->base, 64);
+ * 	...
+ * 	tnt_mem_arena_reset(arena);
+ * }
+ * tnt_mem_arena_free(arena);
+ * \endcode
+ *
+ * \returns arena pointer
+ * \retval  NULL oom
+ */
+struct tnt_mem_arena *
+tnt_mem_arena(struct tnt_mem_arena *arena, size_t chunk);
+
+/**
+ * \brief Release every block of arena
+ *
+ * The last chunk is kept for reuse.
+ */
+void
+tnt_mem_arena_reset(struct tnt_mem_arena *arena);
+
+/**
+ * \brief Free arena allocator with all its memory
+ */
+void
+tnt_mem_arena_free(struct tnt_mem_arena *arena);
+
 #endif /* TNT_MEM_H_INCLUDED */
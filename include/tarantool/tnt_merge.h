@@ -0,0 +1,177 @@
+#ifndef TNT_MERGE_H_INCLUDED
+#define TNT_MERGE_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_merge.h
+ * \brief Scatter-gather select with merge of ordered results
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct tnt_stream;
+struct tnt_reply;
+struct tnt_iter;
+struct tnt_merge_src;
+
+/**
+ * \brief Scatter-gather select
+ *
+ * The same select is sent to every stream (e.g. to every shard of
+ * tnt_router), then ordered replies are merged by index key with a binary
+ * heap over per-stream array iterators, so replies are neither copied nor
+ * sorted. Global offset and limit are applied to the merged sequence.
+ *
+ * Streams are read by pages: the next page of stream is requested from
+ * the key of its last tuple, when the heap hands out the last tuple of the
+ * current one, so only a page per stream is kept in memory.
+ */
+struct tnt_merge {
+	struct tnt_stream **streams; /*!< streams to select from */
+	uint32_t count; /*!< count of streams */
+	uint32_t part_count; /*!< count of key parts */
+	uint32_t *parts; /*!< 0-based field numbers of key parts */
+	int reverse; /*!< 1 if tuples are in descending order */
+	int unique; /*!< 1 if index is unique */
+	uint32_t space; /*!< space number of select */
+	uint32_t index; /*!< index number of select */
+	int iterator; /*!< iterator type of select */
+	struct tnt_stream *key; /*!< EQ or REQ key of select */
+	uint32_t page; /*!< count of tuples per page of stream */
+	uint64_t window; /*!< count of tuples, that stream may contribute */
+	uint32_t left; /*!< count of tuples left to hand out */
+	uint32_t refill; /*!< stream, that gets the next page before the next
+			  *   tuple (count, if there's no such stream) */
+	struct tnt_reply *replies; /*!< current pages of streams */
+	struct tnt_iter *iters; /*!< tuple iterators over replies */
+	struct tnt_merge_src *srcs; /*!< paging state of streams */
+	const char **fields; /*!< key parts of current tuples of streams */
+	uint32_t *heap; /*!< heap of streams by their current tuples */
+	uint32_t heap_size; /*!< count of streams in heap */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create scatter-gather select
+ *
+ * \param m       merge pointer, maybe NULL
+ * \param streams tnt_net streams (array is referenced, not copied)
+ * \param count   count of streams
+ *
+ * If merge pointer is NULL, then new merge will be allocated.
+ *
+ * \returns merge pointer
+ * \retval  NULL oom or count is 0
+ *
+ * \code{.c}
+ * struct tnt_merge *m = tnt_merge(NULL, router->shards, router->shard_count);
+ * if (tnt_merge_select(m, 512, 0, 100, 0, TNT_ITER_GE, key) == -1)
+ * 	...
+ * const char *tuple;
+ * size_t size;
+ * while (tnt_merge_next(m, &tuple, &size) == 1)
+ * 	process(tuple, size);
+ * tnt_merge_free(m);
+ * \endcode
+ */
+struct tnt_merge *
+tnt_merge(struct tnt_merge *m, struct tnt_stream **streams, uint32_t count);
+
+/**
+ * \brief Set count of tuples per page of stream (1000 by default)
+ */
+void
+tnt_merge_page(struct tnt_merge *m, uint32_t page);
+
+/**
+ * \brief Select from every stream
+ *
+ * Select of the first page (at most offset + limit tuples) is sent to
+ * every stream, all streams are flushed, and then replies are read. The
+ * next pages are requested one by one, when they're needed, with GT/LT
+ * (GE/LE with offset for non-unique index) from the key of the last tuple
+ * of page. Tree index order is expected; TNT_ITER_LT, TNT_ITER_LE and
+ * TNT_ITER_REQ are merged in descending order. Key parts are taken from
+ * schema of the first stream. Streams must be blocking and have no
+ * requests in flight, until the merge ends. If sending or reading fails,
+ * replies of requests in flight are read and dropped, so streams stay
+ * usable (stream, which can't be drained, is closed).
+ *
+ * \param m        merge pointer
+ * \param space    space number
+ * \param index    index number
+ * \param limit    global limit
+ * \param offset   global offset
+ * \param iterator iterator type
+ * \param key      key
+ *
+ * \returns status
+ * \retval  0 ok
+ * \retval -1 error (server error is in m->replies, otherwise stream error
+ *            is set; TNT_EBADVAL if index isn't found in schema or
+ *            iterator doesn't keep order)
+ */
+int
+tnt_merge_select(struct tnt_merge *m, uint32_t space, uint32_t index,
+		 uint32_t limit, uint32_t offset, int iterator,
+		 struct tnt_stream *key);
+
+/**
+ * \brief Get next tuple in merged order
+ *
+ * \param m     merge pointer
+ * \param tuple pointer to tuple (valid until the next call or select)
+ * \param size  tuple size
+ *
+ * \retval  1 tuple is returned
+ * \retval  0 no tuples left
+ * \retval -1 the next page can't be read (server error is in m->replies,
+ *            otherwise stream error is set; merge ends)
+ */
+int
+tnt_merge_next(struct tnt_merge *m, const char **tuple, size_t *size);
+
+/**
+ * \brief Free merge and replies
+ */
+void
+tnt_merge_free(struct tnt_merge *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_MERGE_H_INCLUDED */
@@ -62,9 +62,37 @@ enum tnt_error {
 	TNT_ETMOUT, /*!< Operation timeout */
 	TNT_EBADVAL, /*!< Bad argument (value) */
 	TNT_ELOGIN, /*!< Failed to login */
+	TNT_ELOST, /*!< Request was lost on reconnect */
 	TNT_LAST /*!< Not an error */
 };
 
+struct tnt_uring_conn;
+struct tnt_wheel;
+struct tnt_journal;
+struct tnt_rpool;
+struct tnt_mem_stats;
+struct tnt_mem_stat;
+struct tnt_reply;
+
+/**
+ * \brief Count of requests in flight, that are timed for RTT
+ */
+#define TNT_RTT_SLOTS 64
+
+/**
+ * \brief Round-trip time statistics of connection
+ *
+ * Submission time of request is remembered in slot sync % TNT_RTT_SLOTS,
+ * and RTT sample is taken, when reply with the same sync is read. Samples
+ * are smoothed with weight 1/8, as TCP does.
+ */
+struct tnt_rtt {
+	uint64_t sync[TNT_RTT_SLOTS]; /*!< syncs of timed requests */
+	uint64_t sent[TNT_RTT_SLOTS]; /*!< submission time, usec (0 - free) */
+	uint64_t srtt; /*!< smoothed RTT, usec << 3 (0 - no samples) */
+	uint32_t last; /*!< the last RTT sample, usec */
+};
+
 /**
  * \brief Network stream structure
  */
@@ -79,6 +107,16 @@ struct tnt_stream_net {
 	char *greeting; /*!< Pointer to greeting, if connected */
 	struct tnt_schema *schema; /*!< Collation for space/index string<->number */
 	int inited; /*!< 1 if iob/schema were allocated */
+	struct mh_async_t *async; /*!< Requests with completion callbacks */
+	int nonblock; /*!< 1 if socket is in non-blocking mode */
+	struct tnt_iovq sendq; /*!< Fragments to send (TNT_OPT_SEND_ZEROCOPY) */
+	struct tnt_uring_conn *uring; /*!< io_uring state, if attached */
+	struct mh_assoc_t *stmts; /*!< Prepared SQL statements by text */
+	struct tnt_rtt rtt; /*!< Round-trip time statistics */
+	struct tnt_wheel *wheel; /*!< Deadlines of requests with callbacks */
+	struct tnt_journal *journal; /*!< Requests to replay on reconnect */
+	struct tnt_rpool *rpool; /*!< Free reply buffers */
+	struct tnt_mem_stats *stats; /*!< Memory usage of stream */
 };
 
 /*!
@@ -176,6 +214,9 @@ tnt_close(struct tnt_stream *s);
  *
  * \param s tnt_stream
  *
+ * In non-blocking mode only part of the buffer may be written, the rest
+ * stays buffered until the next flush (\sa tnt_wants).
+ *
  * \returns number of bytes written to socket
  * \retval -1 on network error
  */
@@ -188,6 +229,186 @@ tnt_flush(struct tnt_stream *s);
 int
 tnt_fd(struct tnt_stream *s);
 
+/**
+ * \brief Events, that non-blocking stream is waiting for
+ * \sa tnt_wants
+ */
+enum tnt_want {
+	TNT_WANT_READ  = 0x01, /*!< Replies are expected */
+	TNT_WANT_WRITE = 0x02  /*!< Send buffer isn't empty */
+};
+
+/**
+ * \brief Get events, that stream is waiting for on its fd
+ *
+ * \param s tnt_net stream pointer
+ *
+ * \returns bitmask of enum tnt_want
+ */
+int
+tnt_wants(struct tnt_stream *s);
+
+/**
+ * \brief Make progress on non-blocking stream
+ *
+ * Flush as much of send buffer as socket accepts, then read all available
+ * replies and execute their callbacks (\sa tnt_async_register). Replies
+ * without callbacks are dropped. Never blocks, if stream is created with
+ * TNT_OPT_NONBLOCK.
+ *
+ * \param s tnt_net stream pointer
+ *
+ * \returns count of processed replies
+ * \retval  -1 network/parsing error
+ *
+ * \code{.c}
+ * assert(tnt_set(s, TNT_OPT_NONBLOCK, 1) != -1);
+ * assert(tnt_connect(s) != -1);
+ * ...
+ * struct pollfd pfd = { tnt_fd(s), 0, 0 };
+ * while (tnt_async_count(s) > 0) {
+ * 	int wants = tnt_wants(s);
+ * 	pfd.events = ((wants & TNT_WANT_READ)  ? POLLIN  : 0) |
+ * 		     ((wants & TNT_WANT_WRITE) ? POLLOUT : 0);
+ * 	poll(&pfd, 1, -1);
+ * 	if (tnt_process_io(s) == -1)
+ * 		break;
+ * }
+ * \endcode
+ */
+int
+tnt_process_io(struct tnt_stream *s);
+
+/**
+ * \brief Get smoothed round-trip time of connection
+ *
+ * RTT is measured from submission of request to stream (it may stay in
+ * send buffer until flush) to reading of its reply. Count of requests in
+ * flight is s->wrcnt.
+ *
+ * \param s tnt_net stream pointer
+ *
+ * \returns RTT in microseconds
+ * \retval  0 no replies have been read yet
+ */
+uint32_t
+tnt_rtt(struct tnt_stream *s);
+
+/**
+ * \brief Get memory usage of connection
+ *
+ * Buffers, replies (until they're freed, even after the stream is freed),
+ * schema, journal and async requests of the stream are accounted.
+ *
+ * \param s    tnt_net stream pointer
+ * \param stat array of TNT_MEM_TAG_MAX elements, indexed by
+ *             enum tnt_mem_tag
+ *
+ * \code{.c}
+ * struct tnt_mem_stat stat[TNT_MEM_TAG_MAX];
+ * tnt_stream_mem(s, stat);
+ * printf("receive buffer: %zu bytes at most\n", stat[TNT_MEM_IOB].peak);
+ * \endcode
+ */
+void
+tnt_stream_mem(struct tnt_stream *s, struct tnt_mem_stat *stat);
+
+/*!
+ * \internal
+ * \brief Account final reply with sync \a sync
+ *
+ * Decrement count of requests in flight, take RTT sample and drop request
+ * from reconnect journal.
+ */
+void
+tnt_net_complete(struct tnt_stream *s, uint64_t sync);
+
+/*!
+ * \internal
+ * \brief Report the next request, that was lost on reconnect
+ *
+ * Requests with async callbacks are failed with TNT_ELOST, the first one
+ * without callback is reported in \a r.
+ *
+ * \retval  0 no lost requests left
+ * \retval -1 r->sync is lost, stream error is TNT_ELOST
+ */
+int
+tnt_net_lost(struct tnt_stream *s, struct tnt_reply *r);
+
+/*!
+ * \internal
+ * \brief Read and drop replies of requests in flight
+ *
+ * Is used to leave stream usable, when scatter request fails on another
+ * stream. If stream can't be drained, then it's closed. Error of stream
+ * is kept.
+ *
+ * \retval  0 no requests are in flight
+ * \retval -1 stream is closed
+ */
+int
+tnt_net_drain(struct tnt_stream *s);
+
+/*!
+ * \internal
+ * \brief Get schema of stream for lookups
+ *
+ * If stream shares schema cache, the newest published version is taken.
+ * Returned snapshot is valid until the next call.
+ */
+struct tnt_schema *
+tnt_net_schema(struct tnt_stream *s);
+
+/**
+ * \brief Reconnect and replay requests in flight
+ *
+ * Is executed automatically, when reading reply fails with network error
+ * on stream with TNT_OPT_RECONNECT set. Connection is re-established (with
+ * jittered exponential backoff between attempts, at most TNT_OPT_RECONNECT
+ * attempts) and re-authenticated. Then idempotent requests in flight
+ * (selects, pings and ones marked with tnt_idempotent) are sent again,
+ * and the others are lost: read_reply returns -1 with TNT_ELOST and sync
+ * of lost request in reply for every one of them, and their async
+ * callbacks are executed with TNT_ELOST.
+ *
+ * Reconnect is blocking and isn't supported with TNT_OPT_URING. It isn't
+ * executed automatically on non-blocking streams (TNT_OPT_NONBLOCK), where
+ * backoff would stall the event loop: read_reply fails with TNT_ESYSTEM,
+ * and tnt_reconnect should be called by application. Prepared statements
+ * of the old session are forgotten (\sa tnt_stmt_cache_clear).
+ *
+ * \param s tnt_net stream pointer
+ *
+ * \retval  0 ok
+ * \retval -1 reconnect is disabled or every attempt has failed (all
+ *             requests in flight are lost then)
+ */
+int
+tnt_reconnect(struct tnt_stream *s);
+
+/**
+ * \brief Mark request in flight as idempotent (safe to replay on reconnect)
+ *
+ * Only selects and pings are copied to journal, when they're written. Other
+ * requests are copied from send buffer here, so this must be called before
+ * request is flushed.
+ *
+ * \param s    tnt_net stream pointer
+ * \param sync request sync id
+ *
+ * \retval  0 ok
+ * \retval -1 reconnect is disabled, request isn't in flight or it has been
+ *             sent already
+ *
+ * \code{.c}
+ * tnt_call(s, "get_user", 8, args);
+ * tnt_idempotent(s, tnt_async_last(s));
+ * \endcode
+ */
+int
+tnt_idempotent(struct tnt_stream *s, uint64_t sync);
+
 /**
  * \brief Error accessor for tnt_net stream
  */
@@ -209,6 +430,9 @@ tnt_errno(struct tnt_stream *s);
 /**
  * \brief Flush space/index schema and get it from server
  *
+ * New schema is published in schema cache of the stream, if it's set
+ * (TNT_OPT_SCHEMA_CACHE), and is taken by other streams, that share it.
+ *
  * \param s stream pointer
  *
  * \returns result
@@ -218,6 +442,25 @@ tnt_errno(struct tnt_stream *s);
 int
 tnt_reload_schema(struct tnt_stream *s);
 
+/*!
+ * \internal
+ * \brief Execute synchronous exchange on connected stream
+ *
+ * Stream is switched to blocking mode (and detached from io_uring) while
+ * \a fn is executed, so \a fn may send requests and read their replies
+ * with read_reply.
+ *
+ * \param s   stream pointer
+ * \param fn  function to execute
+ * \param arg argument for \a fn
+ *
+ * \returns result of \a fn
+ * \retval  -1 error (or stream isn't connected or has requests in flight)
+ */
+int
+tnt_net_sync(struct tnt_stream *s, int (*fn)(struct tnt_stream *, void *),
+	     void *arg);
+
 /**
  * \brief Get space number from space name
  *
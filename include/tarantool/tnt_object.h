@@ -54,18 +54,25 @@ struct tnt_sbo_stack {
  * - TNT_SBO_PACKED - 1 byte is alloced for map/array, if needed more, then
  *                    everything is moved to n bytes, when called
  *                    "tnt_object_container_close"
+ * - TNT_SBO_DEFERRED - 5 bytes are allocated for map/array, headers of all
+ *                      nested containers are shrunk to minimal size in one
+ *                      pass, when the outermost container is closed
  */
 enum tnt_sbo_type {
 	TNT_SBO_SIMPLE = 0,
 	TNT_SBO_SPARSE,
 	TNT_SBO_PACKED,
+	TNT_SBO_DEFERRED,
 };
 
 struct tnt_sbuf_object {
 	struct tnt_sbo_stack *stack;
-	uint8_t stack_size;
-	uint8_t stack_alloc;
+	uint32_t stack_size;
+	uint32_t stack_alloc;
 	enum tnt_sbo_type type;
+	size_t *extents; /*!< offsets of containers to shrink (DEFERRED) */
+	uint32_t extents_size;
+	uint32_t extents_alloc;
 };
 
 #define TNT_OBJ_CAST(SB) ((struct tnt_sbuf_object *)(SB)->subdata)
@@ -245,4 +252,56 @@ tnt_object_format(struct tnt_stream *s, const char *fmt, ...);
 ssize_t
 tnt_object_vformat(struct tnt_stream *s, const char *fmt, va_list vl);
 
+struct tnt_format;
+
+/**
+ * \brief Compile format string into reusable encoder program
+ *
+ * Format is parsed once: sizes of arrays/maps are counted, their headers
+ * and nils are encoded in advance, and max size of fixed-width values is
+ * precomputed. Executing program encodes values straight into object
+ * buffer in one pass.
+ *
+ * \param fmt format string (\sa tnt_object_format)
+ *
+ * \returns compiled format
+ * \retval  NULL oom/unbalanced brackets/bad format specifier/odd map size
+ */
+struct tnt_format *
+tnt_format_compile(const char *fmt);
+
+/**
+ * \brief Free compiled format
+ */
+void
+tnt_format_free(struct tnt_format *f);
+
+/**
+ * \brief Append values encoded by compiled format to tnt_object
+ *
+ * Unlike tnt_object_format, packing type of object doesn't matter, and
+ * values may be appended to non-empty object.
+ *
+ * \code{.c}
+ * struct tnt_format *f = tnt_format_compile("[%d%.*s]");
+ * tnt_format_exec(s, f, 42, 3, "foo");
+ * \endcode
+ *
+ * \param s tnt_object instance
+ * \param f compiled format
+ *
+ * \returns count of bytes written
+ * \retval  -1 oom
+ */
+ssize_t
+tnt_format_exec(struct tnt_stream *s, const struct tnt_format *f, ...);
+
+/**
+ * \brief Append values encoded by compiled format (va_list variation)
+ * \sa tnt_format_exec
+ */
+ssize_t
+tnt_format_vexec(struct tnt_stream *s, const struct tnt_format *f,
+		 va_list vl);
+
 #endif /* TNT_OBJECT_H_INCLUDED */
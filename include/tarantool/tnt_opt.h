@@ -38,6 +38,9 @@
  */
 
 struct tnt_iob;
+struct tnt_uring;
+struct tnt_mem_ctx;
+struct tnt_schema_cache;
 
 /**
  * \brief Callback type for read (instead of reading from socket)
@@ -95,7 +98,38 @@ enum tnt_opt_type {
 	TNT_OPT_RECV_CB_ARG, /*!< callback context for recv
 			      * \sa recv_cb_t
 			      */
-	TNT_OPT_RECV_BUF /*!< Option for setting recv buffer size */
+	TNT_OPT_RECV_BUF, /*!< Option for setting initial recv buffer size */
+	TNT_OPT_NONBLOCK, /*!< Switch socket to non-blocking mode after connect
+			   * \sa tnt_process_io
+			   */
+	TNT_OPT_ZEROCOPY, /*!< Parse replies in place inside of recv buffer */
+	TNT_OPT_SEND_ZEROCOPY, /*!< Minimal size of fragment, that is sent by
+			       * reference instead of copying into send
+			       * buffer (0 - disabled). Referenced memory
+			       * must be valid until it's flushed.
+			       */
+	TNT_OPT_URING, /*!< Shared io_uring instance to do network io with
+			* \sa tnt_uring_new
+			*/
+	TNT_OPT_RECONNECT, /*!< Count of reconnect attempts, when connection
+			    * breaks (0 - disabled) \sa tnt_reconnect
+			    */
+	TNT_OPT_RECONNECT_DELAY, /*!< Initial delay between reconnect
+				  * attempts, ms (100 by default)
+				  */
+	TNT_OPT_RECONNECT_MAX_DELAY, /*!< Maximal delay between reconnect
+				      * attempts, ms (10000 by default)
+				      */
+	TNT_OPT_MEM, /*!< Allocator context for buffers, replies and schema
+		      * \sa tnt_mem_slab
+		      */
+	TNT_OPT_REPLY_POOL, /*!< Maximal size of free reply buffers, that are
+			     * kept for reuse, bytes (0 - disabled)
+			     */
+	TNT_OPT_SCHEMA_CACHE /*!< Schema cache, that is shared with other
+			      * connections to the same cluster
+			      * \sa tnt_schema_cache_new
+			      */
 };
 
 /**
@@ -115,6 +149,16 @@ struct tnt_opt {
 	void *recv_cb;
 	void *recv_cb_arg;
 	int recv_buf;
+	int nonblock;
+	int zerocopy;
+	int send_zerocopy;
+	struct tnt_uring *uring;
+	int reconnect;
+	int reconnect_delay;
+	int reconnect_max_delay;
+	struct tnt_mem_ctx *mem;
+	int reply_pool;
+	struct tnt_schema_cache *schema_cache;
 };
 
 /**
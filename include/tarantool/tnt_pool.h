@@ -0,0 +1,197 @@
+#ifndef TNT_POOL_H_INCLUDED
+#define TNT_POOL_H_INCLUDED
+
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_pool.h
+ * \brief Pool of connections to the same tarantool instance
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <tarantool/tnt_net.h>
+
+struct tnt_stream;
+struct tnt_schema_cache;
+
+/**
+ * \brief Pool of tnt_net streams
+ *
+ * Every member is a separate connection with its own buffers and sync
+ * counter. Members share schema cache (TNT_OPT_SCHEMA_CACHE), so schema
+ * is stored once for the whole pool. Requests are sent to the least-loaded
+ * member, that's chosen by count of requests in flight (tnt_pool_get), or
+ * by expected completion time (tnt_pool_pick).
+ *
+ * Pool isn't thread-safe, as tnt_net streams aren't.
+ */
+struct tnt_pool {
+	struct tnt_stream **members; /*!< member streams */
+	int size; /*!< count of members */
+	int next; /*!< member to start search from, for fair ties */
+	uint32_t seed; /*!< state of random member sampling */
+	struct tnt_schema_cache *schema; /*!< schema cache of members */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create pool of connections
+ *
+ * \param p    pool pointer, maybe NULL
+ * \param size count of connections
+ *
+ * If pool pointer is NULL, then new pool will be allocated.
+ *
+ * \returns pool pointer
+ * \retval  NULL oom
+ *
+ * \code{.c}
+ * struct tnt_pool *pool = tnt_pool(NULL, 4);
+ * assert(pool);
+ * assert(tnt_pool_set(pool, TNT_OPT_URI, "login:passw@localhost:3302") != -1);
+ * assert(tnt_pool_connect(pool) != -1);
+ * struct tnt_stream *s = tnt_pool_get(pool);
+ * tnt_select(s, 512, 0, 1, 0, TNT_ITER_EQ, key);
+ * tnt_flush(s);
+ * ...
+ * tnt_pool_free(pool);
+ * \endcode
+ */
+struct tnt_pool *
+tnt_pool(struct tnt_pool *p, int size);
+
+/**
+ * \brief Set option for every connection in pool
+ *
+ * \sa tnt_set
+ *
+ * \retval -1 error
+ * \retval  0 ok
+ */
+int
+tnt_pool_set(struct tnt_pool *p, int opt, ...);
+
+/**
+ * \brief Connect every member of pool
+ *
+ * Connection and authentication happen once per member. Schema is loaded
+ * by the first member and taken from cache by the others, if its version
+ * is the same.
+ *
+ * \returns count of connected members
+ * \retval  -1 no member has connected
+ */
+int
+tnt_pool_connect(struct tnt_pool *p);
+
+/**
+ * \brief Get the least-loaded connected member
+ *
+ * Member with the least count of requests in flight is returned. Ties are
+ * resolved in round-robin order.
+ *
+ * \returns member stream
+ * \retval  NULL no connected members
+ */
+struct tnt_stream *
+tnt_pool_get(struct tnt_pool *p);
+
+/**
+ * \brief Get connected member with the lowest expected completion time
+ *
+ * Two connected members are sampled at random and the one with the lower
+ * smoothed RTT multiplied by count of requests in flight (plus the new
+ * one) is returned (power of two choices). Members without RTT samples
+ * are assumed to be fast.
+ *
+ * \returns member stream
+ * \retval  NULL no connected members
+ *
+ * \code{.c}
+ * struct tnt_stream *s = tnt_pool_pick(pool);
+ * tnt_select(s, 512, 0, 1, 0, TNT_ITER_EQ, key);
+ * tnt_flush(s);
+ * \endcode
+ */
+struct tnt_stream *
+tnt_pool_pick(struct tnt_pool *p);
+
+/**
+ * \brief Get member of pool by number
+ *
+ * \returns member stream
+ * \retval  NULL bad member number
+ */
+struct tnt_stream *
+tnt_pool_member(struct tnt_pool *p, int n);
+
+/**
+ * \brief Flush every member of pool
+ *
+ * \retval -1 network error on some member
+ * \retval  0 ok
+ */
+int
+tnt_pool_flush(struct tnt_pool *p);
+
+/**
+ * \brief Read replies from every member and execute their callbacks
+ *
+ * \sa tnt_async_dispatch
+ *
+ * \returns count of processed replies
+ * \retval  -1 network/parsing error on some member
+ */
+int
+tnt_pool_dispatch(struct tnt_pool *p);
+
+/**
+ * \brief Close every connection of pool
+ */
+void
+tnt_pool_close(struct tnt_pool *p);
+
+/**
+ * \brief Close connections and free pool
+ */
+void
+tnt_pool_free(struct tnt_pool *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_POOL_H_INCLUDED */
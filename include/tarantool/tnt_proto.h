@@ -68,6 +68,7 @@ enum tnt_body_key_t {
 	TNT_OPS = 0x28,
 	TNT_SQL_TEXT = 0x40,
 	TNT_SQL_BIND = 0x41,
+	TNT_STMT_ID = 0x43,
 };
 
 enum tnt_response_type_t {
@@ -82,6 +83,8 @@ enum tnt_response_key_t {
 	TNT_DATA = 0x30,
 	TNT_ERROR = 0x31,
 	TNT_METADATA = 0x32,
+	TNT_BIND_METADATA = 0x33,
+	TNT_BIND_COUNT = 0x34,
 	TNT_SQL_INFO = 0x42,
 };
 
@@ -100,6 +103,7 @@ enum tnt_request_t {
 	TNT_OP_UPSERT    = 9,
 	TNT_OP_CALL      = 10,
 	TNT_OP_EXECUTE   = 11,
+	TNT_OP_PREPARE   = 13,
 	TNT_OP_PING      = 64,
 	TNT_OP_JOIN      = 65,
 	TNT_OP_SUBSCRIBE = 66
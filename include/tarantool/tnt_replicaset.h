@@ -0,0 +1,238 @@
+#ifndef TNT_REPLICASET_H_INCLUDED
+#define TNT_REPLICASET_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_replicaset.h
+ * \brief Hedged reads over set of replicas
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <sys/types.h>
+
+struct tnt_stream;
+struct tnt_reply;
+
+/**
+ * \brief Count of latency samples, that are kept per replica
+ */
+#define TNT_LATENCY_WINDOW 128
+
+/**
+ * \brief Latency window of replica
+ *
+ * Keeps the last TNT_LATENCY_WINDOW samples (in microseconds) in a ring.
+ * Sorted copy of the ring is kept up to date: a new sample replaces the
+ * oldest one in it, so percentile is read without sorting.
+ */
+struct tnt_latency {
+	uint32_t samples[TNT_LATENCY_WINDOW]; /*!< ring of samples */
+	uint32_t sorted[TNT_LATENCY_WINDOW]; /*!< sorted copy of ring */
+	uint32_t count; /*!< count of samples in ring */
+	uint32_t pos; /*!< next position in ring */
+};
+
+/**
+ * \brief Add latency sample (in microseconds)
+ */
+void
+tnt_latency_add(struct tnt_latency *l, uint32_t usec);
+
+/**
+ * \brief Get latency percentile (in microseconds)
+ *
+ * \param l latency window
+ * \param p percentile in [0, 1] (0.5 is median)
+ *
+ * \returns latency in microseconds
+ * \retval  0 no samples
+ */
+uint32_t
+tnt_latency_percentile(struct tnt_latency *l, double p);
+
+/**
+ * \brief Replica of replica set
+ */
+struct tnt_replica {
+	struct tnt_stream *s; /*!< replica stream */
+	struct tnt_latency latency; /*!< latencies of reads */
+	uint64_t reads; /*!< count of reads sent to replica */
+	uint64_t wins; /*!< count of reads answered first by replica */
+	uint32_t stale; /*!< count of late replies, that must be dropped */
+	int failed; /*!< 1 after network error */
+};
+
+/**
+ * \brief Replica set with hedged reads
+ *
+ * Read is sent to replica with the lowest median latency. If there is no
+ * reply within hedge delay (percentile of the replica's latencies, but not
+ * less than min_delay), the same read is sent to the next best replica and
+ * the first reply wins. Reply, which comes late, is dropped by its sync,
+ * when it's read from stream next time.
+ */
+struct tnt_replicaset {
+	struct tnt_replica *replicas; /*!< replicas */
+	uint32_t count; /*!< count of replicas */
+	double percentile; /*!< hedge delay percentile (0.95 by default) */
+	uint32_t min_delay; /*!< min hedge delay, usec (1000 by default) */
+	uint32_t next; /*!< replica to prefer on ties */
+	uint64_t hedges; /*!< count of sent hedges */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create replica set
+ *
+ * \param rs    replica set pointer, maybe NULL
+ * \param count count of replicas
+ *
+ * If replica set pointer is NULL, then new replica set will be allocated.
+ *
+ * \returns replica set pointer
+ * \retval  NULL oom or zero count
+ *
+ * \code{.c}
+ * struct tnt_replicaset *rs = tnt_replicaset(NULL, 2);
+ * tnt_set(tnt_replicaset_member(rs, 0), TNT_OPT_URI, "replica1:3301");
+ * tnt_set(tnt_replicaset_member(rs, 1), TNT_OPT_URI, "replica2:3301");
+ * assert(tnt_replicaset_connect(rs) > 0);
+ * tnt_replicaset_hedge(rs, 0.99, 2000);
+ * struct tnt_reply reply;
+ * if (tnt_replicaset_select(rs, 512, 0, 1, 0, TNT_ITER_EQ, key,
+ *                           &reply) == 0) {
+ * 	...
+ * 	tnt_reply_free(&reply);
+ * }
+ * tnt_replicaset_free(rs);
+ * \endcode
+ */
+struct tnt_replicaset *
+tnt_replicaset(struct tnt_replicaset *rs, uint32_t count);
+
+/**
+ * \brief Get replica stream by number (to set its options)
+ *
+ * \returns replica stream
+ * \retval  NULL bad replica number
+ */
+struct tnt_stream *
+tnt_replicaset_member(struct tnt_replicaset *rs, uint32_t n);
+
+/**
+ * \brief Connect every replica in non-blocking mode
+ *
+ * Replicas, that haven't connected, are marked as failed.
+ *
+ * \returns count of connected replicas
+ * \retval  -1 no replica has connected
+ */
+int
+tnt_replicaset_connect(struct tnt_replicaset *rs);
+
+/**
+ * \brief Set hedge delay
+ *
+ * \param rs         replica set
+ * \param percentile percentile of replica's latencies in (0, 1]
+ * \param min_delay  lower bound of delay, usec
+ *
+ * \retval  0 ok
+ * \retval -1 bad percentile
+ */
+int
+tnt_replicaset_hedge(struct tnt_replicaset *rs, double percentile,
+		     uint32_t min_delay);
+
+/**
+ * \brief Get latency percentile of replica (in microseconds)
+ *
+ * \retval 0 no samples or bad replica number
+ */
+uint32_t
+tnt_replicaset_latency(struct tnt_replicaset *rs, uint32_t n, double p);
+
+/**
+ * \brief Request builder for hedged read
+ *
+ * Is called once per replica, read is sent to (so at most twice).
+ *
+ * \returns result of request builder
+ * \retval -1 error
+ */
+typedef ssize_t (*tnt_replicaset_build_t)(struct tnt_stream *s, void *arg);
+
+/**
+ * \brief Execute read with hedging
+ *
+ * \param rs    replica set
+ * \param build request builder
+ * \param arg   builder context
+ * \param r     reply to fill (must be freed by caller on success)
+ *
+ * \retval  0 ok (error reply of server is ok too)
+ * \retval -1 no replica has answered
+ */
+int
+tnt_replicaset_read(struct tnt_replicaset *rs, tnt_replicaset_build_t build,
+		    void *arg, struct tnt_reply *r);
+
+/**
+ * \brief Execute select with hedging \sa tnt_select
+ */
+int
+tnt_replicaset_select(struct tnt_replicaset *rs, uint32_t space,
+		      uint32_t index, uint32_t limit, uint32_t offset,
+		      uint8_t iterator, struct tnt_stream *key,
+		      struct tnt_reply *r);
+
+/**
+ * \brief Close every replica
+ */
+void
+tnt_replicaset_close(struct tnt_replicaset *rs);
+
+/**
+ * \brief Free replica set and its streams
+ */
+void
+tnt_replicaset_free(struct tnt_replicaset *rs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_REPLICASET_H_INCLUDED */
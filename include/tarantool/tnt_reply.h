@@ -71,6 +71,10 @@ struct tnt_reply {
 	const char *metadata_end; /*!< end if tuple metadata (NULL if not present) */
 	const char *sqlinfo;	/*!< map sqlinfo (NULL if not present) */
 	const char *sqlinfo_end;/*!< end if map sqlinfo (NULL if not present) */
+	uint64_t stmt_id;	/*!< prepared statement id (0 if not present) */
+	uint32_t bind_count;	/*!< count of statement parameters */
+	void (*buf_release)(void *);	/*!< releases buf, if it isn't owned by reply */
+	void *buf_owner;	/*!< argument for buf_release */
 };
 
 /*!
@@ -94,6 +98,9 @@ tnt_reply_init(struct tnt_reply *r);
 /*!
  * \brief Free previously inited reply object
  *
+ * If reply buffer is borrowed (e.g. reply was parsed in place inside of
+ * receive buffer), then the buffer is released instead of freeing.
+ *
  * \param r reply object pointer
  */
 void
@@ -37,6 +37,8 @@
 
 #include <tarantool/tnt_proto.h>
 
+struct tnt_format;
+
 struct tnt_request {
 	struct {
 		uint64_t sync; /*!< Request sync id. Generated when encoded */
@@ -188,6 +190,20 @@ tnt_request_set_key(struct tnt_request *req, struct tnt_stream *s);
 int
 tnt_request_set_key_format(struct tnt_request *req, const char *fmt, ...);
 
+/**
+ * \brief Set key from compiled format
+ *
+ * \param req request pointer
+ * \param fmt compiled format (\sa tnt_format_compile)
+ * \param ... arguments for format
+ *
+ * \retval 0  ok
+ * \retval -1 oom
+ */
+int
+tnt_request_set_key_compiled(struct tnt_request *req,
+			     const struct tnt_format *fmt, ...);
+
 /**
  * \brief Set function from string
  *
@@ -261,6 +277,20 @@ tnt_request_set_tuple(struct tnt_request *req, struct tnt_stream *s);
 int
 tnt_request_set_tuple_format(struct tnt_request *req, const char *fmt, ...);
 
+/**
+ * \brief Set tuple from compiled format
+ *
+ * \param req request pointer
+ * \param fmt compiled format (\sa tnt_format_compile)
+ * \param ... arguments for format
+ *
+ * \retval 0  ok
+ * \retval -1 oom
+ */
+int
+tnt_request_set_tuple_compiled(struct tnt_request *req,
+			       const struct tnt_format *fmt, ...);
+
 /**
  * \brief Set operations from predefined object
  *
@@ -374,4 +404,84 @@ tnt_request_upsert(struct tnt_request *req);
 struct tnt_request *
 tnt_request_ping(struct tnt_request *req);
 
+/**
+ * \brief Size of template header: length prefix (0xce + uint32) and
+ * header map with code and sync (0xcf + uint64)
+ */
+#define TNT_TMPL_HEAD_SIZE 18
+
+/**
+ * \brief Pre-encoded request template
+ *
+ * Everything, that is constant for requests of the same shape (type, space,
+ * index, limit, offset, iterator, function name), is encoded once. Length
+ * and sync are encoded with fixed width, so they're patched in place when
+ * request is written, and key/tuple are appended by reference.
+ */
+struct tnt_tmpl {
+	char head[TNT_TMPL_HEAD_SIZE]; /*!< length prefix and header */
+	char *body; /*!< body map, without key and tuple values */
+	size_t body_size; /*!< size of body */
+	size_t key_off; /*!< offset in body, where key is inserted */
+	size_t tuple_off; /*!< offset in body, where tuple is inserted */
+	int key; /*!< 1 if request has key (or operations for upsert) */
+	int tuple; /*!< 1 if request has tuple (or arguments for call/eval) */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Compile request template from request object
+ *
+ * \param req request object, that defines request shape. Its key and
+ *            tuple aren't used, except function name for call and
+ *            expression for eval, that are constant.
+ * \param t   template pointer, maybe NULL
+ *
+ * If template pointer is NULL, then new template will be allocated.
+ *
+ * \returns template pointer
+ * \retval  NULL oom or request type isn't supported (auth)
+ *
+ * \code{.c}
+ * struct tnt_request *req = tnt_request_select(NULL);
+ * tnt_request_set_space(req, 512);
+ * tnt_request_set_index(req, 1);
+ * tnt_request_set_limit(req, 10);
+ * struct tnt_tmpl *t = tnt_request_template(req, NULL);
+ * tnt_request_free(req);
+ * for (...) {
+ * 	tnt_object_reset(key);
+ * 	tnt_object_format(key, "[%d]", id);
+ * 	tnt_tmpl_write(s, t, key, NULL);
+ * }
+ * tnt_tmpl_free(t);
+ * \endcode
+ */
+struct tnt_tmpl *
+tnt_request_template(struct tnt_request *req, struct tnt_tmpl *t);
+
+/**
+ * \brief Write request from template into stream
+ *
+ * \param s     stream pointer
+ * \param t     template pointer
+ * \param key   key (operations for upsert) object, NULL - empty array
+ * \param tuple tuple (operations for update, arguments for call/eval)
+ *              object, NULL - empty array
+ *
+ * Values, that request of this type doesn't have, are ignored.
+ *
+ * \returns sync of request
+ * \retval  -1 error
+ */
+int64_t
+tnt_tmpl_write(struct tnt_stream *s, struct tnt_tmpl *t,
+	       struct tnt_stream *key, struct tnt_stream *tuple);
+
+/**
+ * \brief Free request template
+ */
+void
+tnt_tmpl_free(struct tnt_tmpl *t);
+
 #endif /* TNT_REQUEST_H_INCLUDED */
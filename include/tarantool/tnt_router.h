@@ -0,0 +1,252 @@
+#ifndef TNT_ROUTER_H_INCLUDED
+#define TNT_ROUTER_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_router.h
+ * \brief Client-side sharding router
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <sys/types.h>
+
+struct tnt_stream;
+struct tnt_reply;
+
+/**
+ * \brief Sharding router
+ *
+ * Router owns one tnt_net connection per shard. Sharding key (encoded
+ * msgpack) is hashed with PMurHash32 into one of buckets, and bucket is
+ * mapped to shard with bucket table. By default bucket b belongs to shard
+ * b % shard_count.
+ */
+struct tnt_router {
+	struct tnt_stream **shards; /*!< shard streams */
+	uint32_t shard_count; /*!< count of shards */
+	uint32_t *buckets; /*!< bucket -> shard table */
+	uint32_t bucket_count; /*!< count of buckets */
+	uint32_t seed; /*!< hash seed */
+	uint32_t last; /*!< shard of the last routed request */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create router
+ *
+ * \param r       router pointer, maybe NULL
+ * \param shards  count of shards
+ * \param buckets count of buckets (must be >= shards)
+ *
+ * If router pointer is NULL, then new router will be allocated.
+ *
+ * \returns router pointer
+ * \retval  NULL oom or bad counts
+ *
+ * \code{.c}
+ * struct tnt_router *r = tnt_router(NULL, 2, 1024);
+ * tnt_set(tnt_router_member(r, 0), TNT_OPT_URI, "shard1:3301");
+ * tnt_set(tnt_router_member(r, 1), TNT_OPT_URI, "shard2:3301");
+ * assert(tnt_router_connect(r) != -1);
+ * struct tnt_stream *s = tnt_router_get(r, key);
+ * tnt_insert(s, 512, tuple);
+ * tnt_flush(s);
+ * struct tnt_reply reply;
+ * tnt_reply_init(&reply);
+ * s->read_reply(s, &reply);
+ * ...
+ * tnt_router_free(r);
+ * \endcode
+ */
+struct tnt_router *
+tnt_router(struct tnt_router *r, uint32_t shards, uint32_t buckets);
+
+/**
+ * \brief Get shard stream by number (to set its options, read replies)
+ *
+ * \returns shard stream
+ * \retval  NULL bad shard number
+ */
+struct tnt_stream *
+tnt_router_member(struct tnt_router *r, uint32_t n);
+
+/**
+ * \brief Connect every shard
+ *
+ * \retval  0 ok
+ * \retval -1 some shard hasn't connected (see its stream error)
+ */
+int
+tnt_router_connect(struct tnt_router *r);
+
+/**
+ * \brief Map bucket to shard
+ *
+ * \retval  0 ok
+ * \retval -1 bad bucket or shard number
+ */
+int
+tnt_router_map(struct tnt_router *r, uint32_t bucket, uint32_t shard);
+
+/**
+ * \brief Get bucket of sharding key
+ */
+uint32_t
+tnt_router_bucket(struct tnt_router *r, struct tnt_stream *key);
+
+/**
+ * \brief Get shard stream, that owns sharding key (and set r->last)
+ */
+struct tnt_stream *
+tnt_router_get(struct tnt_router *r, struct tnt_stream *key);
+
+/**
+ * \brief Route select by its key \sa tnt_select
+ */
+ssize_t
+tnt_router_select(struct tnt_router *r, uint32_t space, uint32_t index,
+		  uint32_t limit, uint32_t offset, uint8_t iterator,
+		  struct tnt_stream *key);
+
+/**
+ * \brief Route insert by sharding key of tuple \sa tnt_insert
+ */
+ssize_t
+tnt_router_insert(struct tnt_router *r, uint32_t space,
+		  struct tnt_stream *key, struct tnt_stream *tuple);
+
+/**
+ * \brief Route replace by sharding key of tuple \sa tnt_replace
+ */
+ssize_t
+tnt_router_replace(struct tnt_router *r, uint32_t space,
+		   struct tnt_stream *key, struct tnt_stream *tuple);
+
+/**
+ * \brief Route update by its key \sa tnt_update
+ */
+ssize_t
+tnt_router_update(struct tnt_router *r, uint32_t space, uint32_t index,
+		  struct tnt_stream *key, struct tnt_stream *ops);
+
+/**
+ * \brief Route delete by its key \sa tnt_delete
+ */
+ssize_t
+tnt_router_delete(struct tnt_router *r, uint32_t space, uint32_t index,
+		  struct tnt_stream *key);
+
+/**
+ * \brief Route call by sharding key \sa tnt_call
+ */
+ssize_t
+tnt_router_call(struct tnt_router *r, struct tnt_stream *key,
+		const char *proc, size_t plen, struct tnt_stream *args);
+
+/**
+ * \brief Flush every shard
+ *
+ * \retval  0 ok
+ * \retval -1 network error on some shard
+ */
+int
+tnt_router_flush(struct tnt_router *r);
+
+/**
+ * \brief Request builder for batch item
+ *
+ * \param s   shard stream, that owns item's key
+ * \param n   item number
+ * \param arg builder context
+ *
+ * \returns result of request builder
+ * \retval -1 error
+ */
+typedef ssize_t (*tnt_router_batch_t)(struct tnt_stream *s, uint32_t n,
+				      void *arg);
+
+/**
+ * \brief Execute batch of multi-key requests
+ *
+ * Requests are grouped per shard and written into shard streams, then all
+ * shards are flushed and replies are read, so requests for every shard are
+ * pipelined and shards process them concurrently. Shards must be blocking
+ * streams without requests in flight.
+ *
+ * \param r       router pointer
+ * \param keys    sharding keys of items
+ * \param count   count of items
+ * \param build   request builder, writes one request per item
+ * \param arg     request builder context
+ * \param replies replies (reply n is for item n), they're initialized and
+ *                must be freed by caller; on error they're freed already
+ *
+ * \retval  0 ok (replies may contain errors)
+ * \retval -1 oom (TNT_EMEMORY in stream of r->last) or network error on
+ *            shard r->last; replies of requests in flight on other shards
+ *            are read and dropped (shard, which can't be drained, is
+ *            closed)
+ */
+int
+tnt_router_batch(struct tnt_router *r, struct tnt_stream **keys,
+		 uint32_t count, tnt_router_batch_t build, void *arg,
+		 struct tnt_reply *replies);
+
+/**
+ * \brief Select tuples by several keys (TNT_ITER_EQ) \sa tnt_router_batch
+ */
+int
+tnt_router_select_batch(struct tnt_router *r, uint32_t space, uint32_t index,
+			struct tnt_stream **keys, uint32_t count,
+			struct tnt_reply *replies);
+
+/**
+ * \brief Close every shard connection
+ */
+void
+tnt_router_close(struct tnt_router *r);
+
+/**
+ * \brief Close connections and free router
+ */
+void
+tnt_router_free(struct tnt_router *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_ROUTER_H_INCLUDED */
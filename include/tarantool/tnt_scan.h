@@ -0,0 +1,201 @@
+#ifndef TNT_SCAN_H_INCLUDED
+#define TNT_SCAN_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_scan.h
+ * \brief Parallel scan of index key ranges over several connections
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct tnt_stream;
+
+/**
+ * \brief Tuple callback
+ *
+ * Callback is executed in the thread, that scans the range, so callbacks
+ * for different ranges are executed in parallel.
+ *
+ * \param tuple tuple
+ * \param size  tuple size
+ * \param range number of range
+ * \param arg   callback context
+ *
+ * \retval  0 continue scan
+ * \retval -1 stop scan of all ranges
+ */
+typedef int (*tnt_scan_cb_t)(const char *tuple, size_t size, uint32_t range,
+			     void *arg);
+
+/**
+ * \brief Key range of scan
+ */
+struct tnt_scan_range {
+	struct tnt_stream *from; /*!< lower bound (inclusive), NULL - none */
+	struct tnt_stream *to; /*!< upper bound (exclusive), NULL - none */
+	uint64_t count; /*!< count of tuples passed to callback */
+	int status; /*!< 0 - ok, -1 - error on range's stream */
+};
+
+/**
+ * \brief Parallel scan
+ *
+ * Index key range is split into sub-ranges, that are scanned concurrently
+ * with tnt_cursor, every one over its own connection in its own thread.
+ */
+struct tnt_scan {
+	uint32_t space; /*!< space number */
+	uint32_t index; /*!< index number */
+	uint32_t page; /*!< count of tuples per page */
+	uint32_t range_count; /*!< count of ranges */
+	struct tnt_scan_range *ranges; /*!< ranges */
+	tnt_scan_cb_t cb; /*!< tuple callback */
+	void *arg; /*!< tuple callback context */
+	int stop; /*!< 1 if scan is stopped by callback */
+	int alloc; /*!< allocation mark */
+};
+
+/**
+ * \brief Create parallel scan
+ *
+ * \param sc     scan pointer, maybe NULL
+ * \param space  space number
+ * \param index  index number
+ * \param ranges count of ranges (and connections)
+ *
+ * If scan pointer is NULL, then new scan will be allocated. All ranges are
+ * unbounded, until they're set with tnt_scan_range or tnt_scan_split.
+ *
+ * \returns scan pointer
+ * \retval  NULL oom or ranges is 0
+ *
+ * \code{.c}
+ * static int
+ * process(const char *tuple, size_t size, uint32_t range, void *arg)
+ * {
+ * 	...
+ * 	return 0;
+ * }
+ *
+ * struct tnt_pool *pool = tnt_pool(NULL, 8);
+ * tnt_pool_set(pool, TNT_OPT_URI, "localhost:3301");
+ * tnt_pool_connect(pool);
+ * struct tnt_scan *sc = tnt_scan(NULL, 512, 0, 8);
+ * if (tnt_scan_split(sc, tnt_pool_member(pool, 0)) == -1 ||
+ *     tnt_scan_run(sc, pool->members, process, NULL) == -1)
+ * 	fprintf(stderr, "scan failed\n");
+ * tnt_scan_free(sc);
+ * \endcode
+ */
+struct tnt_scan *
+tnt_scan(struct tnt_scan *sc, uint32_t space, uint32_t index,
+	 uint32_t ranges);
+
+/**
+ * \brief Set count of tuples per page (\sa tnt_cursor_page)
+ */
+void
+tnt_scan_page(struct tnt_scan *sc, uint32_t page);
+
+/**
+ * \brief Set key range
+ *
+ * Keys are copied, partial keys are allowed (\sa tnt_cursor_range). Ranges
+ * shouldn't overlap, otherwise tuples are passed to callback several times.
+ *
+ * \param sc   scan pointer
+ * \param n    number of range
+ * \param from lower bound (inclusive), NULL - from the first tuple
+ * \param to   upper bound (exclusive), NULL - till the last tuple
+ *
+ * \retval  0 ok
+ * \retval -1 oom, bad range number or key isn't an array
+ */
+int
+tnt_scan_range(struct tnt_scan *sc, uint32_t n, struct tnt_stream *from,
+	       struct tnt_stream *to);
+
+/**
+ * \brief Split index into ranges by sampling its bounds
+ *
+ * The first and the last tuple of index are selected with \a s, and
+ * interval between values of their first key part is split into ranges
+ * of equal width. The first key part must be integer.
+ *
+ * \param sc scan pointer
+ * \param s  connected tnt_net stream without requests in flight
+ *
+ * \retval  0 ok
+ * \retval -1 error (stream error is set, TNT_EBADVAL if index isn't found
+ *            or its first key part isn't integer)
+ */
+int
+tnt_scan_split(struct tnt_scan *sc, struct tnt_stream *s);
+
+/**
+ * \brief Scan all ranges
+ *
+ * Range n is scanned over streams[n] in a separate thread. Streams must be
+ * connected, have no requests in flight and must not be used by caller
+ * until scan ends (members of tnt_pool may be used).
+ *
+ * \param sc      scan pointer
+ * \param streams tnt_net streams, one per range
+ * \param cb      tuple callback
+ * \param arg     tuple callback context
+ *
+ * \returns status
+ * \retval  0 all ranges are scanned
+ * \retval  1 scan is stopped by callback
+ * \retval -1 error on some range (\sa tnt_scan_range::status), or thread
+ *            creation failure
+ */
+int
+tnt_scan_run(struct tnt_scan *sc, struct tnt_stream **streams,
+	     tnt_scan_cb_t cb, void *arg);
+
+/**
+ * \brief Free scan
+ */
+void
+tnt_scan_free(struct tnt_scan *sc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_SCAN_H_INCLUDED */
@@ -38,6 +38,9 @@
  */
 
 struct mh_assoc_t;
+struct tnt_mem_ctx;
+struct tnt_mem_stats;
+struct tnt_schema_cache;
 
 /**
  * \internal
@@ -47,6 +50,9 @@ struct tnt_schema_ival {
 	const char *name;
 	uint32_t    name_len;
 	uint32_t    number;
+	int         unique;     /*!< 1 if index is unique */
+	uint32_t    part_count; /*!< 0 if parts are unknown */
+	uint32_t   *parts;      /*!< 0-based field numbers of key parts */
 };
 
 /**
@@ -62,10 +68,18 @@ struct tnt_schema_sval {
 
 /**
  * \brief Schema of tarantool instance
+ *
+ * Schema, that is loaded by connection, is an immutable snapshot: it's
+ * never changed after loading, and reloading creates a new one. Snapshot
+ * is refcounted, so it may be shared by connections (and threads).
  */
 struct tnt_schema {
 	struct mh_assoc_t *space_hash; /*!< hash with spaces */
 	int alloc; /*!< allocation mark */
+	struct tnt_mem_ctx *mem; /*!< allocator context for hash nodes */
+	struct tnt_mem_stats *stats; /*!< memory usage of owner */
+	int refs; /*!< count of references */
+	uint64_t version; /*!< schema id on server (0 if unknown) */
 };
 
 /**
@@ -130,6 +144,19 @@ int32_t
 tnt_schema_stoiid (struct tnt_schema *sch, uint32_t sno, const char *istr,
 		   uint32_t islen);
 
+/**
+ * \brief Get index definition by space no and index no
+ *
+ * \param sch schema pointer
+ * \param sno space no
+ * \param ino index no
+ *
+ * \returns index definition (owned by schema, valid while it's referenced)
+ * \retval NULL index/space not found
+ */
+const struct tnt_schema_ival *
+tnt_schema_index(struct tnt_schema *sch, uint32_t sno, uint32_t ino);
+
 /**
  * \brief Create and init schema object
  *
@@ -156,6 +183,103 @@ tnt_schema_flush(struct tnt_schema *sch);
 void
 tnt_schema_free(struct tnt_schema *sch);
 
+/**
+ * \brief Take reference to schema
+ * \param sch schema pointer
+ * \returns schema pointer
+ */
+struct tnt_schema *
+tnt_schema_ref(struct tnt_schema *sch);
+
+/**
+ * \brief Drop reference to schema
+ *
+ * Schema is freed, when the last reference is dropped.
+ *
+ * \param sch schema pointer (maybe NULL)
+ */
+void
+tnt_schema_unref(struct tnt_schema *sch);
+
+/**
+ * \brief Create schema cache
+ *
+ * Cache keeps the last version of schema, that is loaded by any of
+ * connections, which share it (TNT_OPT_SCHEMA_CACHE). Connections must
+ * be to the same instance or cluster.
+ *
+ * Versions are published RCU-style: readers take reference to the current
+ * snapshot without locks, and old snapshot is released by publisher after
+ * the readers are gone. Schema lookups go to snapshot, referenced by the
+ * connection, and don't touch the cache at all, unless it has a newer one.
+ *
+ * \code{.c}
+ * struct tnt_schema_cache *cache = tnt_schema_cache_new();
+ * for (int i = 0; i < 64; i++) {
+ * 	s[i] = tnt_net(NULL);
+ * 	tnt_set(s[i], TNT_OPT_URI, "login:password@localhost:3301");
+ * 	tnt_set(s[i], TNT_OPT_SCHEMA_CACHE, cache);
+ * 	tnt_connect(s[i]); // schema is downloaded once
+ * }
+ * ...
+ * for (int i = 0; i < 64; i++)
+ * 	tnt_stream_free(s[i]);
+ * tnt_schema_cache_free(cache);
+ * \endcode
+ *
+ * \returns new schema cache
+ * \retval  NULL oom
+ */
+struct tnt_schema_cache *
+tnt_schema_cache_new(void);
+
+/**
+ * \brief Free schema cache
+ *
+ * Cache must outlive connections, that use it. Snapshots, that are still
+ * referenced, aren't freed.
+ *
+ * \param cache schema cache (maybe NULL)
+ */
+void
+tnt_schema_cache_free(struct tnt_schema_cache *cache);
+
+/**
+ * \brief Get the current version of schema from cache
+ *
+ * \param cache schema cache
+ *
+ * \returns referenced snapshot (drop it with tnt_schema_unref)
+ * \retval  NULL schema isn't loaded yet
+ */
+struct tnt_schema *
+tnt_schema_cache_get(struct tnt_schema_cache *cache);
+
+/**
+ * \brief Publish new version of schema in cache
+ *
+ * Cache takes a reference to the snapshot, so it mustn't be changed
+ * anymore. The previous version is released.
+ *
+ * \param cache schema cache
+ * \param sch   schema pointer
+ */
+void
+tnt_schema_cache_publish(struct tnt_schema_cache *cache,
+			 struct tnt_schema *sch);
+
+/**
+ * \internal
+ * \brief Replace schema with the current version from cache
+ *
+ * Reference to \a sch is dropped, if cache has other version.
+ *
+ * \returns referenced snapshot
+ */
+struct tnt_schema *
+tnt_schema_cache_renew(struct tnt_schema_cache *cache,
+		       struct tnt_schema *sch);
+
 ssize_t
 tnt_get_space(struct tnt_stream *s);
 
@@ -0,0 +1,139 @@
+#ifndef TNT_STMT_H_INCLUDED
+#define TNT_STMT_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_stmt.h
+ * \brief Prepared SQL statements cache
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <sys/types.h>
+
+struct tnt_stream;
+
+/**
+ * \brief Result column of prepared statement
+ */
+struct tnt_stmt_column {
+	const char *name; /*!< column name (not zero-terminated) */
+	uint32_t name_len; /*!< column name length */
+	const char *type; /*!< column type (not zero-terminated) */
+	uint32_t type_len; /*!< column type length */
+};
+
+/**
+ * \brief Prepared statement
+ *
+ * Statement is owned by connection and is valid until the connection is
+ * closed, or the cache is cleared.
+ */
+struct tnt_stmt {
+	uint64_t id; /*!< statement id on server */
+	const char *sql; /*!< statement text */
+	size_t sql_len; /*!< statement text length */
+	uint32_t bind_count; /*!< count of parameters to bind */
+	uint32_t column_count; /*!< count of result columns */
+	struct tnt_stmt_column *columns; /*!< decoded result metadata */
+	const char *metadata; /*!< raw result metadata (msgpack array) */
+	size_t metadata_size; /*!< size of raw result metadata */
+};
+
+/**
+ * \brief Get prepared statement for SQL text
+ *
+ * Statement is looked up in cache of connection. If it isn't found, then
+ * it's prepared synchronously and put into cache. Prepare requires, that
+ * stream has no requests in flight.
+ *
+ * \param s   connected tnt_net stream
+ * \param sql SQL query string
+ * \param len query length
+ *
+ * \returns prepared statement
+ * \retval  NULL error (stream is busy, server error, oom or network error)
+ */
+const struct tnt_stmt *
+tnt_stmt_prepare(struct tnt_stream *s, const char *sql, size_t len);
+
+/**
+ * \brief Write request, that executes prepared statement, into stream
+ *
+ * Only statement id and parameters are sent. Result metadata of the
+ * statement is already decoded in stmt->columns.
+ *
+ * \param s      stream object to write request to
+ * \param stmt   statement, returned by tnt_stmt_prepare
+ * \param params tnt_object instance with messagepack array with params
+ *
+ * \retval number of bytes written to stream
+ */
+ssize_t
+tnt_stmt_execute(struct tnt_stream *s, const struct tnt_stmt *stmt,
+		 struct tnt_stream *params);
+
+/**
+ * \brief Write SQL request into stream, using prepared statement if possible
+ *
+ * Statement is prepared on first use (\sa tnt_stmt_prepare). If it can't
+ * be prepared, then full SQL text is sent (\sa tnt_execute).
+ *
+ * \param s      connected tnt_net stream
+ * \param sql    SQL query string
+ * \param len    query length
+ * \param params tnt_object instance with messagepack array with params
+ *
+ * \retval number of bytes written to stream
+ */
+ssize_t
+tnt_execute_prepared(struct tnt_stream *s, const char *sql, size_t len,
+		     struct tnt_stream *params);
+
+/**
+ * \brief Drop all prepared statements of connection
+ *
+ * Statements are forgotten by client only. Cache is cleared automatically,
+ * when connection is closed, because statement ids are session-local.
+ *
+ * \param s tnt_net stream
+ */
+void
+tnt_stmt_cache_clear(struct tnt_stream *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_STMT_H_INCLUDED */
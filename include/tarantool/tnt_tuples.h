@@ -0,0 +1,104 @@
+#ifndef TNT_TUPLES_H_INCLUDED
+#define TNT_TUPLES_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_tuples.h
+ * \brief Streaming of reply tuples
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+struct tnt_stream;
+struct tnt_reply;
+
+/**
+ * \brief Callback, that receives tuples of reply
+ *
+ * \param tuple tuple (msgpack value), valid only until callback returns
+ * \param size  size of tuple
+ * \param arg   user argument
+ *
+ * \retval  0 continue
+ * \retval -1 skip the rest of tuples
+ */
+typedef int (*tnt_tuple_cb_t)(const char *tuple, size_t size, void *arg);
+
+/**
+ * \brief Read next reply, passing its tuples to callback as they arrive
+ *
+ * Unlike read_reply, reply body isn't buffered as a whole: every tuple of
+ * TNT_DATA array is passed to callback as soon as it's in receive buffer,
+ * and then dropped. So memory is bounded by the largest tuple, not by the
+ * reply size. Other fields of reply (error, metadata, sqlinfo) are set in
+ * reply as usual, but reply.data is NULL.
+ *
+ * Works on blocking tnt_net streams only. Like read_reply, requests lost
+ * on reconnect are reported first (TNT_ELOST). Reply of request with async
+ * callback (\sa tnt_async_register) is read as a whole and handed to the
+ * callback, and then the next reply is read.
+ *
+ * \param s   tnt_net stream
+ * \param r   reply object (\sa tnt_reply_init)
+ * \param cb  tuple callback
+ * \param arg argument for callback
+ *
+ * \retval  0 ok
+ * \retval  1 no requests in flight
+ * \retval -1 error (network/oom/parsing, or stream isn't blocking)
+ *
+ * \code{.c}
+ * static int
+ * export_tuple(const char *tuple, size_t size, void *arg) {
+ * 	return fwrite(tuple, 1, size, (FILE *)arg) == size ? 0 : -1;
+ * }
+ * ...
+ * tnt_select(s, space, 0, UINT32_MAX, 0, TNT_ITER_ALL, key);
+ * tnt_flush(s);
+ * struct tnt_reply r; tnt_reply_init(&r);
+ * if (tnt_reply_tuples(s, &r, export_tuple, file) == 0 && r.error == NULL)
+ * 	...
+ * tnt_reply_free(&r);
+ * \endcode
+ */
+int
+tnt_reply_tuples(struct tnt_stream *s, struct tnt_reply *r,
+		 tnt_tuple_cb_t cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_TUPLES_H_INCLUDED */
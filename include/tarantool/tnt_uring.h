@@ -0,0 +1,139 @@
+#ifndef TNT_URING_H_INCLUDED
+#define TNT_URING_H_INCLUDED
+
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file tnt_uring.h
+ * \brief io_uring transport backend for tnt_net streams
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+struct tnt_stream;
+
+/**
+ * \brief io_uring instance, shared by many tnt_net streams
+ *
+ * Streams are attached with TNT_OPT_URING and then driven with
+ * tnt_uring_run, that submits sends and receives of all attached streams
+ * with a single io_uring_enter(2) call. Send and receive buffers of
+ * streams are registered with the ring, if kernel supports it.
+ *
+ * Ring isn't thread-safe, as tnt_net streams aren't.
+ */
+struct tnt_uring;
+
+/**
+ * \brief Create io_uring instance
+ *
+ * \param entries count of submission queue entries, every attached
+ *                stream may use two of them
+ *
+ * \returns ring pointer
+ * \retval  NULL library is built without io_uring support (errno is set
+ *               to ENOSYS), kernel doesn't support it or oom
+ *
+ * \code{.c}
+ * struct tnt_uring *ring = tnt_uring_new(256);
+ * assert(ring);
+ * assert(tnt_set(s, TNT_OPT_URI, "localhost:3301") != -1);
+ * assert(tnt_set(s, TNT_OPT_URING, ring) != -1);
+ * assert(tnt_connect(s) != -1);
+ * ...
+ * while (tnt_async_count(s) > 0)
+ * 	if (tnt_uring_run(ring, 1) == -1)
+ * 		break;
+ * \endcode
+ */
+struct tnt_uring *
+tnt_uring_new(uint32_t entries);
+
+/**
+ * \brief Detach all streams and free io_uring instance
+ *
+ * Detached streams stay connected in non-blocking mode.
+ */
+void
+tnt_uring_free(struct tnt_uring *ring);
+
+/**
+ * \brief Make progress on all attached streams
+ *
+ * Send buffers of all streams are sent and receives are armed for streams
+ * with requests in flight, then all of them are submitted at once.
+ * Received replies are dispatched to their callbacks
+ * (\sa tnt_async_register), replies without callbacks are dropped.
+ *
+ * On stream error all its pending callbacks are executed with error set,
+ * and stream isn't served by ring anymore, until it's reconnected.
+ *
+ * \param ring io_uring instance
+ * \param wait 1 - wait for at least one completion, if any io is in
+ *             flight, 0 - never block
+ *
+ * \returns count of processed replies
+ * \retval  -1 io_uring error (errno is set)
+ */
+int
+tnt_uring_run(struct tnt_uring *ring, int wait);
+
+/**
+ * \internal
+ * \brief Attach connected stream to ring and switch it to non-blocking mode
+ *
+ * \retval  0 ok
+ * \retval -1 error (stream error is set)
+ */
+int
+tnt_uring_attach(struct tnt_uring *ring, struct tnt_stream *s);
+
+/**
+ * \internal
+ * \brief Detach stream from ring, waiting for its receive to be cancelled
+ *
+ * If ring fails, while requests of stream are in flight, stream gets
+ * TNT_ESYSTEM and its buffers are left to ring until requests complete.
+ *
+ * \returns ring, that stream was attached to (NULL if it wasn't)
+ */
+struct tnt_uring *
+tnt_uring_detach(struct tnt_stream *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TNT_URING_H_INCLUDED */
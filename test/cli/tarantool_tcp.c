@@ -3,12 +3,29 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <poll.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
 #include <msgpuck.h>
 
 #include <tarantool/tarantool.h>
 
 #include <tarantool/tnt_net.h>
 #include <tarantool/tnt_opt.h>
+#include <tarantool/tnt_async.h>
+#include <tarantool/tnt_pool.h>
+#include <tarantool/tnt_uring.h>
+#include <tarantool/tnt_bulk.h>
+#include <tarantool/tnt_stmt.h>
+#include <tarantool/tnt_tuples.h>
+#include <tarantool/tnt_cursor.h>
+#include <tarantool/tnt_scan.h>
+#include <tarantool/tnt_router.h>
+#include <tarantool/tnt_merge.h>
+#include <tarantool/tnt_replicaset.h>
 
 #include "common.h"
 
@@ -233,6 +250,122 @@ test_object() {
 	return check_plan();
 }
 
+static int
+test_object_deferred() {
+	plan(8);
+	header();
+
+	struct tnt_stream *s = tnt_object(NULL), *e = tnt_object(NULL);
+	is  (tnt_object_type(s, TNT_SBO_DEFERRED), 0, "Check type set");
+
+	/* array of 1000 maps, sizes are known for SIMPLE packing */
+	tnt_object_add_array(s, 0);
+	tnt_object_add_array(e, 1000);
+	for (int i = 0; i < 1000; ++i) {
+		tnt_object_add_map(s, 0);
+		tnt_object_add_map(e, 20);
+		for (int j = 0; j < 20; ++j) {
+			tnt_object_add_int(s, j);
+			tnt_object_add_int(s, i);
+			tnt_object_add_int(e, j);
+			tnt_object_add_int(e, i);
+		}
+		tnt_object_container_close(s);
+	}
+	is  (tnt_object_container_close(s), 0, "Closing array");
+	ok  (TNT_SBUF_SIZE(s) == TNT_SBUF_SIZE(e) &&
+	     memcmp(TNT_SBUF_DATA(s), TNT_SBUF_DATA(e),
+		    TNT_SBUF_SIZE(s)) == 0, "Minimal headers");
+
+	/* nothing is moved before the outermost container is closed */
+	tnt_object_reset(s);
+	tnt_object_type(s, TNT_SBO_DEFERRED);
+	tnt_object_add_array(s, 0);
+	tnt_object_add_map(s, 0);
+	tnt_object_add_int(s, 1);
+	tnt_object_add_int(s, 2);
+	tnt_object_container_close(s);
+	is  (TNT_SBUF_SIZE(s), 12, "Nested header isn't shrunk on close");
+	tnt_object_container_close(s);
+	ok  (TNT_SBUF_SIZE(s) == 4 &&
+	     memcmp(TNT_SBUF_DATA(s), "\x91\x81\x01\x02", 4) == 0,
+	     "Headers are shrunk on outermost close");
+
+	/* nesting deeper than 128 containers */
+	tnt_object_reset(s);
+	tnt_object_reset(e);
+	tnt_object_type(s, TNT_SBO_DEFERRED);
+	for (int i = 0; i < 300; ++i) {
+		tnt_object_add_array(s, 0);
+		tnt_object_add_array(e, i < 299 ? 1 : 0);
+	}
+	int closed = 0;
+	for (int i = 0; i < 300; ++i)
+		closed += (tnt_object_container_close(s) == 0);
+	is  (closed, 300, "Closing nested containers");
+	ok  (TNT_SBUF_SIZE(s) == TNT_SBUF_SIZE(e) &&
+	     memcmp(TNT_SBUF_DATA(s), TNT_SBUF_DATA(e),
+		    TNT_SBUF_SIZE(s)) == 0, "Nested containers");
+	is  (tnt_object_verify(s, MP_ARRAY), 0, "Check object validity");
+
+	tnt_stream_free(s);
+	tnt_stream_free(e);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_format_compile() {
+	plan(8);
+	header();
+
+	const char *fmt = "[%d %u {%s %lf %.*s [NIL %b]} %lld %llu %hhd %f "
+			  "[[[%s]]] %%]";
+	char big[300]; memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = 0;
+	struct tnt_format *f = tnt_format_compile(fmt);
+	isnt(f, NULL, "Compiling format");
+
+	struct tnt_stream *s1 = tnt_object(NULL), *s2 = tnt_object(NULL);
+	ssize_t rv = tnt_object_format(s1, fmt, -5, 100000u, "key", 1.5, 3,
+				       "abcdef", true, -(1LL << 40),
+				       1ULL << 40, (char )-1, 2.5f, big);
+	is  (tnt_format_exec(s2, f, -5, 100000u, "key", 1.5, 3, "abcdef",
+			     true, -(1LL << 40), 1ULL << 40, (char )-1, 2.5f,
+			     big), rv, "Size of encoded values");
+	ok  (TNT_SBUF_SIZE(s1) == TNT_SBUF_SIZE(s2) &&
+	     memcmp(TNT_SBUF_DATA(s1), TNT_SBUF_DATA(s2),
+		    TNT_SBUF_SIZE(s1)) == 0, "Same encoding as tnt_object_format");
+	is  (tnt_object_verify(s2, MP_ARRAY), 0, "Check object validity");
+
+	/* appending to open container */
+	tnt_format_free(f);
+	f = tnt_format_compile("%d %s");
+	tnt_object_reset(s2);
+	tnt_object_type(s2, TNT_SBO_PACKED);
+	tnt_object_add_array(s2, 0);
+	tnt_format_exec(s2, f, 1, "a");
+	tnt_format_exec(s2, f, 2, "b");
+	tnt_object_container_close(s2);
+	tnt_object_reset(s1);
+	tnt_object_format(s1, "[%d%s%d%s]", 1, "a", 2, "b");
+	ok  (TNT_SBUF_SIZE(s1) == TNT_SBUF_SIZE(s2) &&
+	     memcmp(TNT_SBUF_DATA(s1), TNT_SBUF_DATA(s2),
+		    TNT_SBUF_SIZE(s1)) == 0, "Appending to container");
+	tnt_format_free(f);
+
+	is  (tnt_format_compile("[%d"), NULL, "Unbalanced brackets");
+	is  (tnt_format_compile("{%d}"), NULL, "Odd count of map values");
+	is  (tnt_format_compile("[%q]"), NULL, "Bad format specifier");
+
+	tnt_stream_free(s1);
+	tnt_stream_free(s2);
+
+	footer();
+	return check_plan();
+}
+
 static int
 test_request_01(char *uri) {
 	plan(5);
@@ -782,66 +915,1820 @@ test_msgpack_mapa_iter() {
 	return check_plan();
 }
 
-static int test_pushes(const char *uri) {
-	struct tnt_stream *tnt = NULL;
-	tnt = tnt_net(NULL);
-	assert(tnt != NULL);
-	int rv = tnt_set(tnt, TNT_OPT_URI, uri);
-	assert(rv != -1);
-	rv = tnt_connect(tnt);
-	assert(rv != -1);
+struct async_result {
+	int      done;   /* order of completion, 0 if not completed */
+	uint64_t value;  /* value returned from function */
+};
 
-	struct tnt_request *subscribe = tnt_request_call(NULL);
-	tnt_request_set_funcz(subscribe, "test_5");
-	uint64_t sync = tnt_request_compile(tnt, subscribe);
-	(void )sync;
+static int async_order = 0;
+
+static void
+test_async_cb(struct tnt_stream *s, struct tnt_reply *r, enum tnt_error error,
+	      void *arg)
+{
+	(void )s;
+	struct async_result *res = arg;
+	if (error != TNT_EOK || r->error != NULL)
+		return;
+	const char *pos = r->data;
+	if (mp_typeof(*pos) != MP_ARRAY || mp_decode_array(&pos) != 1)
+		return;
+	if (mp_typeof(*pos) == MP_UINT)
+		res->value = mp_decode_uint(&pos);
+	res->done = ++async_order;
+}
+
+static int
+test_async(char *uri) {
+	plan(10);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	struct async_result slow, fast[4];
+	memset(&slow, 0, sizeof(slow));
+	memset(fast, 0, sizeof(fast));
+
+	struct tnt_stream *arg = tnt_object(NULL);
+	tnt_object_format(arg, "[%lf]", 0.2);
+	tnt_call(tnt, "test_sleep", 10, arg);
+	tnt_stream_free(arg);
+	is  (tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb, &slow),
+	     0, "Register slow request");
+	is  (tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb, &slow),
+	     -1, "Register slow request twice");
+
+	for (int i = 0; i < 4; ++i) {
+		arg = tnt_object(NULL);
+		tnt_object_format(arg, "[%d%d]", i, i);
+		tnt_call(tnt, "test_3", 6, arg);
+		tnt_stream_free(arg);
+		tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb,
+				   &fast[i]);
+	}
+	is  (tnt_async_count(tnt), 5, "Count of pending requests");
+	is  (tnt_async_dispatch(tnt, 0), 5, "Dispatch replies");
+	is  (tnt_async_count(tnt), 0, "No pending requests left");
+
+	int fast_ok = 1;
+	for (int i = 0; i < 4; ++i) {
+		if (!fast[i].done || fast[i].value != (uint64_t)(2 * i))
+			fast_ok = 0;
+	}
+	is  (fast_ok, 1, "Fast requests completed with right values");
+	is  (slow.done, 5, "Slow request completed last");
+
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_nonblock(char *uri) {
+	plan(10);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_set(tnt, TNT_OPT_NONBLOCK, 1), -1, "Setting non-blocking mode");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+	isnt(fcntl(tnt_fd(tnt), F_GETFL) & O_NONBLOCK, 0,
+	     "Socket is non-blocking");
+
+	struct async_result slow, fast[16];
+	memset(&slow, 0, sizeof(slow));
+	memset(fast, 0, sizeof(fast));
+	async_order = 0;
+
+	struct tnt_stream *arg = tnt_object(NULL);
+	tnt_object_format(arg, "[%lf]", 0.2);
+	tnt_call(tnt, "test_sleep", 10, arg);
+	tnt_stream_free(arg);
+	tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb, &slow);
+	for (int i = 0; i < 16; ++i) {
+		arg = tnt_object(NULL);
+		tnt_object_format(arg, "[%d%d]", i, i);
+		tnt_call(tnt, "test_3", 6, arg);
+		tnt_stream_free(arg);
+		tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb,
+				   &fast[i]);
+	}
+	is  (tnt_wants(tnt), TNT_WANT_READ | TNT_WANT_WRITE,
+	     "Stream wants to read and write");
+
+	int rc = 0;
+	struct pollfd pfd = { tnt_fd(tnt), 0, 0 };
+	while (tnt_async_count(tnt) > 0 && rc != -1) {
+		int wants = tnt_wants(tnt);
+		pfd.events = ((wants & TNT_WANT_READ)  ? POLLIN  : 0) |
+			     ((wants & TNT_WANT_WRITE) ? POLLOUT : 0);
+		if (poll(&pfd, 1, 1000) <= 0)
+			break;
+		rc = tnt_process_io(tnt);
+	}
+	isnt(rc, -1, "Process io");
+	is  (tnt_wants(tnt), 0, "Stream wants nothing");
+
+	int fast_ok = 1;
+	for (int i = 0; i < 16; ++i) {
+		if (!fast[i].done || fast[i].value != (uint64_t)(2 * i))
+			fast_ok = 0;
+	}
+	is  (fast_ok, 1, "Fast requests completed with right values");
+	is  (slow.done, 17, "Slow request completed last");
+
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_zerocopy(char *uri) {
+	plan(8);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_set(tnt, TNT_OPT_ZEROCOPY, 1), -1, "Setting zero-copy mode");
+	/* small buffer, so retained replies are spread over several chunks */
+	isnt(tnt_set(tnt, TNT_OPT_RECV_BUF, 256), -1, "Setting recv buffer");
+	isnt(tnt_connect(tnt), -1, "Connecting");
 
+	struct tnt_reply reps[64];
+	for (int i = 0; i < 64; ++i) {
+		struct tnt_stream *arg = tnt_object(NULL);
+		tnt_object_format(arg, "[%d%d]", i, i);
+		tnt_call(tnt, "test_3", 6, arg);
+		tnt_stream_free(arg);
+	}
 	tnt_flush(tnt);
 
-	bool supports_push = true, ended = false;
-	int count = 0;
-	struct tnt_iter it; tnt_iter_reply(&it, tnt);
+	int read_ok = 1;
+	for (int i = 0; i < 64; ++i) {
+		tnt_reply_init(&reps[i]);
+		if (tnt->read_reply(tnt, &reps[i]) != 0)
+			read_ok = 0;
+	}
+	is  (read_ok, 1, "Read replies");
+
+	int data_ok = 1;
+	for (int i = 0; i < 64 && read_ok; ++i) {
+		const char *pos = reps[i].data;
+		if (reps[i].error != NULL || pos == NULL ||
+		    mp_typeof(*pos) != MP_ARRAY || mp_decode_array(&pos) != 1 ||
+		    mp_typeof(*pos) != MP_UINT ||
+		    mp_decode_uint(&pos) != (uint64_t)(2 * i))
+			data_ok = 0;
+	}
+	is  (data_ok, 1, "Retained replies are valid");
+	int borrowed = 1;
+	for (int i = 0; i < 64; ++i) {
+		if (reps[i].buf_release == NULL)
+			borrowed = 0;
+		tnt_reply_free(&reps[i]);
+	}
+	is  (borrowed, 1, "Replies point into recv buffer");
+
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_send_zerocopy(char *uri) {
+	plan(8);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_set(tnt, TNT_OPT_SEND_ZEROCOPY, 1024), -1,
+	     "Setting zero-copy send");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	static char big[16384];
+	memset(big, 'x', sizeof(big));
+	struct tnt_stream *tuples[8];
+	for (int i = 0; i < 8; ++i) {
+		tuples[i] = tnt_object(NULL);
+		tnt_object_format(tuples[i], "[%d%d%.*s]", 1000 + i, i,
+				  (int)sizeof(big), big);
+		tnt_replace(tnt, 512, tuples[i]);
+	}
+	ok  (TNT_SNET_CAST(tnt)->sbuf.off < 1024,
+	     "Payload isn't copied into send buffer");
+	isnt(tnt_flush(tnt), -1, "Flushing");
+	for (int i = 0; i < 8; ++i)
+		tnt_stream_free(tuples[i]);
+
+	int data_ok = 1;
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
 	while (tnt_next(&it)) {
-		assert(ended == false);
 		struct tnt_reply *r = TNT_IREPLY_PTR(&it);
-		if ((r->code & TNT_CHUNK) != 0) {
-			count += 1;
-		} else {
-			const char *pos = r->data;
-			assert(mp_typeof(*pos) == MP_ARRAY);
-			int len = mp_decode_array(&pos);
-			assert(len == 1);
-			assert(mp_typeof(*pos) == MP_BOOL);
-			supports_push = mp_decode_bool(&pos);
-			ended = true;
+		const char *pos = r->data;
+		uint32_t len = 0;
+		if (r->error != NULL || pos == NULL ||
+		    mp_decode_array(&pos) != 1 || mp_decode_array(&pos) != 3) {
+			data_ok = 0;
+			continue;
 		}
+		mp_next(&pos);
+		mp_next(&pos);
+		mp_decode_str(&pos, &len);
+		if (len != sizeof(big))
+			data_ok = 0;
 	}
-	tnt_close(tnt);
+	tnt_iter_free(&it);
+	is  (data_ok, 1, "Tuples are stored");
 
-	plan(2);
+	for (int i = 0; i < 8; ++i) {
+		struct tnt_stream *key = tnt_object(NULL);
+		tnt_object_format(key, "[%d]", 1000 + i);
+		tnt_delete(tnt, 512, 0, key);
+		tnt_stream_free(key);
+	}
+	tnt_flush(tnt);
+	int deleted = 0;
+	tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it))
+		deleted++;
+	tnt_iter_free(&it);
+	is  (deleted, 8, "Cleanup");
+
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_pool(char *uri) {
+	plan(7);
 	header();
 
-	if (supports_push) {
-		is(count, 10,   "Got 10 results");
-		is(ended, true, "Received response from server");
-	} else {
-		skip("server don't support pushes");
-		skip("server don't support pushes");
+	struct tnt_pool *pool = tnt_pool(NULL, 3);
+	isnt(pool, NULL, "Check pool creation");
+	isnt(tnt_pool_set(pool, TNT_OPT_URI, uri), -1, "Setting URI");
+	is  (tnt_pool_connect(pool), 3, "Connecting");
+
+	struct async_result res[6];
+	memset(res, 0, sizeof(res));
+	async_order = 0;
+	for (int i = 0; i < 6; ++i) {
+		struct tnt_stream *tnt = tnt_pool_get(pool);
+		struct tnt_stream *arg = tnt_object(NULL);
+		tnt_object_format(arg, "[%d%d]", i, i);
+		tnt_call(tnt, "test_3", 6, arg);
+		tnt_stream_free(arg);
+		tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb,
+				   &res[i]);
+	}
+	int balanced = 1;
+	for (int i = 0; i < 3; ++i) {
+		if (tnt_pool_member(pool, i)->wrcnt != 2)
+			balanced = 0;
 	}
+	is  (balanced, 1, "Requests are spread over members");
+	is  (tnt_pool_dispatch(pool), 6, "Dispatch replies");
 
+	int res_ok = 1;
+	for (int i = 0; i < 6; ++i) {
+		if (!res[i].done || res[i].value != (uint64_t)(2 * i))
+			res_ok = 0;
+	}
+	is  (res_ok, 1, "Requests completed with right values");
+	is  (tnt_pool_get(pool)->wrcnt, 0, "No requests in flight");
+
+	tnt_pool_free(pool);
 
 	footer();
 	return check_plan();
 }
 
-int main() {
+static int
+test_uring(char *uri) {
+	plan(7);
+	header();
+
+	struct tnt_uring *ring = tnt_uring_new(64);
+	if (ring == NULL) {
+		for (int i = 0; i < 7; ++i)
+			skip("io_uring isn't available");
+		footer();
+		return check_plan();
+	}
+	struct tnt_pool *pool = tnt_pool(NULL, 3);
+	isnt(tnt_pool_set(pool, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_pool_set(pool, TNT_OPT_URING, ring), -1, "Setting io_uring");
+	is  (tnt_pool_connect(pool), 3, "Connecting");
+
+	struct async_result res[6];
+	memset(res, 0, sizeof(res));
+	async_order = 0;
+	for (int i = 0; i < 6; ++i) {
+		struct tnt_stream *tnt = tnt_pool_get(pool);
+		struct tnt_stream *arg = tnt_object(NULL);
+		tnt_object_format(arg, "[%d%d]", i, i);
+		tnt_call(tnt, "test_3", 6, arg);
+		tnt_stream_free(arg);
+		tnt_async_register(tnt, tnt_async_last(tnt), test_async_cb,
+				   &res[i]);
+	}
+	int processed = 0, rc = 0;
+	while (rc != -1 && processed < 6) {
+		rc = tnt_uring_run(ring, 1);
+		processed += (rc > 0) ? rc : 0;
+	}
+	is  (processed, 6, "Replies are received through io_uring");
+
+	int res_ok = 1;
+	for (int i = 0; i < 6; ++i) {
+		if (!res[i].done || res[i].value != (uint64_t)(2 * i))
+			res_ok = 0;
+	}
+	is  (res_ok, 1, "Requests completed with right values");
+	is  (tnt_pool_get(pool)->wrcnt, 0, "No requests in flight");
+	is  (tnt_reload_schema(tnt_pool_member(pool, 0)), 0,
+	     "Reloading schema of attached stream");
+
+	tnt_pool_free(pool);
+	tnt_uring_free(ring);
+
+	footer();
+	return check_plan();
+}
+
+struct bulk_state {
+	int next;      /* number of next tuple */
+	int count;     /* count of tuples to produce */
+	int errors;    /* count of reported errors */
+	int errors_ok; /* 1 if errors are reported for right tuples */
+};
+
+static int
+test_bulk_source(struct tnt_stream *tuple, void *arg)
+{
+	struct bulk_state *st = arg;
+	if (st->next == st->count)
+		return 0;
+	/* every 500th tuple duplicates previous one */
+	int id = 2000 + st->next - (st->next % 500 == 499);
+	tnt_object_format(tuple, "[%d%d%s]", id, st->next, "bulk");
+	st->next++;
+	return 1;
+}
+
+static void
+test_bulk_error(uint64_t n, struct tnt_reply *r, void *arg)
+{
+	struct bulk_state *st = arg;
+	if (n % 500 != 499 || r->error == NULL)
+		st->errors_ok = 0;
+	st->errors++;
+}
+
+static int
+test_bulk(char *uri) {
+	plan(8);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	struct bulk_state st = { 0, 1000, 0, 1 };
+	struct tnt_bulk *b = tnt_bulk(NULL, tnt, 512, TNT_OP_INSERT);
+	isnt(b, NULL, "Check loader creation");
+	tnt_bulk_window(b, 64);
+	tnt_bulk_source(b, test_bulk_source, &st);
+	tnt_bulk_on_error(b, test_bulk_error, &st);
+	int rc = tnt_bulk_run(b);
+	/* other requests between runs don't shift tuple numbers */
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	tnt->read_reply(tnt, &reply);
+	tnt_reply_free(&reply);
+	st.count = 2000;
+	ok  (rc == 0 && tnt_bulk_run(b) == 0, "Loading tuples");
+	ok  (b->sent == 2000 && b->loaded == 1996 && b->failed == 4,
+	     "Loaded and failed tuples are counted");
+	ok  (st.errors == 4 && st.errors_ok, "Failed tuples are reported");
+	tnt_bulk_free(b);
+
+	for (int i = 0; i < 2000; ++i) {
+		struct tnt_stream *key = tnt_object(NULL);
+		tnt_object_format(key, "[%d]", 2000 + i);
+		tnt_delete(tnt, 512, 0, key);
+		tnt_stream_free(key);
+	}
+	tnt_flush(tnt);
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
+	int deleted = 0;
+	while (tnt_next(&it))
+		deleted++;
+	tnt_iter_free(&it);
+	is  (deleted, 2000, "Cleanup");
+
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_tmpl(char *uri) {
+	plan(8);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	struct tnt_request *req = tnt_request_replace(NULL);
+	tnt_request_set_space(req, 512);
+	struct tnt_tmpl *replace = tnt_request_template(req, NULL);
+	tnt_request_free(req);
+	req = tnt_request_select(NULL);
+	tnt_request_set_space(req, 512);
+	tnt_request_set_limit(req, 1);
+	struct tnt_tmpl *select = tnt_request_template(req, NULL);
+	tnt_request_free(req);
+	req = tnt_request_delete(NULL);
+	tnt_request_set_space(req, 512);
+	struct tnt_tmpl *delete = tnt_request_template(req, NULL);
+	tnt_request_free(req);
+	req = tnt_request_call(NULL);
+	tnt_request_set_funcz(req, "test_3");
+	struct tnt_tmpl *call = tnt_request_template(req, NULL);
+	tnt_request_free(req);
+	ok  (replace && select && delete && call, "Compiling templates");
+
+	struct tnt_stream *obj = tnt_object(NULL);
+	for (int i = 0; i < 3; ++i) {
+		tnt_object_reset(obj);
+		tnt_object_format(obj, "[%d%d%s]", 3000 + i, i, "tmpl");
+		tnt_tmpl_write(tnt, replace, NULL, obj);
+	}
+	for (int i = 0; i < 3; ++i) {
+		tnt_object_reset(obj);
+		tnt_object_format(obj, "[%d]", 3000 + i);
+		tnt_tmpl_write(tnt, select, obj, NULL);
+	}
+	tnt_object_reset(obj);
+	tnt_object_format(obj, "[%d%d]", 20, 22);
+	int64_t sync = tnt_tmpl_write(tnt, call, NULL, obj);
+	is  ((uint64_t)sync, tnt_async_last(tnt), "Sync of the last request");
+	tnt_flush(tnt);
+
+	int n = 0, replaced = 0, selected = 0, called = 0;
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it)) {
+		struct tnt_reply *r = TNT_IREPLY_PTR(&it);
+		const char *pos = r->data;
+		if (r->error != NULL || pos == NULL ||
+		    mp_decode_array(&pos) != 1) {
+			n++;
+			continue;
+		}
+		if (n < 6) {
+			uint32_t fields = mp_decode_array(&pos);
+			if (fields == 3 && mp_decode_uint(&pos) ==
+					   (uint64_t)(3000 + n % 3)) {
+				if (n < 3)
+					replaced++;
+				else
+					selected++;
+			}
+		} else if (mp_decode_uint(&pos) == 42) {
+			called++;
+		}
+		n++;
+	}
+	tnt_iter_free(&it);
+	ok  (replaced == 3 && selected == 3, "Replace and select templates");
+	is  (called, 1, "Call template");
+
+	for (int i = 0; i < 3; ++i) {
+		tnt_object_reset(obj);
+		tnt_object_format(obj, "[%d]", 3000 + i);
+		tnt_tmpl_write(tnt, delete, obj, NULL);
+	}
+	tnt_flush(tnt);
+	int deleted = 0;
+	tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it))
+		deleted++;
+	tnt_iter_free(&it);
+	is  (deleted, 3, "Delete template");
+
+	tnt_stream_free(obj);
+	tnt_tmpl_free(replace);
+	tnt_tmpl_free(select);
+	tnt_tmpl_free(delete);
+	tnt_tmpl_free(call);
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_prepare(char *uri) {
 	plan(10);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	/* Skip tests on Tarantool 1x. */
+	struct tnt_stream_net *sn = TNT_SNET_CAST(tnt);
+	if (strncmp(sn->greeting, "Tarantool 1.", 12) == 0) {
+		tnt_stream_free(tnt);
+		for (int i = 0; i < 7; ++i)
+			skip("Tarantool 2x required");
+		footer();
+		return check_plan();
+	}
+
+	const char *query = "SELECT ?";
+	const struct tnt_stmt *stmt = tnt_stmt_prepare(tnt, query,
+						       strlen(query));
+	isnt(stmt, NULL, "Prepare statement");
+	if (stmt == NULL) {
+		tnt_stream_free(tnt);
+		for (int i = 0; i < 6; ++i)
+			skip("PREPARE isn't supported");
+		footer();
+		return check_plan();
+	}
+	ok  (stmt->bind_count == 1 && stmt->column_count == 1 &&
+	     stmt->columns[0].name_len == 7 &&
+	     memcmp(stmt->columns[0].name, "COLUMN1", 7) == 0,
+	     "Statement metadata");
+	is  (tnt_stmt_prepare(tnt, query, strlen(query)), stmt,
+	     "Statement is cached");
+
+	struct tnt_stream *args = tnt_object(NULL);
+	tnt_object_format(args, "[%d]", 1);
+	isnt(tnt_execute_prepared(tnt, query, strlen(query), args), -1,
+	     "Execute prepared statement");
+	tnt_flush(tnt);
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	isnt(tnt->read_reply(tnt, &reply), -1, "Read reply from server");
+	ok  (reply.error == NULL && reply.data != NULL, "Check data presence");
+	tnt_reply_free(&reply);
+
+	/* statement can't be prepared, while requests are in flight */
+	query = "SELECT ?, ?";
+	tnt_ping(tnt);
+	tnt_execute_prepared(tnt, query, strlen(query), args);
+	tnt_flush(tnt);
+	int replies = 0;
+	struct tnt_iter it; tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it)) {
+		struct tnt_reply *r = TNT_IREPLY_PTR(&it);
+		if (r->error == NULL)
+			replies++;
+	}
+	tnt_iter_free(&it);
+	is  (replies, 2, "Fallback to SQL text");
+
+	tnt_stream_free(args);
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+struct tuples_state {
+	int count;
+	int valid;
+	int stop;
+};
+
+static int
+tuples_cb(const char *tuple, size_t size, void *arg) {
+	struct tuples_state *st = arg;
+	const char *p = tuple;
+	if (mp_check(&p, tuple + size) != 0 || p != tuple + size ||
+	    mp_typeof(*tuple) != MP_ARRAY)
+		st->valid = 0;
+	if (++st->count == st->stop)
+		return -1;
+	return 0;
+}
+
+static void
+tuples_async_cb(struct tnt_stream *s, struct tnt_reply *r,
+		enum tnt_error error, void *arg)
+{
+	(void )s;
+	int *called = arg;
+	*called = (error == TNT_EOK && r != NULL && r->data != NULL);
+}
+
+static int
+test_reply_tuples(char *uri) {
+	plan(10);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+	struct tnt_stream_net *sn = TNT_SNET_CAST(tnt);
+
+	/* 2000 tuples of 2KB */
+	struct tnt_stream *args = tnt_object(NULL);
+	tnt_object_format(args, "[%d%d]", 2000, 2048);
+	tnt_call(tnt, "test_tuples", strlen("test_tuples"), args);
+	tnt_flush(tnt);
+	struct tuples_state st = { 0, 1, 0 };
+	struct tnt_reply r; tnt_reply_init(&r);
+	is  (tnt_reply_tuples(tnt, &r, tuples_cb, &st), 0, "Read reply");
+	ok  (r.error == NULL && r.data == NULL && r.code == 0,
+	     "Reply without data");
+	ok  (st.count == 2000 && st.valid, "All tuples are passed");
+	ok  (sn->rbuf.size < 2000 * 2048, "Reply isn't buffered as a whole");
+	tnt_reply_free(&r);
+
+	/* stop after 10 tuples, the rest is skipped */
+	st.count = 0; st.stop = 10;
+	tnt_call(tnt, "test_tuples", strlen("test_tuples"), args);
+	tnt_call(tnt, "unknown_function", strlen("unknown_function"), args);
+	tnt_flush(tnt);
+	tnt_reply_tuples(tnt, &r, tuples_cb, &st);
+	tnt_reply_free(&r);
+	is  (st.count, 10, "Skip rest of tuples");
+	tnt_reply_tuples(tnt, &r, tuples_cb, &st);
+	ok  (r.error != NULL && st.count == 10, "Error reply");
+	tnt_reply_free(&r);
+
+	/* reply of async request is handed to its callback */
+	int called = 0;
+	tnt_object_reset(args);
+	tnt_object_format(args, "[%d%d]", 2, 3);
+	tnt_call(tnt, "test_3", 6, args);
+	tnt_async_register(tnt, tnt_async_last(tnt), tuples_async_cb, &called);
+	tnt_object_reset(args);
+	tnt_object_format(args, "[%d%d]", 3, 16);
+	tnt_call(tnt, "test_tuples", strlen("test_tuples"), args);
+	tnt_flush(tnt);
+	st.count = 0; st.stop = 0;
+	ok  (tnt_reply_tuples(tnt, &r, tuples_cb, &st) == 0 && called &&
+	     st.count == 3 && tnt_async_count(tnt) == 0 && tnt->wrcnt == 0,
+	     "Async callback is executed");
+	tnt_reply_free(&r);
+
+	tnt_stream_free(args);
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+/* scan index with cursor, check order and tuples 10000..10999 */
+static int
+cursor_scan(struct tnt_stream *tnt, uint32_t index, uint32_t page) {
+	struct tnt_cursor *c = tnt_cursor(NULL, tnt, 512, index);
+	if (c == NULL)
+		return -1;
+	tnt_cursor_page(c, page);
+	char seen[1000] = {0};
+	uint64_t prev = 0;
+	int count = 0, valid = 1, rc;
+	const char *tuple;
+	size_t size;
+	while ((rc = tnt_cursor_next(c, &tuple, &size)) == 1) {
+		if (mp_decode_array(&tuple) < 2) {
+			valid = 0;
+			continue;
+		}
+		uint64_t pk = mp_decode_uint(&tuple);
+		uint64_t order = (index == 0) ? pk : mp_decode_uint(&tuple);
+		if (order < prev)
+			valid = 0;
+		prev = order;
+		if (pk < 10000 || pk >= 11000)
+			continue;
+		if (seen[pk - 10000]++)
+			valid = 0;
+		count++;
+	}
+	tnt_cursor_free(c);
+	return (rc == 0 && valid) ? count : -1;
+}
+
+static int
+test_cursor(char *uri) {
+	plan(7);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	struct tnt_stream *tuple = tnt_object(NULL);
+	for (int i = 0; i < 1000; ++i) {
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d%d%s]", 10000 + i, i % 7, "cursor");
+		tnt_replace(tnt, 512, tuple);
+	}
+	tnt_flush(tnt);
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it));
+	tnt_iter_free(&it);
+
+	is  (tnt_cursor(NULL, tnt, 512, 7), NULL, "Unknown index");
+	is  (cursor_scan(tnt, 0, 64), 1000, "Scan primary index");
+	/* ~143 tuples per key, so duplicates span several pages */
+	is  (cursor_scan(tnt, 1, 50), 1000, "Scan non-unique index");
+
+	for (int i = 0; i < 1000; ++i) {
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d]", 10000 + i);
+		tnt_delete(tnt, 512, 0, tuple);
+	}
+	tnt_flush(tnt);
+	tnt_iter_reply(&it, tnt);
+	int deleted = 0;
+	while (tnt_next(&it))
+		deleted++;
+	tnt_iter_free(&it);
+	is  (deleted, 1000, "Cleanup");
+
+	tnt_stream_free(tuple);
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+struct scan_state {
+	int seen[1000];
+	int bad_range;
+	int stop;
+	int calls;
+};
+
+static int
+scan_cb(const char *tuple, size_t size, uint32_t range, void *arg) {
+	(void )size;
+	struct scan_state *st = arg;
+	mp_decode_array(&tuple);
+	uint64_t pk = mp_decode_uint(&tuple);
+	uint64_t sk = mp_decode_uint(&tuple);
+	if (pk >= 30000 && pk < 31000)
+		__sync_fetch_and_add(&st->seen[pk - 30000], 1);
+	/* ranges of secondary index are [.., 2), [2, 5), [5, ..) */
+	if (st->bad_range != -1 && range != (sk < 2 ? 0 : sk < 5 ? 1 : 2))
+		st->bad_range = 1;
+	if (st->stop && __sync_add_and_fetch(&st->calls, 1) >= st->stop)
+		return -1;
+	return 0;
+}
+
+static int
+scan_seen_once(struct scan_state *st) {
+	for (int i = 0; i < 1000; ++i)
+		if (st->seen[i] != 1)
+			return 0;
+	return 1;
+}
+
+static int
+test_scan(char *uri) {
+	plan(10);
+	header();
+
+	struct tnt_pool *pool = tnt_pool(NULL, 4);
+	isnt(pool, NULL, "Check pool creation");
+	isnt(tnt_pool_set(pool, TNT_OPT_URI, uri), -1, "Setting URI");
+	is  (tnt_pool_connect(pool), 4, "Connecting");
+	struct tnt_stream *tnt = tnt_pool_member(pool, 0);
+
+	struct tnt_stream *tuple = tnt_object(NULL);
+	for (int i = 0; i < 1000; ++i) {
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d%d%s]", 30000 + i, i % 7, "scan");
+		tnt_replace(tnt, 512, tuple);
+	}
+	tnt_flush(tnt);
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it));
+	tnt_iter_free(&it);
+
+	/* primary index, ranges are sampled */
+	struct scan_state *st = calloc(1, sizeof(struct scan_state));
+	st->bad_range = -1;
+	struct tnt_scan *sc = tnt_scan(NULL, 512, 0, 4);
+	tnt_scan_page(sc, 50);
+	is  (tnt_scan_split(sc, tnt), 0, "Split index by its bounds");
+	ok  (sc->ranges[0].from == NULL && sc->ranges[1].from != NULL &&
+	     sc->ranges[2].to != NULL && sc->ranges[3].to == NULL,
+	     "Inner bounds are set");
+	is  (tnt_scan_run(sc, pool->members, scan_cb, st), 0, "Scan ranges");
+	ok  (scan_seen_once(st), "Every tuple is passed once");
+	tnt_scan_free(sc);
+
+	/* non-unique index, ranges are given by partial keys */
+	memset(st, 0, sizeof(struct scan_state));
+	sc = tnt_scan(NULL, 512, 1, 3);
+	tnt_scan_page(sc, 40);
+	struct tnt_stream *k2 = tnt_object(NULL), *k5 = tnt_object(NULL);
+	tnt_object_format(k2, "[%d]", 2);
+	tnt_object_format(k5, "[%d]", 5);
+	tnt_scan_range(sc, 0, NULL, k2);
+	tnt_scan_range(sc, 1, k2, k5);
+	tnt_scan_range(sc, 2, k5, NULL);
+	tnt_stream_free(k2);
+	tnt_stream_free(k5);
+	int rc = tnt_scan_run(sc, pool->members, scan_cb, st);
+	ok  (rc == 0 && scan_seen_once(st) && !st->bad_range,
+	     "Scan user-defined ranges");
+
+	/* stop from callback */
+	memset(st, 0, sizeof(struct scan_state));
+	st->bad_range = -1;
+	st->stop = 10;
+	is  (tnt_scan_run(sc, pool->members, scan_cb, st), 1, "Stop scan");
+	tnt_scan_free(sc);
+	free(st);
+
+	for (int i = 0; i < 1000; ++i) {
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d]", 30000 + i);
+		tnt_delete(tnt, 512, 0, tuple);
+	}
+	tnt_flush(tnt);
+	tnt_iter_reply(&it, tnt);
+	int deleted = 0;
+	while (tnt_next(&it))
+		deleted++;
+	tnt_iter_free(&it);
+	is  (deleted, 1000, "Cleanup");
+
+	tnt_stream_free(tuple);
+	tnt_pool_free(pool);
+
+	footer();
+	return check_plan();
+}
+
+static ssize_t
+router_delete_build(struct tnt_stream *s, uint32_t n, void *arg) {
+	struct tnt_stream **keys = arg;
+	return tnt_delete(s, 512, 0, keys[n]);
+}
+
+static int
+test_router(char *uri) {
+	plan(11);
+	header();
+
+	struct tnt_router *r = tnt_router(NULL, 2, 64);
+	isnt(r, NULL, "Check router creation");
+	ok  (tnt_set(tnt_router_member(r, 0), TNT_OPT_URI, uri) != -1 &&
+	     tnt_set(tnt_router_member(r, 1), TNT_OPT_URI, uri) != -1,
+	     "Setting URI");
+	is  (tnt_router_connect(r), 0, "Connecting");
+
+	struct tnt_stream *keys[100];
+	struct tnt_stream *tuple = tnt_object(NULL);
+	int routed[2] = {0, 0};
+	for (int i = 0; i < 100; ++i) {
+		keys[i] = tnt_object(NULL);
+		tnt_object_format(keys[i], "[%d]", 40000 + i);
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d%d%s]", 40000 + i, 0, "router");
+		tnt_router_replace(r, 512, keys[i], tuple);
+		routed[r->last]++;
+	}
+	ok  (routed[0] > 0 && routed[1] > 0 &&
+	     tnt_router_member(r, 0)->wrcnt == (uint32_t )routed[0],
+	     "Keys are spread over shards");
+	tnt_router_flush(r);
+	int replies_ok = 0;
+	for (int n = 0; n < 2; ++n) {
+		struct tnt_stream *s = tnt_router_member(r, n);
+		for (int i = 0; i < routed[n]; ++i) {
+			struct tnt_reply reply; tnt_reply_init(&reply);
+			if (s->read_reply(s, &reply) == 0 && !reply.error)
+				replies_ok++;
+			tnt_reply_free(&reply);
+		}
+	}
+	is  (replies_ok, 100, "Replace over shards");
+
+	struct tnt_reply replies[100];
+	is  (tnt_router_select_batch(r, 512, 0, keys, 100, replies), 0,
+	     "Batch select");
+	int found = 0;
+	for (int i = 0; i < 100; ++i) {
+		const char *data = replies[i].data;
+		if (data && mp_decode_array(&data) == 1 &&
+		    mp_decode_array(&data) == 3 &&
+		    mp_decode_uint(&data) == (uint64_t )(40000 + i))
+			found++;
+		tnt_reply_free(&replies[i]);
+	}
+	is  (found, 100, "Replies are in order of keys");
+
+	/* shard, that doesn't reply, mustn't leave replies on others */
+	int sp[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sp);
+	struct timeval tv = {0, 100000};
+	setsockopt(sp[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	dup2(sp[0], tnt_fd(tnt_router_member(r, 0)));
+	close(sp[0]);
+	is  (tnt_router_select_batch(r, 512, 0, keys, 100, replies), -1,
+	     "Shard doesn't reply");
+	close(sp[1]);
+	int filled = 0;
+	for (int i = 0; i < 100; ++i)
+		filled += (replies[i].buf != NULL);
+	ok  (filled == 0 && tnt_router_member(r, 0)->wrcnt == 0 &&
+	     tnt_router_member(r, 1)->wrcnt == 0 &&
+	     TNT_SNET_CAST(tnt_router_member(r, 1))->connected,
+	     "Requests in flight are drained and replies are freed");
+
+	for (uint32_t b = 0; b < r->bucket_count; ++b)
+		tnt_router_map(r, b, 1);
+	tnt_router_get(r, keys[0]);
+	ok  (r->last == 1 && tnt_router_map(r, 0, 2) == -1, "Bucket table");
+
+	tnt_router_batch(r, keys, 100, router_delete_build, keys, replies);
+	int deleted = 0;
+	for (int i = 0; i < 100; ++i) {
+		if (replies[i].error == NULL)
+			deleted++;
+		tnt_reply_free(&replies[i]);
+		tnt_stream_free(keys[i]);
+	}
+	is  (deleted, 100, "Batch delete");
+
+	tnt_stream_free(tuple);
+	tnt_router_free(r);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_merge(char *uri) {
+	plan(12);
+	header();
+
+	/* every member sees the same data, so every tuple comes thrice */
+	struct tnt_pool *pool = tnt_pool(NULL, 3);
+	isnt(pool, NULL, "Check pool creation");
+	isnt(tnt_pool_set(pool, TNT_OPT_URI, uri), -1, "Setting URI");
+	is  (tnt_pool_connect(pool), 3, "Connecting");
+	struct tnt_stream *tnt = tnt_pool_member(pool, 0);
+
+	struct tnt_stream *tuple = tnt_object(NULL);
+	for (int i = 0; i < 100; ++i) {
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d%d%s]", 50000 + i, i % 7, "merge");
+		tnt_replace(tnt, 512, tuple);
+	}
+	tnt_flush(tnt);
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it));
+	tnt_iter_free(&it);
+
+	/* small pages, so that streams are read by several requests */
+	struct tnt_merge *m = tnt_merge(NULL, pool->members, 3);
+	tnt_merge_page(m, 4);
+	struct tnt_stream *key = tnt_object(NULL);
+	tnt_object_format(key, "[%d]", 50000);
+	is  (tnt_merge_select(m, 512, 0, 30, 15, TNT_ITER_GE, key), 0,
+	     "Scatter select");
+	const char *page = m->replies[0].data;
+	ok  (page != NULL && mp_decode_array(&page) <= 4,
+	     "Only a page of stream is read");
+	const char *data;
+	size_t size;
+	int count = 0, ordered = 1;
+	while (tnt_merge_next(m, &data, &size) == 1) {
+		mp_decode_array(&data);
+		if (mp_decode_uint(&data) != (uint64_t )(50005 + count / 3))
+			ordered = 0;
+		count++;
+	}
+	ok  (count == 30 && ordered, "Merge with global offset and limit");
+
+	tnt_object_reset(key);
+	tnt_object_format(key, "[%d]", 50099);
+	tnt_merge_select(m, 512, 0, 6, 0, TNT_ITER_LE, key);
+	count = 0; ordered = 1;
+	while (tnt_merge_next(m, &data, &size) == 1) {
+		mp_decode_array(&data);
+		if (mp_decode_uint(&data) != (uint64_t )(50099 - count / 3))
+			ordered = 0;
+		count++;
+	}
+	ok  (count == 6 && ordered, "Merge in descending order");
+
+	tnt_object_reset(key);
+	tnt_object_add_array(key, 0);
+	tnt_merge_select(m, 512, 1, UINT32_MAX, 0, TNT_ITER_ALL, key);
+	count = 0; ordered = 1;
+	uint64_t prev = 0;
+	while (tnt_merge_next(m, &data, &size) == 1) {
+		mp_decode_array(&data);
+		mp_next(&data);
+		uint64_t sk = mp_decode_uint(&data);
+		if (sk < prev)
+			ordered = 0;
+		prev = sk;
+		count++;
+	}
+	ok  (count >= 300 && count % 3 == 0 && ordered,
+	     "Merge by non-unique index");
+
+	/* pages past the first one end at EQ key */
+	tnt_object_reset(key);
+	tnt_object_format(key, "[%d]", 3);
+	tnt_merge_select(m, 512, 1, UINT32_MAX, 0, TNT_ITER_EQ, key);
+	count = 0; ordered = 1;
+	while (tnt_merge_next(m, &data, &size) == 1) {
+		mp_decode_array(&data);
+		mp_next(&data);
+		if (mp_decode_uint(&data) != 3)
+			ordered = 0;
+		count++;
+	}
+	ok  (count >= 42 && count % 3 == 0 && ordered, "Merge by EQ key");
+
+	/* member, that doesn't reply, mustn't leave replies on others */
+	int sp[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sp);
+	struct timeval tv = {0, 100000};
+	setsockopt(sp[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	dup2(sp[0], tnt_fd(pool->members[1]));
+	close(sp[0]);
+	is  (tnt_merge_select(m, 512, 0, 6, 0, TNT_ITER_LE, key), -1,
+	     "Member doesn't reply");
+	close(sp[1]);
+	ok  (pool->members[0]->wrcnt == 0 && pool->members[1]->wrcnt == 0 &&
+	     pool->members[2]->wrcnt == 0 &&
+	     TNT_SNET_CAST(pool->members[2])->connected,
+	     "Requests in flight are drained");
+	tnt_merge_free(m);
+	tnt_stream_free(key);
+
+	for (int i = 0; i < 100; ++i) {
+		tnt_object_reset(tuple);
+		tnt_object_format(tuple, "[%d]", 50000 + i);
+		tnt_delete(tnt, 512, 0, tuple);
+	}
+	tnt_flush(tnt);
+	tnt_iter_reply(&it, tnt);
+	int deleted = 0;
+	while (tnt_next(&it))
+		deleted++;
+	tnt_iter_free(&it);
+	is  (deleted, 100, "Cleanup");
+
+	tnt_stream_free(tuple);
+	tnt_pool_free(pool);
+
+	footer();
+	return check_plan();
+}
+
+static ssize_t
+replicaset_build(struct tnt_stream *s, void *arg) {
+	struct tnt_stream *slow = arg;
+	struct tnt_stream *args = tnt_object(NULL);
+	ssize_t rc;
+	if (s == slow) {
+		tnt_object_add_array(args, 0);
+		rc = tnt_call(s, "test_stall", 10, args);
+	} else {
+		tnt_object_format(args, "[%d%d]", 2, 3);
+		rc = tnt_call(s, "test_3", 6, args);
+	}
+	tnt_stream_free(args);
+	return rc;
+}
+
+static int
+replicaset_reply_is_5(struct tnt_reply *reply) {
+	const char *data = reply->data;
+	return data && !reply->error && mp_decode_array(&data) == 1 &&
+	       mp_typeof(*data) == MP_UINT && mp_decode_uint(&data) == 5;
+}
+
+static int
+test_replicaset(char *uri) {
+	plan(9);
+	header();
+
+	struct tnt_replicaset *rs = tnt_replicaset(NULL, 2);
+	isnt(rs, NULL, "Check replica set creation");
+	ok  (tnt_set(tnt_replicaset_member(rs, 0), TNT_OPT_URI, uri) != -1 &&
+	     tnt_set(tnt_replicaset_member(rs, 1), TNT_OPT_URI, uri) != -1,
+	     "Setting URI");
+	is  (tnt_replicaset_connect(rs), 2, "Connecting");
+	ok  (tnt_replicaset_hedge(rs, 1.5, 0) == -1 &&
+	     tnt_replicaset_hedge(rs, 0.9, 1000) == 0, "Hedge delay");
+
+	/* the first replica stalls till release, read is hedged to the second */
+	struct tnt_stream *slow = tnt_replicaset_member(rs, 0);
+	struct tnt_reply reply;
+	ok  (tnt_replicaset_read(rs, replicaset_build, slow, &reply) == 0 &&
+	     replicaset_reply_is_5(&reply) && rs->hedges == 1,
+	     "Hedged read");
+	tnt_reply_free(&reply);
+	ok  (rs->replicas[0].stale == 1 && rs->replicas[1].wins == 1 &&
+	     tnt_replicaset_latency(rs, 1, 0.5) > 0 &&
+	     tnt_replicaset_latency(rs, 0, 0.5) >
+	     tnt_replicaset_latency(rs, 1, 0.5), "Replica latencies");
+
+	/* sorted window follows the ring, when old samples leave it */
+	struct tnt_latency lat;
+	memset(&lat, 0, sizeof(lat));
+	for (uint32_t i = 0; i < 200; ++i)
+		tnt_latency_add(&lat, (i * 37) % 200 + 1);
+	uint64_t sum = 0, sorted_sum = 0;
+	uint32_t max = 0, in_order = 1;
+	for (uint32_t i = 0; i < TNT_LATENCY_WINDOW; ++i) {
+		sum += lat.samples[i];
+		sorted_sum += lat.sorted[i];
+		if (lat.samples[i] > max)
+			max = lat.samples[i];
+		if (i > 0 && lat.sorted[i - 1] > lat.sorted[i])
+			in_order = 0;
+	}
+	ok  (lat.count == TNT_LATENCY_WINDOW && in_order && sum == sorted_sum &&
+	     tnt_latency_percentile(&lat, 1) == max &&
+	     tnt_latency_percentile(&lat, 0) == lat.sorted[0],
+	     "Sorted latency window");
+
+	/* late reply of the first replica is dropped by its sync */
+	struct tnt_stream *fast = tnt_replicaset_member(rs, 1);
+	struct tnt_stream *args = tnt_object(NULL);
+	tnt_object_add_array(args, 0);
+	tnt_call(fast, "test_release", 12, args);
+	tnt_stream_free(args);
+	tnt_flush(fast);
+	tnt_reply_init(&reply);
+	fast->read_reply(fast, &reply);
+	tnt_reply_free(&reply);
+	struct pollfd pfd = { tnt_fd(slow), POLLIN, 0 };
+	poll(&pfd, 1, 10000);
+	rs->replicas[1].failed = 1;
+	ok  (tnt_replicaset_read(rs, replicaset_build, NULL, &reply) == 0 &&
+	     replicaset_reply_is_5(&reply) && rs->replicas[0].stale == 0 &&
+	     rs->replicas[0].wins == 1, "Late reply is dropped");
+	tnt_reply_free(&reply);
+
+	rs->replicas[0].failed = 1;
+	is  (tnt_replicaset_read(rs, replicaset_build, NULL, &reply), -1,
+	     "No live replicas");
+
+	tnt_replicaset_free(rs);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_rtt(char *uri) {
+	plan(5);
+	header();
+
+	struct tnt_pool *pool = tnt_pool(NULL, 2);
+	isnt(pool, NULL, "Check pool creation");
+	isnt(tnt_pool_set(pool, TNT_OPT_URI, uri), -1, "Setting URI");
+	is  (tnt_pool_connect(pool), 2, "Connecting");
+	struct tnt_stream *s0 = tnt_pool_member(pool, 0);
+	struct tnt_stream *s1 = tnt_pool_member(pool, 1);
+
+	tnt_ping(s0);
+	tnt_flush(s0);
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	s0->read_reply(s0, &reply);
+	tnt_reply_free(&reply);
+	ok  (tnt_rtt(s0) > 0 && TNT_SNET_CAST(s0)->rtt.last > 0 &&
+	     TNT_SNET_CAST(s0)->rtt.sent[reply.sync % TNT_RTT_SLOTS] == 0,
+	     "RTT is measured");
+
+	/* with equal RTT, member with requests in flight loses */
+	TNT_SNET_CAST(s0)->rtt.srtt = TNT_SNET_CAST(s1)->rtt.srtt = 100 << 3;
+	for (int i = 0; i < 10; ++i)
+		tnt_ping(s0);
+	int picked = 0;
+	for (int i = 0; i < 20; ++i)
+		if (tnt_pool_pick(pool) == s1)
+			picked++;
+	is  (picked, 20, "Pick member with the lowest expected time");
+	tnt_flush(s0);
+	for (int i = 0; i < 10; ++i) {
+		tnt_reply_init(&reply);
+		s0->read_reply(s0, &reply);
+		tnt_reply_free(&reply);
+	}
+
+	tnt_pool_free(pool);
+
+	footer();
+	return check_plan();
+}
+
+struct deadline_result {
+	int calls; /* count of callback executions */
+	enum tnt_error error; /* error of the last execution */
+};
+
+static void
+test_deadline_cb(struct tnt_stream *s, struct tnt_reply *r,
+		 enum tnt_error error, void *arg)
+{
+	(void )s; (void )r;
+	struct deadline_result *res = arg;
+	res->calls++;
+	res->error = error;
+}
+
+static int
+test_deadline(char *uri) {
+	plan(9);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_set(tnt, TNT_OPT_NONBLOCK, 1), -1, "Setting non-blocking mode");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	struct deadline_result slow, fast;
+	memset(&slow, 0, sizeof(slow));
+	memset(&fast, 0, sizeof(fast));
+	struct tnt_stream *arg = tnt_object(NULL);
+	tnt_object_format(arg, "[%lf]", 0.4);
+	tnt_call(tnt, "test_sleep", 10, arg);
+	tnt_stream_free(arg);
+	tnt_async_register(tnt, tnt_async_last(tnt), test_deadline_cb, &slow);
+	tnt_async_deadline(tnt, tnt_async_last(tnt), 100);
+	tnt_ping(tnt);
+	tnt_async_register(tnt, tnt_async_last(tnt), test_deadline_cb, &fast);
+	tnt_async_deadline(tnt, tnt_async_last(tnt), 1000);
+	int timeout = tnt_async_timeout(tnt);
+	ok  (timeout >= 0 && timeout <= 100, "Time till the nearest deadline");
+
+	struct pollfd pfd = { tnt_fd(tnt), 0, 0 };
+	while (tnt_async_count(tnt) > 0) {
+		int wants = tnt_wants(tnt);
+		pfd.events = ((wants & TNT_WANT_READ)  ? POLLIN  : 0) |
+			     ((wants & TNT_WANT_WRITE) ? POLLOUT : 0);
+		poll(&pfd, 1, tnt_async_timeout(tnt));
+		if (tnt_process_io(tnt) == -1)
+			break;
+	}
+	ok  (fast.calls == 1 && fast.error == TNT_EOK, "Request in time");
+	ok  (slow.calls == 1 && slow.error == TNT_ETMOUT &&
+	     tnt->wrcnt == 1 && TNT_SNET_CAST(tnt)->connected,
+	     "Expired request is failed, connection is kept");
+
+	/* late reply is dropped by its sync */
+	pfd.events = POLLIN;
+	while (tnt->wrcnt > 0) {
+		poll(&pfd, 1, 1000);
+		if (tnt_process_io(tnt) == -1)
+			break;
+	}
+	is  (slow.calls, 1, "Late reply is dropped");
+
+	memset(&fast, 0, sizeof(fast));
+	tnt_ping(tnt);
+	tnt_async_register(tnt, tnt_async_last(tnt), test_deadline_cb, &fast);
+	tnt_async_deadline(tnt, tnt_async_last(tnt), 1000);
+	while (tnt_async_count(tnt) > 0) {
+		pfd.events = POLLIN | POLLOUT;
+		poll(&pfd, 1, tnt_async_timeout(tnt));
+		if (tnt_process_io(tnt) == -1)
+			break;
+	}
+	ok  (fast.calls == 1 && fast.error == TNT_EOK &&
+	     tnt_async_timeout(tnt) == -1, "Connection is usable after timeout");
+
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+/* replace socket of stream with one, whose peer is closed */
+static void
+reconnect_break(struct tnt_stream *tnt) {
+	int sp[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sp);
+	close(sp[1]);
+	dup2(sp[0], tnt_fd(tnt));
+	close(sp[0]);
+}
+
+static int
+test_reconnect(char *uri) {
+	plan(13);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	ok  (tnt_set(tnt, TNT_OPT_URI, uri) != -1 &&
+	     tnt_set(tnt, TNT_OPT_RECONNECT, 5) != -1 &&
+	     tnt_set(tnt, TNT_OPT_RECONNECT_DELAY, 10) != -1,
+	     "Setting reconnect policy");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+
+	struct tnt_stream *key = tnt_object(NULL);
+	tnt_object_add_array(key, 0);
+	tnt_select(tnt, 512, 0, 1, 0, TNT_ITER_ALL, key);
+	uint64_t select_sync = tnt_async_last(tnt);
+	struct tnt_stream *args = tnt_object(NULL);
+	tnt_object_format(args, "[%d%d]", 1, 2);
+	struct tnt_mem_stat before[TNT_MEM_TAG_MAX], after[TNT_MEM_TAG_MAX];
+	tnt_stream_mem(tnt, before);
+	tnt_call(tnt, "test_3", 6, args);
+	uint64_t lost_sync = tnt_async_last(tnt);
+	tnt_stream_mem(tnt, after);
+	is  (after[TNT_MEM_REQUEST].live, before[TNT_MEM_REQUEST].live,
+	     "Not idempotent request isn't copied");
+	struct deadline_result lost;
+	memset(&lost, 0, sizeof(lost));
+	tnt_call(tnt, "test_3", 6, args);
+	tnt_async_register(tnt, tnt_async_last(tnt), test_deadline_cb, &lost);
+	tnt_call(tnt, "test_3", 6, args);
+	uint64_t marked_sync = tnt_async_last(tnt);
+	is  (tnt_idempotent(tnt, marked_sync), 0, "Mark call idempotent");
+	tnt_ping(tnt);
+	uint64_t ping_sync = tnt_async_last(tnt);
+	tnt_flush(tnt);
+	is  (tnt_idempotent(tnt, lost_sync), -1,
+	     "Sent request can't be marked idempotent");
+	reconnect_break(tnt);
+
+	/* lost requests are reported first, then replies of replayed ones */
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	int rc = tnt->read_reply(tnt, &reply);
+	ok  (rc == -1 && tnt_error(tnt) == TNT_ELOST &&
+	     reply.sync == lost_sync, "Not idempotent request is lost");
+	int replayed = 0;
+	for (int i = 0; i < 3; ++i) {
+		tnt_reply_init(&reply);
+		if (tnt->read_reply(tnt, &reply) == 0 && reply.error == NULL &&
+		    (reply.sync == select_sync || reply.sync == marked_sync ||
+		     reply.sync == ping_sync))
+			replayed++;
+		tnt_reply_free(&reply);
+	}
+	ok  (replayed == 3 && tnt->wrcnt == 0, "Idempotent requests are replayed");
+	ok  (lost.calls == 1 && lost.error == TNT_ELOST &&
+	     tnt_async_count(tnt) == 0, "Lost request callback");
+
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	tnt_reply_init(&reply);
+	ok  (tnt->read_reply(tnt, &reply) == 0 && reply.error == NULL,
+	     "Connection is usable");
+	tnt_reply_free(&reply);
+
+	/* statement ids are session-local, they're prepared again */
+	const char *query = "SELECT ?";
+	tnt_stmt_prepare(tnt, query, strlen(query));
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	reconnect_break(tnt);
+	tnt_reply_init(&reply);
+	tnt->read_reply(tnt, &reply);
+	tnt_reply_free(&reply);
+	tnt_object_reset(args);
+	tnt_object_format(args, "[%d]", 1);
+	tnt_execute_prepared(tnt, query, strlen(query), args);
+	tnt_flush(tnt);
+	tnt_reply_init(&reply);
+	ok  (tnt->read_reply(tnt, &reply) == 0 && reply.error == NULL,
+	     "Execute prepared statement after reconnect");
+	tnt_reply_free(&reply);
+
+	/* tuple reader reports lost requests too */
+	tnt_object_reset(args);
+	tnt_object_format(args, "[%d%d]", 1, 2);
+	tnt_call(tnt, "test_3", 6, args);
+	lost_sync = tnt_async_last(tnt);
+	tnt_flush(tnt);
+	reconnect_break(tnt);
+	tnt_reconnect(tnt);
+	struct tuples_state st = { 0, 1, 0 };
+	tnt_reply_init(&reply);
+	rc = tnt_reply_tuples(tnt, &reply, tuples_cb, &st);
+	ok  (rc == -1 && tnt_error(tnt) == TNT_ELOST &&
+	     reply.sync == lost_sync &&
+	     tnt_reply_tuples(tnt, &reply, tuples_cb, &st) == 1,
+	     "Lost request is reported by tuple reader");
+	tnt_stream_free(tnt);
+
+	/* non-blocking stream doesn't sleep in backoff inside read_reply */
+	tnt = tnt_net(NULL);
+	tnt_set(tnt, TNT_OPT_URI, uri);
+	tnt_set(tnt, TNT_OPT_RECONNECT, 5);
+	tnt_set(tnt, TNT_OPT_NONBLOCK, 1);
+	tnt_connect(tnt);
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	reconnect_break(tnt);
+	tnt_reply_init(&reply);
+	rc = tnt->read_reply(tnt, &reply);
+	ok  (rc == -1 && tnt_error(tnt) == TNT_ESYSTEM &&
+	     tnt_reconnect(tnt) == 0, "Non-blocking stream is reconnected by "
+	     "application");
+
+	tnt_stream_free(args);
+	tnt_stream_free(key);
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_mem(char *uri) {
+	plan(8);
+	header();
+
+	struct tnt_mem_slab *slab = tnt_mem_slab(NULL);
+	isnt(slab, NULL, "Check slab creation");
+	char *a = tnt_mem_ctx_alloc(&slab->base, 100);
+	tnt_mem_ctx_free(a);
+	char *b = tnt_mem_ctx_alloc(&slab->base, 120);
+	is  (a, b, "Freed block of the same class is reused");
+	b = tnt_mem_ctx_realloc(&slab->base, b, 900);
+	ok  (b != NULL && slab->used == 1024, "Realloc moves to bigger class");
+	tnt_mem_ctx_free(b);
+
+	struct tnt_stream *tnt = tnt_net(NULL);
+	tnt_set(tnt, TNT_OPT_URI, uri);
+	tnt_set(tnt, TNT_OPT_MEM, &slab->base);
+	isnt(tnt_connect(tnt), -1, "Connecting with allocator context");
+	size_t used = slab->used;
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	tnt->read_reply(tnt, &reply);
+	ok  (reply.code == 0 && slab->used > used,
+	     "Reply buffer is taken from allocator context");
+	tnt_reply_free(&reply);
+	is  (slab->used, used, "Reply buffer is given back");
+	tnt_stream_free(tnt);
+	is  (slab->used, 0, "Every block is freed with stream");
+	tnt_mem_slab_free(slab);
+
+	struct tnt_mem_arena *arena = tnt_mem_arena(NULL, 1024);
+	for (int i = 0; i < 100; ++i)
+		memset(tnt_mem_ctx_alloc(&arena->base, 40), 0, 40);
+	used = arena->used;
+	a = tnt_mem_ctx_alloc(&arena->base, 4096);
+	tnt_mem_ctx_free(a);
+	int ok_last = (arena->used == used);
+	tnt_mem_arena_reset(arena);
+	ok  (ok_last && arena->used == 0 &&
+	     tnt_mem_ctx_alloc(&arena->base, 4096) == a,
+	     "Arena frees the last block and resets");
+	tnt_mem_arena_free(arena);
+
+	footer();
+	return check_plan();
+}
+
+static void *
+reply_pool_free(void *arg) {
+	struct tnt_reply *replies = arg;
+	for (int i = 0; i < 4; ++i)
+		tnt_reply_free(&replies[i]);
+	return NULL;
+}
+
+static int
+test_reply_pool(char *uri) {
+	plan(6);
+	header();
+
+	struct tnt_stream *tnt = tnt_net(NULL);
+	tnt_set(tnt, TNT_OPT_URI, uri);
+	tnt_set(tnt, TNT_OPT_REPLY_POOL, 64 * 1024);
+	isnt(tnt_connect(tnt), -1, "Connecting with reply pool");
+
+	for (int i = 0; i < 5; ++i)
+		tnt_ping(tnt);
+	tnt_flush(tnt);
+	struct tnt_iter it;
+	tnt_iter_reply(&it, tnt);
+	const char *buf = NULL;
+	int count = 0, reused = 0;
+	while (tnt_next(&it)) {
+		struct tnt_reply *r = TNT_IREPLY_PTR(&it);
+		if (buf != NULL && r->buf == buf)
+			reused++;
+		buf = r->buf;
+		count++;
+	}
+	tnt_iter_free(&it);
+	is  (count, 5, "All replies are read");
+	is  (reused, 4, "Reply buffer is reused by iterator");
+
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	uint64_t sync = tnt->reqid - 1;
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	tnt->read_reply(tnt, &reply);
+	is  (reply.buf, buf, "Reply buffer is reused by read_reply");
+
+	struct tnt_reply replies[4];
+	for (int i = 0; i < 4; ++i)
+		tnt_ping(tnt);
+	tnt_flush(tnt);
+	for (int i = 0; i < 4; ++i) {
+		tnt_reply_init(&replies[i]);
+		tnt->read_reply(tnt, &replies[i]);
+	}
+	const char *freed = replies[3].buf;
+	pthread_t thread;
+	pthread_create(&thread, NULL, reply_pool_free, replies);
+	pthread_join(thread, NULL);
+	struct tnt_reply next;
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	tnt_reply_init(&next);
+	tnt->read_reply(tnt, &next);
+	is  (next.buf, freed, "Replies are given back on other thread");
+	tnt_reply_free(&next);
+	tnt_stream_free(tnt);
+	ok  (reply.code == 0 && reply.sync == sync, "Reply outlives stream");
+	tnt_reply_free(&reply);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_mem_usage(char *uri) {
+	plan(7);
+	header();
+
+	struct tnt_mem_stat g0[TNT_MEM_TAG_MAX], g1[TNT_MEM_TAG_MAX];
+	tnt_mem_usage(g0);
+	struct tnt_stream *obj = tnt_object(NULL);
+	tnt_object_add_array(obj, 2);
+	tnt_object_add_int(obj, 1);
+	tnt_object_add_str(obj, "abc", 3);
+	tnt_mem_usage(g1);
+	ok  (g1[TNT_MEM_OBJECT].live > g0[TNT_MEM_OBJECT].live &&
+	     g1[TNT_MEM_OBJECT].allocs > g0[TNT_MEM_OBJECT].allocs,
+	     "Object stream is accounted");
+	tnt_stream_free(obj);
+	tnt_mem_usage(g1);
+	is  (g1[TNT_MEM_OBJECT].live, g0[TNT_MEM_OBJECT].live,
+	     "Object stream memory is given back");
+
+	struct tnt_stream *tnt = tnt_net(NULL);
+	tnt_set(tnt, TNT_OPT_URI, uri);
+	tnt_connect(tnt);
+	struct tnt_mem_stat st[TNT_MEM_TAG_MAX];
+	tnt_stream_mem(tnt, st);
+	ok  (st[TNT_MEM_IOB].live >= 2 * 16384 && st[TNT_MEM_SCHEMA].count > 0 &&
+	     st[TNT_MEM_REPLY].live == 0 && st[TNT_MEM_REPLY].peak > 0,
+	     "Buffers, schema and replies of stream are accounted");
+
+	tnt_ping(tnt);
+	tnt_flush(tnt);
+	struct tnt_reply reply;
+	tnt_reply_init(&reply);
+	tnt->read_reply(tnt, &reply);
+	tnt_stream_mem(tnt, st);
+	is  (st[TNT_MEM_REPLY].count, 1, "Reply in use is accounted");
+	tnt_mem_usage(g0);
+	tnt_stream_free(tnt);
+	tnt_mem_usage(g1);
+	ok  (g1[TNT_MEM_REPLY].live == g0[TNT_MEM_REPLY].live &&
+	     g1[TNT_MEM_IOB].live < g0[TNT_MEM_IOB].live,
+	     "Reply outlives stream");
+	tnt_reply_free(&reply);
+	tnt_mem_usage(g0);
+	ok  (g0[TNT_MEM_REPLY].live < g1[TNT_MEM_REPLY].live &&
+	     g0[TNT_MEM_REPLY].peak >= g1[TNT_MEM_REPLY].live,
+	     "Reply memory is given back");
+
+	tnt = tnt_net(NULL);
+	tnt_set(tnt, TNT_OPT_URI, uri);
+	tnt_set(tnt, TNT_OPT_ZEROCOPY, 1);
+	tnt_set(tnt, TNT_OPT_SEND_ZEROCOPY, 1024);
+	tnt_set(tnt, TNT_OPT_RECONNECT, 1);
+	tnt_connect(tnt);
+	tnt_ping(tnt);
+	tnt_stream_mem(tnt, st);
+	ok  (st[TNT_MEM_IOB].count == 4 && st[TNT_MEM_REQUEST].count == 3,
+	     "Shared chunk, send queue and journal are accounted");
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_schema_cache(char *uri) {
+	plan(7);
+	header();
+
+	struct tnt_schema_cache *cache = tnt_schema_cache_new();
+	isnt(cache, NULL, "Create schema cache");
+	is  (tnt_schema_cache_get(cache), NULL, "Cache is empty");
+
+	struct tnt_stream *s1 = tnt_net(NULL);
+	tnt_set(s1, TNT_OPT_URI, uri);
+	tnt_set(s1, TNT_OPT_SCHEMA_CACHE, cache);
+	tnt_connect(s1);
+	struct tnt_schema *sch = tnt_schema_cache_get(cache);
+	ok  (sch != NULL && sch == TNT_SNET_CAST(s1)->schema &&
+	     sch->version != 0, "Loaded schema is published");
+
+	struct tnt_mem_stat st0[TNT_MEM_TAG_MAX], st1[TNT_MEM_TAG_MAX];
+	tnt_mem_usage(st0);
+	struct tnt_stream *s2 = tnt_net(NULL);
+	tnt_set(s2, TNT_OPT_URI, uri);
+	tnt_set(s2, TNT_OPT_SCHEMA_CACHE, cache);
+	tnt_connect(s2);
+	tnt_mem_usage(st1);
+	ok  (TNT_SNET_CAST(s2)->schema == sch &&
+	     st1[TNT_MEM_SCHEMA].allocs == st0[TNT_MEM_SCHEMA].allocs,
+	     "Schema of the same version isn't loaded again");
+	is  (tnt_get_spaceno(s2, "test", 4), 512, "Lookup in shared schema");
+
+	tnt_reload_schema(s2);
+	isnt(TNT_SNET_CAST(s2)->schema, sch, "Reload creates new version");
+	ok  (tnt_get_spaceno(s1, "test", 4) == 512 &&
+	     TNT_SNET_CAST(s1)->schema == TNT_SNET_CAST(s2)->schema,
+	     "New version is taken by other connection");
+
+	tnt_schema_unref(sch);
+	tnt_stream_free(s1);
+	tnt_stream_free(s2);
+	tnt_schema_cache_free(cache);
+
+	footer();
+	return check_plan();
+}
+
+static int
+test_large_reply(char *uri) {
+	plan(6);
+	header();
+
+	struct tnt_stream *tnt = NULL; tnt = tnt_net(NULL);
+	isnt(tnt, NULL, "Check connection creation");
+	isnt(tnt_set(tnt, TNT_OPT_URI, uri), -1, "Setting URI");
+	isnt(tnt_connect(tnt), -1, "Connecting");
+	struct tnt_stream_net *sn = TNT_SNET_CAST(tnt);
+	size_t initial = sn->rbuf.size;
+
+	/* reply is 16 times larger, than recv buffer */
+	struct tnt_stream *args = tnt_object(NULL);
+	tnt_object_format(args, "[%d%d]", 1, 16 * 16384);
+	tnt_call(tnt, "test_tuples", strlen("test_tuples"), args);
+	tnt_flush(tnt);
+	struct tnt_reply r; tnt_reply_init(&r);
+	int valid = (tnt->read_reply(tnt, &r) == 0 && r.error == NULL);
+	const char *data = r.data;
+	uint32_t len = 0;
+	if (valid && mp_decode_array(&data) == 1 &&
+	    mp_decode_array(&data) == 2 && mp_decode_uint(&data) == 1) {
+		const char *str = mp_decode_str(&data, &len);
+		for (uint32_t i = 0; i < len; ++i)
+			valid = valid && str[i] == 'x';
+	}
+	ok  (valid && len == 16 * 16384, "Large reply is parsed");
+	tnt_reply_free(&r);
+	is  (sn->rbuf.size, initial, "Recv buffer is shrunk back");
+
+	/* replies, that are received at once, are all returned */
+	uint64_t sync = tnt->reqid;
+	for (int i = 0; i < 3; ++i) {
+		tnt_object_reset(args);
+		tnt_object_format(args, "[%d%d]", i, 2);
+		tnt_call(tnt, "test_3", 6, args);
+	}
+	tnt_flush(tnt);
+	struct pollfd pfd = { tnt_fd(tnt), POLLIN, 0 };
+	poll(&pfd, 1, 1000);
+	valid = 1;
+	for (int i = 0; i < 3; ++i) {
+		tnt_reply_init(&r);
+		data = NULL;
+		if (tnt->read_reply(tnt, &r) == 0 && r.sync == sync + i)
+			data = r.data;
+		valid = valid && data && mp_decode_array(&data) == 1 &&
+			mp_decode_uint(&data) == (uint64_t)i + 2;
+		tnt_reply_free(&r);
+	}
+	ok  (valid && tnt->wrcnt == 0, "Pipelined replies");
+
+	tnt_stream_free(args);
+	tnt_stream_free(tnt);
+
+	footer();
+	return check_plan();
+}
+
+static int test_pushes(const char *uri) {
+	struct tnt_stream *tnt = NULL;
+	tnt = tnt_net(NULL);
+	assert(tnt != NULL);
+	int rv = tnt_set(tnt, TNT_OPT_URI, uri);
+	assert(rv != -1);
+	rv = tnt_connect(tnt);
+	assert(rv != -1);
+
+	struct tnt_request *subscribe = tnt_request_call(NULL);
+	tnt_request_set_funcz(subscribe, "test_5");
+	uint64_t sync = tnt_request_compile(tnt, subscribe);
+	(void )sync;
+
+	tnt_flush(tnt);
+
+	bool supports_push = true, ended = false;
+	int count = 0;
+	struct tnt_iter it; tnt_iter_reply(&it, tnt);
+	while (tnt_next(&it)) {
+		assert(ended == false);
+		struct tnt_reply *r = TNT_IREPLY_PTR(&it);
+		if ((r->code & TNT_CHUNK) != 0) {
+			count += 1;
+		} else {
+			const char *pos = r->data;
+			assert(mp_typeof(*pos) == MP_ARRAY);
+			int len = mp_decode_array(&pos);
+			assert(len == 1);
+			assert(mp_typeof(*pos) == MP_BOOL);
+			supports_push = mp_decode_bool(&pos);
+			ended = true;
+		}
+	}
+	tnt_close(tnt);
+
+	plan(2);
+	header();
+
+	if (supports_push) {
+		is(count, 10,   "Got 10 results");
+		is(ended, true, "Received response from server");
+	} else {
+		skip("server don't support pushes");
+		skip("server don't support pushes");
+	}
+
+
+	footer();
+	return check_plan();
+}
+
+int main() {
+	plan(35);
 
 	char uri[128] = {0};
 	snprintf(uri, 128, "test:test@%s", getenv("LISTEN"));
 
 	test_connect_tcp(uri);
 	test_object();
+	test_object_deferred();
+	test_format_compile();
 	test_request_01(uri);
 	test_request_02(uri);
 	test_request_03(uri);
@@ -850,6 +2737,29 @@ int main() {
 	test_msgpack_array_iter();
 	test_msgpack_mapa_iter();
 	test_pushes(uri);
+	test_async(uri);
+	test_nonblock(uri);
+	test_zerocopy(uri);
+	test_send_zerocopy(uri);
+	test_pool(uri);
+	test_uring(uri);
+	test_bulk(uri);
+	test_tmpl(uri);
+	test_prepare(uri);
+	test_reply_tuples(uri);
+	test_cursor(uri);
+	test_scan(uri);
+	test_router(uri);
+	test_merge(uri);
+	test_replicaset(uri);
+	test_rtt(uri);
+	test_deadline(uri);
+	test_reconnect(uri);
+	test_mem(uri);
+	test_reply_pool(uri);
+	test_mem_usage(uri);
+	test_schema_cache(uri);
+	test_large_reply(uri);
 
 	return check_plan();
 }
@@ -95,3 +95,29 @@ function test_5()
     end
     return true
 end
+
+function test_sleep(timeout)
+    fiber.sleep(timeout)
+    return timeout
+end
+
+-- test_stall doesn't return, until test_release is called
+local stall = fiber.channel(1)
+
+function test_stall()
+    stall:get()
+    return true
+end
+
+function test_release()
+    stall:put(true)
+    return true
+end
+
+function test_tuples(count, size)
+    local result = {}
+    for i = 1, count do
+        result[i] = {i, string.rep('x', size)}
+    end
+    return unpack(result)
+end
@@ -35,7 +35,7 @@ mh_cmp_key_eq(
 static inline void *
 tnt_mem_calloc(size_t count, size_t size) {
 	size_t sz = count * size;
-	void *alloc = tnt_mem_alloc(sz);
+	void *alloc = tnt_mem_alloc_tag(sz, TNT_MEM_SCHEMA);
 	if (!alloc) return 0;
 	memset(alloc, 0, sz);
 	return alloc;
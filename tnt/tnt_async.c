@@ -0,0 +1,331 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_async.h>
+
+#include "tnt_clock.h"
+#include "tnt_wheel.h"
+
+/**
+ * \internal
+ * \brief pending request, waiting for reply
+ */
+struct tnt_async_req {
+	uint64_t sync;
+	tnt_async_cb_t cb;
+	void *arg;
+	struct tnt_timer timer; /* deadline, if it's set */
+};
+
+/* wheel ticks are milliseconds */
+static inline uint64_t
+tnt_async_now(void) {
+	return tnt_clock_usec() / 1000;
+}
+
+static inline void *
+tnt_async_calloc(size_t count, size_t size) {
+	size_t sz = count * size;
+	void *alloc = tnt_mem_alloc_tag(sz, TNT_MEM_REQUEST);
+	if (!alloc) return NULL;
+	memset(alloc, 0, sz);
+	return alloc;
+}
+
+#define mh_name               _async
+#define mh_arg_t              void *
+#define mh_node_t             struct tnt_async_req *
+#define mh_key_t              uint64_t
+#define mh_hash(x, arg)       ((uint32_t)((*x)->sync ^ ((*x)->sync >> 32)))
+#define mh_hash_key(x, arg)   ((uint32_t)((x) ^ ((x) >> 32)))
+#define mh_eq(a, b, arg)      ((*a)->sync == (*b)->sync)
+#define mh_eq_key(a, b, arg)  ((a) == (*b)->sync)
+#define MH_CALLOC(x, y)       tnt_async_calloc((x), (y))
+#define MH_FREE(x)            tnt_mem_free((x))
+#define MH_INCREMENTAL_RESIZE 1
+#define MH_SOURCE             1
+#include                      <mhash.h>
+
+/* unregister request and free it */
+static void
+tnt_async_remove(struct tnt_stream_net *sn, mh_int_t slot,
+		 struct tnt_async_req *req)
+{
+	if (sn->wheel != NULL)
+		tnt_wheel_del(sn->wheel, &req->timer);
+	mh_async_del(sn->async, slot, NULL);
+	tnt_mem_free(req);
+}
+
+int
+tnt_async_register(struct tnt_stream *s, uint64_t sync, tnt_async_cb_t cb,
+		   void *arg)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL) {
+		sn->async = mh_async_new();
+		if (sn->async == NULL)
+			return -1;
+	}
+	if (mh_async_find(sn->async, sync, NULL) != mh_end(sn->async))
+		return -1;
+	struct tnt_async_req *req = tnt_mem_alloc_ex(NULL, sn->stats,
+				sizeof(struct tnt_async_req), TNT_MEM_REQUEST);
+	if (req == NULL)
+		return -1;
+	memset(req, 0, sizeof(struct tnt_async_req));
+	req->sync = sync;
+	req->cb = cb;
+	req->arg = arg;
+	if (mh_async_put(sn->async, (const struct tnt_async_req **)&req,
+			 NULL, NULL) == mh_end(sn->async)) {
+		tnt_mem_free(req);
+		return -1;
+	}
+	return 0;
+}
+
+uint64_t
+tnt_async_last(struct tnt_stream *s)
+{
+	return s->reqid - 1;
+}
+
+int
+tnt_async_cancel(struct tnt_stream *s, uint64_t sync)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return -1;
+	mh_int_t slot = mh_async_find(sn->async, sync, NULL);
+	if (slot == mh_end(sn->async))
+		return -1;
+	tnt_async_remove(sn, slot, *mh_async_node(sn->async, slot));
+	return 0;
+}
+
+int
+tnt_async_deadline(struct tnt_stream *s, uint64_t sync, uint32_t timeout)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return -1;
+	mh_int_t slot = mh_async_find(sn->async, sync, NULL);
+	if (slot == mh_end(sn->async))
+		return -1;
+	struct tnt_async_req *req = *mh_async_node(sn->async, slot);
+	uint64_t now = tnt_async_now();
+	if (sn->wheel == NULL) {
+		sn->wheel = tnt_mem_alloc_tag(sizeof(struct tnt_wheel),
+					      TNT_MEM_REQUEST);
+		if (sn->wheel == NULL)
+			return -1;
+		tnt_wheel_init(sn->wheel, now);
+	}
+	tnt_wheel_del(sn->wheel, &req->timer);
+	tnt_wheel_add(sn->wheel, &req->timer, now + timeout);
+	return 0;
+}
+
+int
+tnt_async_expire(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct tnt_wheel *w = sn->wheel;
+	if (w == NULL || w->count == 0)
+		return 0;
+	tnt_wheel_advance(w, tnt_async_now());
+	int expired = 0;
+	/* callbacks may cancel other expired requests */
+	while (w->expired != NULL) {
+		struct tnt_async_req *req = (struct tnt_async_req *)
+			((char *)w->expired - offsetof(struct tnt_async_req,
+						      timer));
+		mh_int_t slot = mh_async_find(sn->async, req->sync, NULL);
+		tnt_async_cb_t cb = req->cb;
+		void *arg = req->arg;
+		tnt_async_remove(sn, slot, req);
+		/* reply will be dropped by its sync, when it arrives */
+		cb(s, NULL, TNT_ETMOUT, arg);
+		expired++;
+	}
+	return expired;
+}
+
+int
+tnt_async_timeout(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->wheel == NULL)
+		return -1;
+	uint64_t next = tnt_wheel_next(sn->wheel);
+	if (next == UINT64_MAX)
+		return -1;
+	uint64_t now = tnt_async_now();
+	if (next <= now)
+		return 0;
+	return (next - now > INT32_MAX) ? INT32_MAX : (int)(next - now);
+}
+
+int
+tnt_async_complete(struct tnt_stream *s, struct tnt_reply *r)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return 0;
+	mh_int_t slot = mh_async_find(sn->async, r->sync, NULL);
+	if (slot == mh_end(sn->async))
+		return 0;
+	struct tnt_async_req *req = *mh_async_node(sn->async, slot);
+	tnt_async_cb_t cb = req->cb;
+	void *arg = req->arg;
+	/* callback may register new requests, so unregister it before */
+	if (r->error || (r->code & TNT_CHUNK) == 0)
+		tnt_async_remove(sn, slot, req);
+	cb(s, r, TNT_EOK, arg);
+	return 1;
+}
+
+int
+tnt_async_pending(struct tnt_stream *s, uint64_t sync)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return 0;
+	return mh_async_find(sn->async, sync, NULL) != mh_end(sn->async);
+}
+
+int
+tnt_async_lost(struct tnt_stream *s, uint64_t sync)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return 0;
+	mh_int_t slot = mh_async_find(sn->async, sync, NULL);
+	if (slot == mh_end(sn->async))
+		return 0;
+	struct tnt_async_req *req = *mh_async_node(sn->async, slot);
+	tnt_async_cb_t cb = req->cb;
+	void *arg = req->arg;
+	tnt_async_remove(sn, slot, req);
+	cb(s, NULL, TNT_ELOST, arg);
+	return 1;
+}
+
+void
+tnt_async_fail(struct tnt_stream *s, enum tnt_error error)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return;
+	while (mh_size(sn->async) > 0) {
+		mh_int_t slot = mh_first(sn->async);
+		struct tnt_async_req *req = *mh_async_node(sn->async, slot);
+		tnt_async_cb_t cb = req->cb;
+		void *arg = req->arg;
+		tnt_async_remove(sn, slot, req);
+		cb(s, NULL, error, arg);
+	}
+}
+
+void
+tnt_async_free(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return;
+	mh_int_t slot;
+	mh_foreach(sn->async, slot)
+		tnt_mem_free(*mh_async_node(sn->async, slot));
+	mh_async_delete(sn->async);
+	sn->async = NULL;
+	tnt_mem_free(sn->wheel);
+	sn->wheel = NULL;
+}
+
+uint32_t
+tnt_async_count(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->async == NULL)
+		return 0;
+	return mh_size(sn->async);
+}
+
+int
+tnt_async_dispatch(struct tnt_stream *s, int count)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (tnt_flush(s) == -1) {
+		tnt_async_fail(s, sn->error);
+		return -1;
+	}
+	return tnt_async_process(s, count);
+}
+
+int
+tnt_async_process(struct tnt_stream *s, int count)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	int processed = 0;
+	struct tnt_reply r;
+	while (count == 0 || processed < count) {
+		tnt_reply_init(&r);
+		int rc = s->read_reply(s, &r);
+		if (rc == 1)
+			break;
+		if (rc == -1 && sn->error == TNT_ELOST) {
+			/* request without callback was lost on reconnect */
+			processed++;
+			continue;
+		}
+		if (rc == -1) {
+			tnt_async_fail(s, (sn->error != TNT_EOK) ?
+					  sn->error : TNT_EFAIL);
+			return -1;
+		}
+		tnt_async_complete(s, &r);
+		tnt_reply_free(&r);
+		processed++;
+	}
+	return processed + tnt_async_expire(s);
+}
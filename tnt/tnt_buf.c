@@ -67,7 +67,7 @@ static char* tnt_buf_resize(struct tnt_stream *s, size_t size) {
 	struct tnt_stream_buf *sb = TNT_SBUF_CAST(s);
 	size_t off = sb->size;
 	size_t nsize = off + size;
-	char *nd = tnt_mem_realloc(sb->data, nsize);
+	char *nd = tnt_mem_realloc_tag(sb->data, nsize, TNT_MEM_OBJECT);
 	if (nd == NULL) {
 		tnt_mem_free(sb->data);
 		return NULL;
@@ -128,7 +128,8 @@ struct tnt_stream *tnt_buf(struct tnt_stream *s) {
 	if (s == NULL)
 		return NULL;
 	/* allocating stream data */
-	s->data = tnt_mem_alloc(sizeof(struct tnt_stream_buf));
+	s->data = tnt_mem_alloc_tag(sizeof(struct tnt_stream_buf),
+				    TNT_MEM_OBJECT);
 	if (s->data == NULL) {
 		if (allocated)
 			tnt_stream_free(s);
@@ -0,0 +1,227 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/poll.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_object.h>
+#include <tarantool/tnt_insert.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_bulk.h>
+
+#include "pmatomic.h"
+
+/* default count of requests in flight */
+#define TNT_BULK_WINDOW 1024
+
+struct tnt_bulk *
+tnt_bulk(struct tnt_bulk *b, struct tnt_stream *s, uint32_t space,
+	 enum tnt_request_t op)
+{
+	if (op != TNT_OP_INSERT && op != TNT_OP_REPLACE)
+		return NULL;
+	int alloc = (b == NULL);
+	if (alloc) {
+		b = tnt_mem_alloc_tag(sizeof(struct tnt_bulk), TNT_MEM_REQUEST);
+		if (b == NULL)
+			return NULL;
+	}
+	memset(b, 0, sizeof(struct tnt_bulk));
+	b->alloc = alloc;
+	b->s = s;
+	b->space = space;
+	b->op = op;
+	b->window = TNT_BULK_WINDOW;
+	b->tuple = tnt_object(NULL);
+	if (b->tuple == NULL) {
+		tnt_bulk_free(b);
+		return NULL;
+	}
+	return b;
+}
+
+void
+tnt_bulk_window(struct tnt_bulk *b, uint32_t window)
+{
+	b->window = (window > 0) ? window : 1;
+}
+
+void
+tnt_bulk_source(struct tnt_bulk *b, tnt_bulk_source_t source, void *arg)
+{
+	b->source = source;
+	b->source_arg = arg;
+}
+
+void
+tnt_bulk_on_error(struct tnt_bulk *b, tnt_bulk_error_t error, void *arg)
+{
+	b->error = error;
+	b->error_arg = arg;
+}
+
+/**
+ * Wait until non-blocking stream's socket is ready for given events.
+ */
+static int
+tnt_bulk_wait(struct tnt_stream *s, short events)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct pollfd pfd = { sn->fd, events, 0 };
+	int rc;
+	do {
+		rc = poll(&pfd, 1, -1);
+	} while (rc == -1 && errno == EINTR);
+	if (rc == -1) {
+		sn->error = TNT_ESYSTEM;
+		sn->errno_ = errno;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Send queued fragments, that may reference tuple (TNT_OPT_SEND_ZEROCOPY),
+ * before tuple is reused.
+ */
+static int
+tnt_bulk_release(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	while (sn->sendq.count > 0) {
+		if (tnt_flush(s) == -1)
+			return -1;
+		if (sn->sendq.count > 0 && tnt_bulk_wait(s, POLLOUT) == -1)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * Read next reply and account tuple, that it's for. Tuple number is count
+ * of tuples, sent before the run, plus its sync relative to the first sync
+ * of the run.
+ */
+static int
+tnt_bulk_reap(struct tnt_bulk *b, uint64_t first, uint64_t before)
+{
+	struct tnt_stream *s = b->s;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct tnt_reply r;
+	tnt_reply_init(&r);
+	int rc;
+	while ((rc = s->read_reply(s, &r)) == 1) {
+		if (!sn->nonblock) {
+			sn->error = TNT_EFAIL;
+			return -1;
+		}
+		/* reply is incomplete, keep sending while waiting for it */
+		if (tnt_flush(s) == -1)
+			return -1;
+		short events = POLLIN;
+		if (tnt_wants(s) & TNT_WANT_WRITE)
+			events |= POLLOUT;
+		if (tnt_bulk_wait(s, events) == -1)
+			return -1;
+	}
+	if (rc == -1)
+		return -1;
+	if (r.error != NULL) {
+		b->failed++;
+		if (b->error)
+			b->error(before + (r.sync - first), &r, b->error_arg);
+	} else {
+		b->loaded++;
+	}
+	tnt_reply_free(&r);
+	return 0;
+}
+
+int
+tnt_bulk_run(struct tnt_bulk *b)
+{
+	struct tnt_stream *s = b->s;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (b->source == NULL || sn->uring != NULL ||
+	    pm_atomic_load(&s->wrcnt) != 0) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	/* stream may be used for other requests or reconnected between runs */
+	uint64_t first = s->reqid, before = b->sent;
+	uint32_t inflight = 0;
+	int eof = 0;
+	while (!eof || inflight > 0) {
+		while (!eof && inflight < b->window) {
+			if (tnt_bulk_release(s) == -1)
+				return -1;
+			tnt_object_reset(b->tuple);
+			if (b->source(b->tuple, b->source_arg) == 0) {
+				eof = 1;
+				break;
+			}
+			/* sbuf is flushed by write, when it's full */
+			ssize_t rc = (b->op == TNT_OP_INSERT) ?
+				tnt_insert(s, b->space, b->tuple) :
+				tnt_replace(s, b->space, b->tuple);
+			if (rc == -1)
+				return -1;
+			b->sent++;
+			inflight++;
+		}
+		if (tnt_flush(s) == -1)
+			return -1;
+		/* drain half of window, so that sends are batched too */
+		uint32_t low = eof ? 0 : b->window / 2;
+		for (; inflight > low; inflight--)
+			if (tnt_bulk_reap(b, first, before) == -1)
+				return -1;
+	}
+	return 0;
+}
+
+void
+tnt_bulk_free(struct tnt_bulk *b)
+{
+	if (b == NULL)
+		return;
+	if (b->tuple)
+		tnt_stream_free(b->tuple);
+	if (b->alloc)
+		tnt_mem_free(b);
+}
@@ -0,0 +1,16 @@
+#ifndef TNT_CLOCK_H_INCLUDED
+#define TNT_CLOCK_H_INCLUDED
+
+#include <stdint.h>
+#include <time.h>
+
+/* monotonic time in microseconds */
+static inline uint64_t
+tnt_clock_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /* TNT_CLOCK_H_INCLUDED */
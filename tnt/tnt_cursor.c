@@ -0,0 +1,373 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/poll.h>
+
+#include <msgpuck.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_buf.h>
+#include <tarantool/tnt_object.h>
+#include <tarantool/tnt_select.h>
+#include <tarantool/tnt_schema.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_cursor.h>
+
+#include "pmatomic.h"
+#include "tnt_key.h"
+
+/* default count of tuples per page */
+#define TNT_CURSOR_PAGE 1000
+
+struct tnt_cursor *
+tnt_cursor(struct tnt_cursor *c, struct tnt_stream *s, uint32_t space,
+	   uint32_t index)
+{
+	const struct tnt_schema_ival *def =
+		tnt_schema_index(tnt_net_schema(s), space, index);
+	if (def == NULL || def->part_count == 0)
+		return NULL;
+	int alloc = (c == NULL);
+	if (alloc) {
+		c = tnt_mem_alloc_tag(sizeof(struct tnt_cursor), TNT_MEM_ITER);
+		if (c == NULL)
+			return NULL;
+	}
+	memset(c, 0, sizeof(struct tnt_cursor));
+	c->alloc = alloc;
+	c->s = s;
+	c->space = space;
+	c->index = index;
+	c->page = TNT_CURSOR_PAGE;
+	c->unique = def->unique || index == 0;
+	c->part_count = def->part_count;
+	tnt_reply_init(&c->reply);
+	c->parts = tnt_mem_alloc_tag(c->part_count * sizeof(uint32_t),
+				     TNT_MEM_ITER);
+	c->fields = tnt_mem_alloc_tag(c->part_count * sizeof(const char *),
+				      TNT_MEM_ITER);
+	c->key = tnt_object(NULL);
+	c->cmp = tnt_object(NULL);
+	if (c->parts == NULL || c->fields == NULL ||
+	    c->key == NULL || c->cmp == NULL) {
+		tnt_cursor_free(c);
+		return NULL;
+	}
+	memcpy(c->parts, def->parts, c->part_count * sizeof(uint32_t));
+	c->iterator = TNT_ITER_ALL;
+	if (tnt_object_add_array(c->key, 0) == -1) {
+		tnt_cursor_free(c);
+		return NULL;
+	}
+	tnt_object_container_close(c->key);
+	return c;
+}
+
+void
+tnt_cursor_page(struct tnt_cursor *c, uint32_t page)
+{
+	c->page = (page > 0) ? page : 1;
+}
+
+/**
+ * Wait until non-blocking stream's socket is ready for given events.
+ */
+static int
+tnt_cursor_wait(struct tnt_stream *s, short events)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct pollfd pfd = { sn->fd, events, 0 };
+	int rc;
+	do {
+		rc = poll(&pfd, 1, -1);
+	} while (rc == -1 && errno == EINTR);
+	if (rc == -1) {
+		sn->error = TNT_ESYSTEM;
+		sn->errno_ = errno;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Encode key parts of tuple into key object. Missing fields are
+ * encoded as nils.
+ */
+static int
+tnt_cursor_key(struct tnt_cursor *c, const char *tuple,
+	       struct tnt_stream *key)
+{
+	tnt_key_fields(tuple, c->parts, c->part_count, c->fields);
+	tnt_object_reset(key);
+	if (tnt_object_add_array(key, c->part_count) == -1)
+		goto error;
+	for (uint32_t i = 0; i < c->part_count; i++) {
+		const char *end = c->fields[i];
+		mp_next(&end);
+		if (key->write(key, c->fields[i], end - c->fields[i]) == -1)
+			goto error;
+	}
+	tnt_object_container_close(key);
+	return 0;
+error:
+	TNT_SNET_CAST(c->s)->error = TNT_EMEMORY;
+	return -1;
+}
+
+static inline int
+tnt_cursor_key_equal(struct tnt_stream *a, struct tnt_stream *b)
+{
+	return TNT_SBUF_SIZE(a) == TNT_SBUF_SIZE(b) &&
+	       memcmp(TNT_SBUF_DATA(a), TNT_SBUF_DATA(b),
+		      TNT_SBUF_SIZE(a)) == 0;
+}
+
+static inline int
+tnt_cursor_key_compare(struct tnt_stream *a, struct tnt_stream *b)
+{
+	return tnt_key_compare(TNT_SBUF_DATA(a), TNT_SBUF_DATA(b));
+}
+
+static int
+tnt_cursor_key_copy(struct tnt_stream *dst, struct tnt_stream *src)
+{
+	const char *data = TNT_SBUF_DATA(src);
+	if (TNT_SBUF_SIZE(src) == 0 || mp_typeof(*data) != MP_ARRAY)
+		return -1;
+	tnt_object_reset(dst);
+	if (dst->write(dst, data, TNT_SBUF_SIZE(src)) == -1)
+		return -1;
+	return 0;
+}
+
+int
+tnt_cursor_range(struct tnt_cursor *c, struct tnt_stream *from,
+		 struct tnt_stream *to)
+{
+	if (from != NULL) {
+		if (tnt_cursor_key_copy(c->key, from) == -1)
+			return -1;
+		c->iterator = TNT_ITER_GE;
+	}
+	if (to != NULL) {
+		if (c->to == NULL && (c->to = tnt_object(NULL)) == NULL)
+			return -1;
+		if (tnt_cursor_key_copy(c->to, to) == -1)
+			return -1;
+		if (from != NULL && tnt_cursor_key_compare(c->key, c->to) >= 0)
+			c->eof = 1;
+	}
+	return 0;
+}
+
+/**
+ * Send request for the next page.
+ */
+static int
+tnt_cursor_fetch(struct tnt_cursor *c)
+{
+	struct tnt_stream *s = c->s;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->uring != NULL || pm_atomic_load(&s->wrcnt) != 0) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	uint64_t sync = s->reqid;
+	/* duplicates of non-unique key are ordered by primary key */
+	if (tnt_select(s, c->space, c->index, c->page, c->dup,
+		       c->iterator, c->key) == -1 || tnt_flush(s) == -1)
+		return -1;
+	c->sync = sync;
+	c->fetching = 1;
+	return 0;
+}
+
+/**
+ * Read reply for page request in flight.
+ */
+static int
+tnt_cursor_read(struct tnt_cursor *c)
+{
+	struct tnt_stream *s = c->s;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	tnt_reply_free(&c->reply);
+	tnt_reply_init(&c->reply);
+	int rc;
+	while ((rc = s->read_reply(s, &c->reply)) == 1) {
+		if (!sn->nonblock) {
+			sn->error = TNT_EFAIL;
+			break;
+		}
+		/* reply is incomplete, keep sending while waiting for it */
+		if (tnt_flush(s) == -1)
+			break;
+		short events = POLLIN;
+		if (tnt_wants(s) & TNT_WANT_WRITE)
+			events |= POLLOUT;
+		if (tnt_cursor_wait(s, events) == -1)
+			break;
+	}
+	c->fetching = 0;
+	if (rc != 0)
+		return -1;
+	if (c->reply.sync != c->sync) {
+		sn->error = TNT_EFAIL;
+		return -1;
+	}
+	return c->reply.error != NULL ? -1 : 0;
+}
+
+/**
+ * Receive page, remember key of its last tuple and request the next page
+ * before the current one is handed out.
+ */
+static int
+tnt_cursor_receive(struct tnt_cursor *c)
+{
+	if (tnt_cursor_read(c) == -1) {
+		c->eof = 1;
+		return -1;
+	}
+	const char *data = c->reply.data;
+	uint32_t count = 0;
+	if (data != NULL && mp_typeof(*data) == MP_ARRAY)
+		count = mp_decode_array(&data);
+	c->tuple = data;
+	c->left = count;
+	if (count == 0 || (count < c->page && c->to == NULL)) {
+		c->eof = 1;
+		return 0;
+	}
+	if (!c->unique && c->tuples_alloc < count) {
+		const char **tuples = tnt_mem_realloc_tag(c->tuples,
+					count * sizeof(const char *),
+					TNT_MEM_ITER);
+		if (tuples == NULL) {
+			TNT_SNET_CAST(c->s)->error = TNT_EMEMORY;
+			return -1;
+		}
+		c->tuples = tuples;
+		c->tuples_alloc = count;
+	}
+	const char *last = data, *tuple = data;
+	for (uint32_t i = 0; i < count; i++) {
+		if (!c->unique)
+			c->tuples[i] = tuple;
+		last = tuple;
+		mp_next(&tuple);
+	}
+	if (tnt_cursor_key(c, last, c->cmp) == -1)
+		return -1;
+	if (c->to != NULL && tnt_cursor_key_compare(c->cmp, c->to) >= 0) {
+		/* page crosses upper bound, hand out tuples below it */
+		uint32_t n = 0;
+		for (tuple = data; n < count; n++, mp_next(&tuple)) {
+			if (tnt_cursor_key(c, tuple, c->key) == -1)
+				return -1;
+			if (tnt_cursor_key_compare(c->key, c->to) >= 0)
+				break;
+		}
+		c->left = n;
+		c->eof = 1;
+		return 0;
+	}
+	if (count < c->page) {
+		c->eof = 1;
+		return 0;
+	}
+	if (!c->unique) {
+		int same = tnt_cursor_key_equal(c->key, c->cmp);
+		/* count tuples at the end of page with the same key */
+		uint32_t n = 1;
+		for (; n < count; n++) {
+			if (tnt_cursor_key(c, c->tuples[count - n - 1],
+					   c->key) == -1)
+				return -1;
+			if (!tnt_cursor_key_equal(c->key, c->cmp))
+				break;
+		}
+		c->dup = (n == count && same) ? c->dup + n : n;
+	}
+	struct tnt_stream *key = c->key;
+	c->key = c->cmp;
+	c->cmp = key;
+	c->iterator = c->unique ? TNT_ITER_GT : TNT_ITER_GE;
+	return tnt_cursor_fetch(c);
+}
+
+int
+tnt_cursor_next(struct tnt_cursor *c, const char **tuple, size_t *size)
+{
+	while (c->left == 0) {
+		if (c->eof)
+			return 0;
+		if (!c->fetching && tnt_cursor_fetch(c) == -1)
+			return -1;
+		if (tnt_cursor_receive(c) == -1)
+			return -1;
+	}
+	const char *end = c->tuple;
+	mp_next(&end);
+	*tuple = c->tuple;
+	*size = end - c->tuple;
+	c->tuple = end;
+	c->left--;
+	return 1;
+}
+
+void
+tnt_cursor_free(struct tnt_cursor *c)
+{
+	if (c == NULL)
+		return;
+	if (c->fetching)
+		tnt_cursor_read(c);
+	tnt_reply_free(&c->reply);
+	tnt_mem_free(c->parts);
+	tnt_mem_free(c->fields);
+	tnt_mem_free(c->tuples);
+	if (c->key)
+		tnt_stream_free(c->key);
+	if (c->cmp)
+		tnt_stream_free(c->cmp);
+	if (c->to)
+		tnt_stream_free(c->to);
+	if (c->alloc)
+		tnt_mem_free(c);
+}
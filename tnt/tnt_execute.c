@@ -57,4 +57,70 @@ tnt_execute(struct tnt_stream *s, const char *expr, size_t elen,
 	v[0].iov_base = len_prefix;
 	v[0].iov_len = len_end - len_prefix;
 	return s->writev(s, v, v_sz);
-}
\ No newline at end of file
+}
+
+ssize_t
+tnt_prepare(struct tnt_stream *s, const char *expr, size_t elen)
+{
+	if (!expr || elen == 0)
+		return -1;
+	struct tnt_iheader hdr;
+	struct iovec v[4];
+	int v_sz = 4;
+	encode_header(&hdr, TNT_OP_PREPARE, s->reqid++);
+	v[1].iov_base = (void *) hdr.header;
+	v[1].iov_len = hdr.end - hdr.header;
+	char body[64];
+	char *data = body;
+
+	data = mp_encode_map(data, 1);
+	data = mp_encode_uint(data, TNT_SQL_TEXT);
+	data = mp_encode_strl(data, elen);
+	v[2].iov_base = body;
+	v[2].iov_len = data - body;
+	v[3].iov_base = (void *) expr;
+	v[3].iov_len = elen;
+
+	size_t package_len = 0;
+	for (int i = 1; i < v_sz; ++i)
+		package_len += v[i].iov_len;
+	char len_prefix[9];
+	char *len_end = mp_encode_luint32(len_prefix, package_len);
+	v[0].iov_base = len_prefix;
+	v[0].iov_len = len_end - len_prefix;
+	return s->writev(s, v, v_sz);
+}
+
+ssize_t
+tnt_execute_id(struct tnt_stream *s, uint64_t stmt_id,
+	       struct tnt_stream *params)
+{
+	if (tnt_object_verify(params, MP_ARRAY))
+		return -1;
+	struct tnt_iheader hdr;
+	struct iovec v[4];
+	int v_sz = 4;
+	encode_header(&hdr, TNT_OP_EXECUTE, s->reqid++);
+	v[1].iov_base = (void *) hdr.header;
+	v[1].iov_len = hdr.end - hdr.header;
+	char body[64];
+	char *data = body;
+
+	data = mp_encode_map(data, 2);
+	data = mp_encode_uint(data, TNT_STMT_ID);
+	data = mp_encode_uint(data, stmt_id);
+	data = mp_encode_uint(data, TNT_SQL_BIND);
+	v[2].iov_base = body;
+	v[2].iov_len = data - body;
+	v[3].iov_base = TNT_SBUF_DATA(params);
+	v[3].iov_len = TNT_SBUF_SIZE(params);
+
+	size_t package_len = 0;
+	for (int i = 1; i < v_sz; ++i)
+		package_len += v[i].iov_len;
+	char len_prefix[9];
+	char *len_end = mp_encode_luint32(len_prefix, package_len);
+	v[0].iov_base = len_prefix;
+	v[0].iov_len = len_end - len_prefix;
+	return s->writev(s, v, v_sz);
+}
@@ -60,6 +60,12 @@
 #if !defined(MIN)
 #	define MIN(a, b) (a) < (b) ? (a) : (b)
 #endif /* !defined(MIN) */
+#if !defined(MAX)
+#	define MAX(a, b) (a) > (b) ? (a) : (b)
+#endif /* !defined(MAX) */
+
+/* minimal size of fragment, that may be sent by reference */
+#define TNT_IO_SENDQ_MIN 256
 
 #define TIMEVAL_TO_MSEC(tv) ((tv).tv_sec * 1000 + (tv).tv_usec / 1000)
 #define TIMEVAL_DIFF_MSEC(tv1, tv2) (((tv1).tv_sec - (tv2).tv_sec) * 1000 + \
@@ -305,11 +311,157 @@ void tnt_io_close(struct tnt_stream_net *s)
 		s->fd = -1;
 	}
 	s->connected = 0;
+	s->nonblock = 0;
+}
+
+enum tnt_error
+tnt_io_set_nonblock(struct tnt_stream_net *s, int set)
+{
+	enum tnt_error result = tnt_io_nonblock(s, set);
+	if (result == TNT_EOK)
+		s->nonblock = set;
+	return result;
+}
+
+static inline int
+tnt_io_wouldblock(ssize_t r)
+{
+	return r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/** Send as much of sbuf as socket accepts, keep the rest buffered. */
+static ssize_t
+tnt_io_flush_nonblock(struct tnt_stream_net *s)
+{
+	size_t off = 0;
+	while (off < s->sbuf.off) {
+		ssize_t r;
+		if (s->sbuf.tx) {
+			r = s->sbuf.tx(&s->sbuf, s->sbuf.buf + off,
+				       s->sbuf.off - off);
+		} else {
+			do {
+				r = send(s->fd, s->sbuf.buf + off,
+					 s->sbuf.off - off, 0);
+			} while (r == -1 && (errno == EINTR));
+		}
+		if (tnt_io_wouldblock(r))
+			break;
+		if (r <= 0) {
+			s->error = TNT_ESYSTEM;
+			s->errno_ = errno;
+			return -1;
+		}
+		off += r;
+	}
+	if (off > 0) {
+		memmove(s->sbuf.buf, s->sbuf.buf + off, s->sbuf.off - off);
+		s->sbuf.off -= off;
+	}
+	return off;
+}
+
+static ssize_t
+tnt_io_writev_once(struct tnt_stream_net *s, struct iovec *iov, int count)
+{
+	ssize_t r;
+	if (s->sbuf.txv) {
+		r = s->sbuf.txv(&s->sbuf, iov, count);
+	} else if (s->sbuf.tx) {
+		r = s->sbuf.tx(&s->sbuf, iov[0].iov_base, iov[0].iov_len);
+	} else {
+		do {
+			r = writev(s->fd, iov, count);
+		} while (r == -1 && (errno == EINTR));
+	}
+	return r;
+}
+
+int
+tnt_io_pending(struct tnt_stream_net *s, struct iovec *iov, int count)
+{
+	struct tnt_iovq *q = &s->sendq;
+	if (q->count == 0) {
+		if (s->sbuf.off == 0 || count == 0)
+			return 0;
+		iov[0].iov_base = s->sbuf.buf;
+		iov[0].iov_len = s->sbuf.off;
+		return 1;
+	}
+	char *sbuf_pos = s->sbuf.buf;
+	int i;
+	for (i = 0; i < q->count && i < count; i++) {
+		iov[i] = q->iov[i];
+		if (iov[i].iov_base == NULL) {
+			iov[i].iov_base = sbuf_pos;
+			sbuf_pos += q->iov[i].iov_len;
+		}
+	}
+	return i;
+}
+
+void
+tnt_io_sent(struct tnt_stream_net *s, size_t size)
+{
+	struct tnt_iovq *q = &s->sendq;
+	size_t sbuf_sent = 0;
+	if (q->count == 0) {
+		sbuf_sent = size;
+	} else {
+		int head = 0;
+		while (size > 0) {
+			struct iovec *e = &q->iov[head];
+			size_t len = MIN(size, e->iov_len);
+			if (e->iov_base == NULL)
+				sbuf_sent += len;
+			else
+				e->iov_base = (char *)e->iov_base + len;
+			e->iov_len -= len;
+			size -= len;
+			if (e->iov_len == 0)
+				head++;
+		}
+		memmove(q->iov, q->iov + head,
+			(q->count - head) * sizeof(struct iovec));
+		q->count -= head;
+	}
+	memmove(s->sbuf.buf, s->sbuf.buf + sbuf_sent, s->sbuf.off - sbuf_sent);
+	s->sbuf.off -= sbuf_sent;
+}
+
+/**
+ * Send queued fragments with writev, up to IOV_MAX of them at once.
+ * If 'all' isn't set, then stop when socket would block.
+ */
+static ssize_t
+tnt_io_flush_queue(struct tnt_stream_net *s, int all)
+{
+	struct tnt_iovq *q = &s->sendq;
+	size_t total = 0;
+	while (q->count > 0) {
+		struct iovec iov[MIN(q->count, getiovmax())];
+		int count = tnt_io_pending(s, iov, sizeof(iov) / sizeof(*iov));
+		ssize_t r = tnt_io_writev_once(s, iov, count);
+		if (!all && tnt_io_wouldblock(r))
+			break;
+		if (r <= 0) {
+			s->error = TNT_ESYSTEM;
+			s->errno_ = errno;
+			return -1;
+		}
+		total += r;
+		tnt_io_sent(s, r);
+	}
+	return total;
 }
 
 ssize_t tnt_io_flush(struct tnt_stream_net *s) {
+	if (s->sendq.count > 0)
+		return tnt_io_flush_queue(s, !s->nonblock);
 	if (s->sbuf.off == 0)
 		return 0;
+	if (s->nonblock)
+		return tnt_io_flush_nonblock(s);
 	ssize_t rc = tnt_io_send_raw(s, s->sbuf.buf, s->sbuf.off, 1);
 	if (rc == -1)
 		return -1;
@@ -376,9 +528,95 @@ tnt_io_sendv_raw(struct tnt_stream_net *s, struct iovec *iov, int count, int all
 	return total;
 }
 
+inline static void
+tnt_io_sendv_put(struct tnt_stream_net *s, struct iovec *iov, int count) {
+	int i;
+	for (i = 0 ; i < count ; i++) {
+		memcpy(s->sbuf.buf + s->sbuf.off,
+		       iov[i].iov_base,
+		       iov[i].iov_len);
+		s->sbuf.off += iov[i].iov_len;
+	}
+}
+
+/**
+ * Never blocks: data is appended to sbuf, which grows if needed. Buffer
+ * is flushed opportunistically, when it's filled above the configured size
+ * (but not for io_uring streams, ring sends the buffer).
+ */
+static ssize_t
+tnt_io_sendv_nonblock(struct tnt_stream_net *s, struct iovec *iov, int count,
+		      size_t size)
+{
+	if (!s->uring && s->sbuf.off + size > (size_t)s->opt.send_buf &&
+	    tnt_io_flush_nonblock(s) == -1)
+		return -1;
+	if (tnt_iob_grow(&s->sbuf, s->sbuf.off + size) == -1) {
+		s->error = TNT_EMEMORY;
+		return -1;
+	}
+	tnt_io_sendv_put(s, iov, count);
+	return size;
+}
+
+/**
+ * Fragments of at least opt.send_zerocopy bytes are queued by reference,
+ * smaller ones are coalesced in sbuf. Queue is flushed, when it's filled
+ * above configured send buffer size or IOV_MAX fragments (unless stream
+ * is attached to io_uring).
+ */
+static ssize_t
+tnt_io_sendv_queue(struct tnt_stream_net *s, struct iovec *iov, int count,
+		   size_t size)
+{
+	/* request headers are encoded on stack, never reference them */
+	size_t min = MAX((size_t)s->opt.send_zerocopy, TNT_IO_SENDQ_MIN);
+	size_t copy = 0;
+	int i;
+	for (i = 0; i < count; i++)
+		if (iov[i].iov_len < min)
+			copy += iov[i].iov_len;
+	struct tnt_iovq *q = &s->sendq;
+	if (!s->uring && (s->sbuf.off + copy > (size_t)s->opt.send_buf ||
+			  q->count + count > getiovmax()) &&
+	    tnt_io_flush_queue(s, !s->nonblock) == -1)
+		return -1;
+	if (tnt_iob_grow(&s->sbuf, s->sbuf.off + copy) == -1 ||
+	    tnt_iovq_reserve(q, count) == -1) {
+		s->error = TNT_EMEMORY;
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		size_t len = iov[i].iov_len;
+		if (len == 0)
+			continue;
+		if (len >= min) {
+			q->iov[q->count++] = iov[i];
+			continue;
+		}
+		memcpy(s->sbuf.buf + s->sbuf.off, iov[i].iov_base, len);
+		s->sbuf.off += len;
+		if (q->count > 0 && q->iov[q->count - 1].iov_base == NULL) {
+			q->iov[q->count - 1].iov_len += len;
+		} else {
+			q->iov[q->count].iov_base = NULL;
+			q->iov[q->count++].iov_len = len;
+		}
+	}
+	return size;
+}
+
 ssize_t
 tnt_io_send(struct tnt_stream_net *s, const char *buf, size_t size)
 {
+	if (s->opt.send_zerocopy) {
+		struct iovec iov = { (void *)buf, size };
+		return tnt_io_sendv_queue(s, &iov, 1, size);
+	}
+	if (s->nonblock) {
+		struct iovec iov = { (void *)buf, size };
+		return tnt_io_sendv_nonblock(s, &iov, 1, size);
+	}
 	if (s->sbuf.buf == NULL)
 		return tnt_io_send_raw(s, buf, size, 1);
 	if (size > s->sbuf.size) {
@@ -398,26 +636,19 @@ tnt_io_send(struct tnt_stream_net *s, const char *buf, size_t size)
 	return size;
 }
 
-inline static void
-tnt_io_sendv_put(struct tnt_stream_net *s, struct iovec *iov, int count) {
-	int i;
-	for (i = 0 ; i < count ; i++) {
-		memcpy(s->sbuf.buf + s->sbuf.off,
-		       iov[i].iov_base,
-		       iov[i].iov_len);
-		s->sbuf.off += iov[i].iov_len;
-	}
-}
-
 ssize_t
 tnt_io_sendv(struct tnt_stream_net *s, struct iovec *iov, int count)
 {
-	if (s->sbuf.buf == NULL)
-		return tnt_io_sendv_raw(s, iov, count, 1);
 	size_t size = 0;
 	int i;
 	for (i = 0 ; i < count ; i++)
 		size += iov[i].iov_len;
+	if (s->opt.send_zerocopy)
+		return tnt_io_sendv_queue(s, iov, count, size);
+	if (s->nonblock)
+		return tnt_io_sendv_nonblock(s, iov, count, size);
+	if (s->sbuf.buf == NULL)
+		return tnt_io_sendv_raw(s, iov, count, 1);
 	if (size > s->sbuf.size) {
 		s->error = TNT_EBIG;
 		return -1;
@@ -462,38 +693,52 @@ tnt_io_recv(struct tnt_stream_net *s, char *buf, size_t size)
 {
 	if (s->rbuf.buf == NULL)
 		return tnt_io_recv_raw(s, buf, size, 1);
-	size_t lv, rv, off = 0, left = size;
-	while (1) {
-		if ((s->rbuf.off + left) <= s->rbuf.top) {
-			memcpy(buf + off, s->rbuf.buf + s->rbuf.off, left);
-			s->rbuf.off += left;
-			return size;
-		}
-
-		lv = s->rbuf.top - s->rbuf.off;
-		rv = left - lv;
-		if (lv) {
-			memcpy(buf + off, s->rbuf.buf + s->rbuf.off, lv);
-			off += lv;
-		}
-
-		s->rbuf.off = 0;
-		ssize_t top = tnt_io_recv_raw(s, s->rbuf.buf, s->rbuf.size, 0);
-		if (top <= 0) {
-			s->errno_ = errno;
+	while (s->rbuf.top - s->rbuf.off < size) {
+		ssize_t r = tnt_io_recv_more(s, size - (s->rbuf.top - s->rbuf.off));
+		if (r == -1)
+			return -1;
+		if (r == 0) {
 			s->error = TNT_ESYSTEM;
+			s->errno_ = EWOULDBLOCK;
 			return -1;
 		}
+	}
+	memcpy(buf, s->rbuf.buf + s->rbuf.off, size);
+	s->rbuf.off += size;
+	return size;
+}
 
-		s->rbuf.top = top;
-		if (rv <= s->rbuf.top) {
-			memcpy(buf + off, s->rbuf.buf, rv);
-			s->rbuf.off = rv;
-			return size;
-		}
-		left -= lv;
+ssize_t
+tnt_io_recv_more(struct tnt_stream_net *s, size_t size)
+{
+	/* data is received by io_uring, \sa tnt_uring_run */
+	if (s->uring)
+		return 0;
+	struct tnt_iob *b = &s->rbuf;
+	/* don't read into tiny tails, compact buffer instead */
+	if (size < TNT_IO_RECV_MIN)
+		size = TNT_IO_RECV_MIN;
+	if (tnt_iob_reserve(b, size) == -1) {
+		s->error = TNT_EMEMORY;
+		return -1;
+	}
+	ssize_t r;
+	if (b->tx) {
+		r = b->tx(b, b->buf + b->top, b->size - b->top);
+	} else {
+		do {
+			r = recv(s->fd, b->buf + b->top, b->size - b->top, 0);
+		} while (r == -1 && (errno == EINTR));
+	}
+	if (s->nonblock && tnt_io_wouldblock(r))
+		return 0;
+	if (r <= 0) {
+		s->error = TNT_ESYSTEM;
+		s->errno_ = (r == 0) ? ECONNRESET : errno;
+		return -1;
 	}
-	return -1;
+	b->top += r;
+	return r;
 }
 
 int getiovmax()
@@ -39,10 +39,13 @@
 #include <tarantool/tnt_mem.h>
 #include <tarantool/tnt_iob.h>
 
+#include "pmatomic.h"
+
 int
 tnt_iob_init(struct tnt_iob *iob, size_t size,
 	     tnt_iob_tx_t tx,
-	     tnt_iob_txv_t txv, void *ptr)
+	     tnt_iob_txv_t txv, void *ptr, struct tnt_mem_ctx *mem,
+	     struct tnt_mem_stats *stats)
 {
 	iob->tx = tx;
 	iob->txv = txv;
@@ -51,8 +54,11 @@ tnt_iob_init(struct tnt_iob *iob, size_t size,
 	iob->off = 0;
 	iob->top = 0;
 	iob->buf = NULL;
+	iob->chunk = NULL;
+	iob->mem = mem;
+	iob->stats = stats;
 	if (size > 0) {
-		iob->buf = tnt_mem_alloc(size);
+		iob->buf = tnt_mem_alloc_ex(mem, stats, size, TNT_MEM_IOB);
 		if (iob->buf == NULL)
 			return -1;
 		memset(iob->buf, 0, size);
@@ -60,9 +66,21 @@ tnt_iob_init(struct tnt_iob *iob, size_t size,
 	return 0;
 }
 
+static inline int
+tnt_iob_shared(struct tnt_iob *iob)
+{
+	return iob->chunk != NULL && pm_atomic_load(&iob->chunk->refs) > 1;
+}
+
 void
 tnt_iob_clear(struct tnt_iob *iob)
 {
+	if (tnt_iob_shared(iob)) {
+		/* memory is still in use, next reserve will replace it */
+		iob->top = iob->size;
+		iob->off = iob->size;
+		return;
+	}
 	iob->top = 0;
 	iob->off = 0;
 }
@@ -70,6 +88,166 @@ tnt_iob_clear(struct tnt_iob *iob)
 void
 tnt_iob_free(struct tnt_iob *iob)
 {
-	if (iob->buf)
+	if (iob->chunk) {
+		tnt_iob_unref(iob->chunk);
+		iob->chunk = NULL;
+	} else if (iob->buf) {
 		tnt_mem_free(iob->buf);
+	}
+	iob->buf = NULL;
+}
+
+int
+tnt_iob_grow(struct tnt_iob *iob, size_t size)
+{
+	if (iob->size >= size)
+		return 0;
+	size_t nsize = (iob->size > 0) ? iob->size : 16384;
+	while (nsize < size)
+		nsize *= 2;
+	char *nbuf = tnt_mem_realloc_ex(iob->mem, iob->stats, iob->buf, nsize,
+					TNT_MEM_IOB);
+	if (nbuf == NULL)
+		return -1;
+	iob->buf = nbuf;
+	iob->size = nsize;
+	if (iob->chunk)
+		iob->chunk->buf = nbuf;
+	return 0;
+}
+
+/**
+ * Make sure, that there's at least 'size' bytes of free space after top.
+ * Unread data is moved to the beginning of buffer, if there's not enough
+ * space. If buffer memory is referenced by replies, then unread data is
+ * moved to the new memory instead.
+ */
+int
+tnt_iob_reserve(struct tnt_iob *iob, size_t size)
+{
+	if (iob->off == iob->top && !tnt_iob_shared(iob)) {
+		iob->off = 0;
+		iob->top = 0;
+	}
+	if (iob->size - iob->top >= size)
+		return 0;
+	size_t used = iob->top - iob->off;
+	if (tnt_iob_shared(iob)) {
+		struct tnt_iob chunk;
+		if (tnt_iob_init(&chunk, iob->size, NULL, NULL, NULL,
+				 iob->mem, iob->stats) == -1 ||
+		    tnt_iob_share(&chunk) == -1 ||
+		    tnt_iob_grow(&chunk, used + size) == -1) {
+			tnt_iob_free(&chunk);
+			return -1;
+		}
+		memcpy(chunk.buf, iob->buf + iob->off, used);
+		tnt_iob_unref(iob->chunk);
+		iob->chunk = chunk.chunk;
+		iob->buf = chunk.buf;
+		iob->size = chunk.size;
+	} else if (iob->off > 0) {
+		memmove(iob->buf, iob->buf + iob->off, used);
+	}
+	iob->off = 0;
+	iob->top = used;
+	return tnt_iob_grow(iob, used + size);
+}
+
+/**
+ * Give back memory of drained buffer, that has grown beyond 'size'. Memory,
+ * that's referenced by replies, is left to them. Buffer is kept as is, if
+ * new memory can't be allocated.
+ */
+void
+tnt_iob_shrink(struct tnt_iob *iob, size_t size)
+{
+	if (iob->off != iob->top || iob->size <= size)
+		return;
+	if (tnt_iob_shared(iob)) {
+		struct tnt_iob chunk;
+		if (tnt_iob_init(&chunk, size, NULL, NULL, NULL,
+				 iob->mem, iob->stats) == -1 ||
+		    tnt_iob_share(&chunk) == -1) {
+			tnt_iob_free(&chunk);
+			return;
+		}
+		tnt_iob_unref(iob->chunk);
+		iob->chunk = chunk.chunk;
+		iob->buf = chunk.buf;
+	} else {
+		char *nbuf = tnt_mem_realloc_ex(iob->mem, iob->stats, iob->buf,
+						size, TNT_MEM_IOB);
+		if (nbuf == NULL)
+			return;
+		iob->buf = nbuf;
+		if (iob->chunk)
+			iob->chunk->buf = nbuf;
+	}
+	iob->size = size;
+	iob->off = 0;
+	iob->top = 0;
+}
+
+/**
+ * Make buffer memory reference counted, so replies may point into it.
+ */
+int
+tnt_iob_share(struct tnt_iob *iob)
+{
+	if (iob->chunk)
+		return 0;
+	iob->chunk = tnt_mem_alloc_ex(iob->mem, iob->stats,
+				      sizeof(struct tnt_iob_chunk), TNT_MEM_IOB);
+	if (iob->chunk == NULL)
+		return -1;
+	iob->chunk->refs = 1;
+	iob->chunk->buf = iob->buf;
+	return 0;
+}
+
+struct tnt_iob_chunk *
+tnt_iob_ref(struct tnt_iob *iob)
+{
+	pm_atomic_fetch_add(&iob->chunk->refs, 1);
+	return iob->chunk;
+}
+
+void
+tnt_iob_unref(void *ptr)
+{
+	struct tnt_iob_chunk *chunk = ptr;
+	if (pm_atomic_fetch_sub(&chunk->refs, 1) > 1)
+		return;
+	if (chunk->buf)
+		tnt_mem_free(chunk->buf);
+	tnt_mem_free(chunk);
+}
+
+int
+tnt_iovq_reserve(struct tnt_iovq *q, int count)
+{
+	if (q->size - q->count >= count)
+		return 0;
+	int nsize = (q->size > 0) ? q->size : 64;
+	while (nsize - q->count < count)
+		nsize *= 2;
+	struct iovec *niov = tnt_mem_realloc_ex(q->mem, q->stats, q->iov,
+					       nsize * sizeof(struct iovec),
+					       TNT_MEM_IOB);
+	if (niov == NULL)
+		return -1;
+	q->iov = niov;
+	q->size = nsize;
+	return 0;
+}
+
+void
+tnt_iovq_free(struct tnt_iovq *q)
+{
+	if (q->iov)
+		tnt_mem_free(q->iov);
+	q->iov = NULL;
+	q->count = 0;
+	q->size = 0;
 }
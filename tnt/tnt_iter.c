@@ -44,7 +44,7 @@
 static struct tnt_iter *tnt_iter_init(struct tnt_iter *i) {
 	int alloc = (i == NULL);
 	if (alloc) {
-		i = tnt_mem_alloc(sizeof(struct tnt_iter));
+		i = tnt_mem_alloc_tag(sizeof(struct tnt_iter), TNT_MEM_ITER);
 		if (i == NULL)
 			return NULL;
 	}
@@ -0,0 +1,278 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <msgpuck.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+
+#include "tnt_clock.h"
+#include "tnt_journal.h"
+
+/* enough for IPROTO header of request: size, code, sync, schema id */
+#define TNT_JOURNAL_HEAD 64
+
+struct tnt_journal *
+tnt_journal_new(struct tnt_mem_stats *stats)
+{
+	struct tnt_journal *j = tnt_mem_alloc_ex(NULL, stats,
+						 sizeof(struct tnt_journal),
+						 TNT_MEM_REQUEST);
+	if (j == NULL)
+		return NULL;
+	memset(j, 0, sizeof(struct tnt_journal));
+	j->stats = stats;
+	/* different processes must not reconnect in lockstep */
+	j->seed = (uint32_t)(tnt_clock_usec() ^ ((uint64_t)getpid() << 16) ^
+			     (uintptr_t)j);
+	if (j->seed == 0)
+		j->seed = 1;
+	return j;
+}
+
+void
+tnt_journal_clear(struct tnt_journal *j)
+{
+	for (uint32_t i = 0; i < j->count; i++)
+		tnt_mem_free(tnt_journal_entry(j, i)->data);
+	j->head = 0;
+	j->count = 0;
+	j->lost_head = 0;
+	j->lost_count = 0;
+}
+
+void
+tnt_journal_free(struct tnt_journal *j)
+{
+	if (j == NULL)
+		return;
+	tnt_journal_clear(j);
+	tnt_mem_free(j->entries);
+	tnt_mem_free(j->lost);
+	tnt_mem_free(j);
+}
+
+static int
+tnt_journal_reserve(struct tnt_journal *j)
+{
+	if (j->count < j->capacity)
+		return 0;
+	uint32_t capacity = j->capacity ? j->capacity * 2 : 64;
+	struct tnt_journal_entry *entries =
+		tnt_mem_alloc_ex(NULL, j->stats,
+				 capacity * sizeof(struct tnt_journal_entry),
+				 TNT_MEM_REQUEST);
+	if (entries == NULL)
+		return -1;
+	for (uint32_t i = 0; i < j->count; i++)
+		entries[i] = *tnt_journal_entry(j, i);
+	tnt_mem_free(j->entries);
+	j->entries = entries;
+	j->capacity = capacity;
+	j->head = 0;
+	return 0;
+}
+
+/* Check, that request code (from IPROTO header) is select or ping */
+static int
+tnt_journal_idempotent(const struct iovec *iov, int count)
+{
+	/* header is small, gather its beginning, if it's fragmented */
+	char head[TNT_JOURNAL_HEAD];
+	size_t size = 0;
+	for (int i = 0; i < count && size < sizeof(head); i++) {
+		size_t len = iov[i].iov_len;
+		if (len > sizeof(head) - size)
+			len = sizeof(head) - size;
+		memcpy(head + size, iov[i].iov_base, len);
+		size += len;
+	}
+	const char *p = head + 5, *end = head + size;
+	if (size <= 5 || mp_check(&p, end) != 0)
+		return 0;
+	p = head + 5;
+	if (mp_typeof(*p) != MP_MAP)
+		return 0;
+	uint32_t n = mp_decode_map(&p);
+	while (n-- > 0) {
+		if (mp_typeof(*p) != MP_UINT)
+			return 0;
+		uint64_t key = mp_decode_uint(&p);
+		if (key != TNT_CODE) {
+			mp_next(&p);
+			continue;
+		}
+		if (mp_typeof(*p) != MP_UINT)
+			return 0;
+		uint64_t code = mp_decode_uint(&p);
+		return code == TNT_OP_SELECT || code == TNT_OP_PING;
+	}
+	return 0;
+}
+
+int
+tnt_journal_add(struct tnt_journal *j, uint64_t sync,
+		const struct iovec *iov, int count)
+{
+	if (tnt_journal_reserve(j) == -1)
+		return -1;
+	size_t size = 0;
+	for (int i = 0; i < count; i++)
+		size += iov[i].iov_len;
+	char *data = NULL;
+	int idempotent = tnt_journal_idempotent(iov, count);
+	if (idempotent) {
+		data = tnt_mem_alloc_ex(NULL, j->stats, size, TNT_MEM_REQUEST);
+		if (data == NULL)
+			return -1;
+		size_t off = 0;
+		for (int i = 0; i < count; i++) {
+			memcpy(data + off, iov[i].iov_base, iov[i].iov_len);
+			off += iov[i].iov_len;
+		}
+	}
+	j->written += size;
+	struct tnt_journal_entry *e = tnt_journal_entry(j, j->count++);
+	e->sync = sync;
+	e->idempotent = idempotent;
+	e->done = 0;
+	e->size = size;
+	e->end = j->written;
+	e->data = data;
+	return 0;
+}
+
+int
+tnt_journal_keep(struct tnt_journal *j, struct tnt_journal_entry *e,
+		 const char *data)
+{
+	if (e->data == NULL) {
+		e->data = tnt_mem_alloc_ex(NULL, j->stats, e->size,
+					   TNT_MEM_REQUEST);
+		if (e->data == NULL)
+			return -1;
+		memcpy(e->data, data, e->size);
+	}
+	e->idempotent = 1;
+	return 0;
+}
+
+void
+tnt_journal_pop(struct tnt_journal *j)
+{
+	if (j->count == 0)
+		return;
+	struct tnt_journal_entry *e = tnt_journal_entry(j, --j->count);
+	j->written -= e->size;
+	tnt_mem_free(e->data);
+}
+
+struct tnt_journal_entry *
+tnt_journal_find(struct tnt_journal *j, uint64_t sync)
+{
+	uint32_t begin = 0, end = j->count;
+	while (begin < end) {
+		uint32_t mid = begin + (end - begin) / 2;
+		struct tnt_journal_entry *e = tnt_journal_entry(j, mid);
+		if (e->sync == sync)
+			return e;
+		if (e->sync < sync)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	return NULL;
+}
+
+void
+tnt_journal_compact(struct tnt_journal *j)
+{
+	while (j->count > 0 && tnt_journal_entry(j, 0)->done) {
+		j->head = (j->head + 1) % j->capacity;
+		j->count--;
+	}
+}
+
+void
+tnt_journal_done(struct tnt_journal *j, uint64_t sync)
+{
+	struct tnt_journal_entry *e = tnt_journal_find(j, sync);
+	if (e == NULL || e->done)
+		return;
+	e->done = 1;
+	tnt_mem_free(e->data);
+	e->data = NULL;
+	tnt_journal_compact(j);
+}
+
+int
+tnt_journal_lose(struct tnt_journal *j, uint64_t sync)
+{
+	if (j->lost_count == 0)
+		j->lost_head = 0;
+	uint32_t n = j->lost_head + j->lost_count;
+	/* lost array only grows, it's reused, when everything is reported */
+	uint64_t *lost = tnt_mem_realloc_ex(NULL, j->stats, j->lost,
+					    (n + 1) * sizeof(uint64_t),
+					    TNT_MEM_REQUEST);
+	if (lost == NULL)
+		return -1;
+	j->lost = lost;
+	j->lost[n] = sync;
+	j->lost_count++;
+	return 0;
+}
+
+void
+tnt_journal_backoff(struct tnt_journal *j, int attempt, int delay,
+		    int max_delay)
+{
+	uint64_t ms = (delay > 0) ? delay : 0;
+	for (int i = 0; i < attempt && ms < (uint64_t)max_delay; i++)
+		ms *= 2;
+	if (ms > (uint64_t)max_delay)
+		ms = max_delay;
+	/* equal jitter: sleep random time in [ms / 2, ms] */
+	j->seed ^= j->seed << 13;
+	j->seed ^= j->seed >> 17;
+	j->seed ^= j->seed << 5;
+	if (ms > 0)
+		ms = ms / 2 + j->seed % (ms - ms / 2 + 1);
+	struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		;
+}
@@ -0,0 +1,91 @@
+#ifndef TNT_JOURNAL_H_INCLUDED
+#define TNT_JOURNAL_H_INCLUDED
+
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct tnt_mem_stats;
+
+/*
+ * Journal of requests in flight, that is kept for reconnect. Entries are
+ * ordered by sync; idempotent requests are copied, so they may be replayed,
+ * only sync is kept for others. Syncs of requests, that were lost on
+ * reconnect, are queued to be reported by read_reply.
+ */
+
+struct tnt_journal_entry {
+	uint64_t sync;
+	int idempotent; /* request may be replayed */
+	int done; /* reply has been read */
+	size_t size;
+	uint64_t end; /* value of journal written after request */
+	char *data; /* copy of request (NULL, if it isn't idempotent) */
+};
+
+struct tnt_journal {
+	struct tnt_journal_entry *entries; /* ring */
+	uint32_t head; /* the oldest entry */
+	uint32_t count; /* count of entries in ring */
+	uint32_t capacity;
+	uint64_t *lost; /* syncs of lost requests */
+	uint32_t lost_head; /* the next lost sync to report */
+	uint32_t lost_count;
+	uint32_t seed; /* state of backoff jitter */
+	uint32_t reconnects; /* count of reconnects */
+	uint64_t written; /* total size of added requests */
+	struct tnt_mem_stats *stats; /* memory usage of stream */
+};
+
+struct tnt_journal *
+tnt_journal_new(struct tnt_mem_stats *stats);
+
+void
+tnt_journal_free(struct tnt_journal *j);
+
+/* Drop all entries and lost syncs */
+void
+tnt_journal_clear(struct tnt_journal *j);
+
+static inline struct tnt_journal_entry *
+tnt_journal_entry(struct tnt_journal *j, uint32_t n)
+{
+	return &j->entries[(j->head + n) % j->capacity];
+}
+
+/* Add request, copy it, if it's idempotent (select or ping) */
+int
+tnt_journal_add(struct tnt_journal *j, uint64_t sync,
+		const struct iovec *iov, int count);
+
+/* Copy request of entry (entry->size bytes) and mark it idempotent */
+int
+tnt_journal_keep(struct tnt_journal *j, struct tnt_journal_entry *e,
+		 const char *data);
+
+/* Remove the last added entry (request hasn't been written) */
+void
+tnt_journal_pop(struct tnt_journal *j);
+
+struct tnt_journal_entry *
+tnt_journal_find(struct tnt_journal *j, uint64_t sync);
+
+/* Mark request as completed and free it */
+void
+tnt_journal_done(struct tnt_journal *j, uint64_t sync);
+
+/* Free completed entries at the head of ring */
+void
+tnt_journal_compact(struct tnt_journal *j);
+
+/* Queue sync of lost request */
+int
+tnt_journal_lose(struct tnt_journal *j, uint64_t sync);
+
+/* Sleep before reconnect attempt: jittered exponential backoff */
+void
+tnt_journal_backoff(struct tnt_journal *j, int attempt, int delay,
+		    int max_delay);
+
+#endif /* TNT_JOURNAL_H_INCLUDED */
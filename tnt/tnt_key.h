@@ -0,0 +1,179 @@
+#ifndef TNT_KEY_H_INCLUDED
+#define TNT_KEY_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msgpuck.h>
+
+/* rank of msgpack type in tarantool's order of scalars */
+static inline int
+tnt_key_type_rank(enum mp_type type)
+{
+	switch (type) {
+	case MP_NIL:
+		return 0;
+	case MP_BOOL:
+		return 1;
+	case MP_UINT:
+	case MP_INT:
+	case MP_FLOAT:
+	case MP_DOUBLE:
+		return 2;
+	case MP_STR:
+		return 3;
+	case MP_BIN:
+		return 4;
+	default:
+		return 5;
+	}
+}
+
+/*
+ * Decode number. Integers are returned as sign and magnitude (in *neg and
+ * *u), floating point values - in *d (*neg is -1 then).
+ */
+static inline void
+tnt_key_number(const char **p, int *neg, uint64_t *u, double *d)
+{
+	switch (mp_typeof(**p)) {
+	case MP_UINT:
+		*neg = 0;
+		*u = mp_decode_uint(p);
+		*d = *u;
+		break;
+	case MP_INT: {
+		int64_t v = mp_decode_int(p);
+		*neg = (v < 0);
+		*u = (uint64_t )v;
+		*d = v;
+		break;
+	}
+	case MP_FLOAT:
+		*neg = -1;
+		*d = mp_decode_float(p);
+		break;
+	default:
+		*neg = -1;
+		*d = mp_decode_double(p);
+		break;
+	}
+}
+
+#define TNT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+static inline int
+tnt_key_compare_field(const char **a, const char **b)
+{
+	int ra = tnt_key_type_rank(mp_typeof(**a));
+	int rb = tnt_key_type_rank(mp_typeof(**b));
+	if (ra != rb) {
+		mp_next(a);
+		mp_next(b);
+		return TNT_CMP(ra, rb);
+	}
+	switch (ra) {
+	case 0:
+		mp_next(a);
+		mp_next(b);
+		return 0;
+	case 1: {
+		int va = mp_decode_bool(a), vb = mp_decode_bool(b);
+		return TNT_CMP(va, vb);
+	}
+	case 2: {
+		int na, nb;
+		uint64_t ua = 0, ub = 0;
+		double da, db;
+		tnt_key_number(a, &na, &ua, &da);
+		tnt_key_number(b, &nb, &ub, &db);
+		if (na == -1 || nb == -1)
+			return TNT_CMP(da, db);
+		if (na != nb)
+			return nb - na;
+		/* magnitudes of negative values are two's complement */
+		return TNT_CMP(ua, ub);
+	}
+	default: {
+		uint32_t la, lb;
+		const char *va, *vb;
+		if (ra == 3) {
+			va = mp_decode_str(a, &la);
+			vb = mp_decode_str(b, &lb);
+		} else if (ra == 4) {
+			va = mp_decode_bin(a, &la);
+			vb = mp_decode_bin(b, &lb);
+		} else {
+			va = *a;
+			vb = *b;
+			mp_next(a);
+			mp_next(b);
+			la = *a - va;
+			lb = *b - vb;
+		}
+		int rc = memcmp(va, vb, la < lb ? la : lb);
+		return rc != 0 ? rc : TNT_CMP(la, lb);
+	}
+	}
+}
+
+/*
+ * Compare keys (msgpack arrays) by their common parts.
+ */
+static inline int
+tnt_key_compare(const char *a, const char *b)
+{
+	uint32_t na = mp_decode_array(&a), nb = mp_decode_array(&b);
+	uint32_t n = (na < nb) ? na : nb;
+	for (uint32_t i = 0; i < n; i++) {
+		int rc = tnt_key_compare_field(&a, &b);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+/*
+ * Compare key parts, that are extracted with tnt_key_fields.
+ */
+static inline int
+tnt_key_compare_fields(const char **a, const char **b, uint32_t part_count)
+{
+	for (uint32_t i = 0; i < part_count; i++) {
+		const char *fa = a[i], *fb = b[i];
+		int rc = tnt_key_compare_field(&fa, &fb);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+/*
+ * Find key parts (0-based field numbers) of tuple. Missing fields are
+ * pointed to encoded nil.
+ */
+static inline void
+tnt_key_fields(const char *tuple, const uint32_t *parts, uint32_t part_count,
+	       const char **fields)
+{
+	static const char nil = (char )0xc0;
+	uint32_t i, found = 0;
+	for (i = 0; i < part_count; i++)
+		fields[i] = &nil;
+	uint32_t field_count = 0;
+	if (mp_typeof(*tuple) == MP_ARRAY)
+		field_count = mp_decode_array(&tuple);
+	for (uint32_t f = 0; f < field_count && found < part_count; f++) {
+		for (i = 0; i < part_count; i++) {
+			if (parts[i] == f) {
+				fields[i] = tuple;
+				found++;
+			}
+		}
+		mp_next(&tuple);
+	}
+}
+
+#undef TNT_CMP
+
+#endif /* TNT_KEY_H_INCLUDED */
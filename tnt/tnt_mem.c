@@ -31,9 +31,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include <tarantool/tnt_mem.h>
 
+#include "pmatomic.h"
+
 static void *custom_realloc(void *ptr, size_t size) {
 	if (!ptr) {
 		if (!size)
@@ -60,12 +63,164 @@ void *tnt_mem_init(tnt_allocator_t alloc) {
 	return ptr;
 }
 
+/*
+ * Every block starts with a header, that remembers its context, owner,
+ * size and category. It's 32 bytes long on 64-bit platforms (16 bytes on
+ * 32-bit ones), so alignment of block is kept.
+ */
+struct tnt_mem_hdr {
+	struct tnt_mem_ctx *ctx;
+	struct tnt_mem_stats *stats;
+	size_t size;
+	uint32_t tag;
+};
+
+struct tnt_mem_page {
+	struct tnt_mem_page *next;
+	size_t size;
+};
+
+#define TNT_MEM_ALIGN 16
+#define TNT_MEM_ROUND(size) \
+	(((size) + TNT_MEM_ALIGN - 1) & ~((size_t)TNT_MEM_ALIGN - 1))
+#define TNT_MEM_HDR TNT_MEM_ROUND(sizeof(struct tnt_mem_hdr))
+
+#define tnt_mem_hdr(ptr) ((struct tnt_mem_hdr *)((char *)(ptr) - TNT_MEM_HDR))
+
+/* process-wide usage */
+static struct tnt_mem_stat tnt_mem_global[TNT_MEM_TAG_MAX];
+
+static inline void
+tnt_mem_stat_add(struct tnt_mem_stat *st, size_t size)
+{
+	size_t live = pm_atomic_fetch_add_explicit(&st->live, size,
+			pm_memory_order_relaxed) + size;
+	pm_atomic_fetch_add_explicit(&st->count, 1, pm_memory_order_relaxed);
+	pm_atomic_fetch_add_explicit(&st->allocs, 1, pm_memory_order_relaxed);
+	size_t peak = pm_atomic_load_explicit(&st->peak,
+					      pm_memory_order_relaxed);
+	while (live > peak && !pm_atomic_compare_exchange_weak_explicit(
+			&st->peak, &peak, live, pm_memory_order_relaxed,
+			pm_memory_order_relaxed));
+}
+
+static inline void
+tnt_mem_stat_sub(struct tnt_mem_stat *st, size_t size)
+{
+	pm_atomic_fetch_sub_explicit(&st->live, size, pm_memory_order_relaxed);
+	pm_atomic_fetch_sub_explicit(&st->count, 1, pm_memory_order_relaxed);
+}
+
+static void
+tnt_mem_account(struct tnt_mem_hdr *hdr)
+{
+	tnt_mem_stat_add(&tnt_mem_global[hdr->tag], hdr->size);
+	if (hdr->stats != NULL) {
+		pm_atomic_fetch_add(&hdr->stats->refs, 1);
+		tnt_mem_stat_add(&hdr->stats->tag[hdr->tag], hdr->size);
+	}
+}
+
+static void
+tnt_mem_unaccount(struct tnt_mem_hdr *hdr)
+{
+	tnt_mem_stat_sub(&tnt_mem_global[hdr->tag], hdr->size);
+	if (hdr->stats != NULL) {
+		tnt_mem_stat_sub(&hdr->stats->tag[hdr->tag], hdr->size);
+		tnt_mem_stats_unref(hdr->stats);
+	}
+}
+
+void tnt_mem_usage(struct tnt_mem_stat *stat) {
+	for (int i = 0; i < TNT_MEM_TAG_MAX; ++i) {
+		struct tnt_mem_stat *st = &tnt_mem_global[i];
+		stat[i].live = pm_atomic_load(&st->live);
+		stat[i].peak = pm_atomic_load(&st->peak);
+		stat[i].count = pm_atomic_load(&st->count);
+		stat[i].allocs = pm_atomic_load(&st->allocs);
+	}
+}
+
+struct tnt_mem_stats *tnt_mem_stats_new(void) {
+	struct tnt_mem_stats *stats = _tnt_realloc(NULL,
+						   sizeof(struct tnt_mem_stats));
+	if (stats == NULL)
+		return NULL;
+	memset(stats, 0, sizeof(struct tnt_mem_stats));
+	stats->refs = 1;
+	return stats;
+}
+
+void tnt_mem_stats_unref(struct tnt_mem_stats *stats) {
+	if (stats != NULL && pm_atomic_fetch_sub(&stats->refs, 1) == 1)
+		_tnt_realloc(stats, 0);
+}
+
+void *tnt_mem_alloc_ex(struct tnt_mem_ctx *ctx, struct tnt_mem_stats *stats,
+		       size_t size, enum tnt_mem_tag tag) {
+	size_t total = size + TNT_MEM_HDR;
+	struct tnt_mem_hdr *hdr = (ctx != NULL) ?
+		ctx->alloc(ctx, total) : _tnt_realloc(NULL, total);
+	if (hdr == NULL)
+		return NULL;
+	hdr->ctx = ctx;
+	hdr->stats = stats;
+	hdr->size = total;
+	hdr->tag = tag;
+	tnt_mem_account(hdr);
+	return (char *)hdr + TNT_MEM_HDR;
+}
+
+void *tnt_mem_realloc_ex(struct tnt_mem_ctx *ctx, struct tnt_mem_stats *stats,
+			 void *ptr, size_t size, enum tnt_mem_tag tag) {
+	if (ptr == NULL)
+		return size ? tnt_mem_alloc_ex(ctx, stats, size, tag) : NULL;
+	if (size == 0) {
+		tnt_mem_free(ptr);
+		return NULL;
+	}
+	struct tnt_mem_hdr *hdr = tnt_mem_hdr(ptr);
+	size_t old = hdr->size - TNT_MEM_HDR;
+	if (hdr->ctx == NULL) {
+		struct tnt_mem_hdr copy = *hdr;
+		struct tnt_mem_hdr *nhdr = _tnt_realloc(hdr, size + TNT_MEM_HDR);
+		if (nhdr == NULL)
+			return NULL;
+		tnt_mem_stat_sub(&tnt_mem_global[copy.tag], copy.size);
+		tnt_mem_stat_add(&tnt_mem_global[copy.tag], size + TNT_MEM_HDR);
+		if (copy.stats != NULL) {
+			tnt_mem_stat_sub(&copy.stats->tag[copy.tag], copy.size);
+			tnt_mem_stat_add(&copy.stats->tag[copy.tag],
+					 size + TNT_MEM_HDR);
+		}
+		nhdr->size = size + TNT_MEM_HDR;
+		return (char *)nhdr + TNT_MEM_HDR;
+	}
+	/* context blocks, that are big enough, aren't moved */
+	if (size <= old)
+		return ptr;
+	char *nptr = tnt_mem_alloc_ex(hdr->ctx, hdr->stats, size, hdr->tag);
+	if (nptr == NULL)
+		return NULL;
+	memcpy(nptr, ptr, old);
+	tnt_mem_free(ptr);
+	return nptr;
+}
+
 void *tnt_mem_alloc(size_t size) {
-	return _tnt_realloc(NULL, size);
+	return tnt_mem_alloc_ex(NULL, NULL, size, TNT_MEM_OTHER);
+}
+
+void *tnt_mem_alloc_tag(size_t size, enum tnt_mem_tag tag) {
+	return tnt_mem_alloc_ex(NULL, NULL, size, tag);
 }
 
 void *tnt_mem_realloc(void *ptr, size_t size) {
-	return _tnt_realloc(ptr, size);
+	return tnt_mem_realloc_ex(NULL, NULL, ptr, size, TNT_MEM_OTHER);
+}
+
+void *tnt_mem_realloc_tag(void *ptr, size_t size, enum tnt_mem_tag tag) {
+	return tnt_mem_realloc_ex(NULL, NULL, ptr, size, tag);
 }
 
 char *tnt_mem_dup(char *sz) {
@@ -78,5 +233,178 @@ char *tnt_mem_dup(char *sz) {
 }
 
 void tnt_mem_free(void *ptr) {
-	_tnt_realloc(ptr, 0);
+	if (ptr == NULL)
+		return;
+	struct tnt_mem_hdr *hdr = tnt_mem_hdr(ptr);
+	tnt_mem_unaccount(hdr);
+	if (hdr->ctx != NULL)
+		hdr->ctx->free(hdr->ctx, hdr, hdr->size);
+	else
+		_tnt_realloc(hdr, 0);
+}
+
+void *tnt_mem_ctx_alloc(struct tnt_mem_ctx *ctx, size_t size) {
+	return tnt_mem_alloc_ex(ctx, NULL, size, TNT_MEM_OTHER);
+}
+
+void tnt_mem_ctx_free(void *ptr) {
+	tnt_mem_free(ptr);
+}
+
+void *tnt_mem_ctx_realloc(struct tnt_mem_ctx *ctx, void *ptr, size_t size) {
+	return tnt_mem_realloc_ex(ctx, NULL, ptr, size, TNT_MEM_OTHER);
+}
+
+static inline int
+tnt_mem_slab_class(size_t size) {
+	int cls = 0;
+	size_t csize = TNT_MEM_ALIGN;
+	while (csize < size) {
+		csize <<= 1;
+		cls++;
+	}
+	return cls;
+}
+
+static void *
+tnt_mem_slab_alloc(struct tnt_mem_ctx *ctx, size_t size) {
+	struct tnt_mem_slab *slab = (struct tnt_mem_slab *)ctx;
+	int cls = tnt_mem_slab_class(size);
+	if (cls >= TNT_SLAB_CLASSES)
+		return _tnt_realloc(NULL, size);
+	size_t csize = (size_t)TNT_MEM_ALIGN << cls;
+	void *ptr = slab->free_list[cls];
+	if (ptr != NULL) {
+		slab->free_list[cls] = *(void **)ptr;
+	} else {
+		struct tnt_mem_page *page = slab->pages;
+		if (page == NULL || page->size - slab->page_used < csize) {
+			/* the rest of the last page is wasted */
+			page = _tnt_realloc(NULL, TNT_SLAB_PAGE);
+			if (page == NULL)
+				return NULL;
+			page->next = slab->pages;
+			page->size = TNT_SLAB_PAGE;
+			slab->pages = page;
+			slab->page_used = TNT_MEM_ROUND(sizeof(*page));
+		}
+		ptr = (char *)page + slab->page_used;
+		slab->page_used += csize;
+	}
+	slab->used += csize;
+	return ptr;
+}
+
+static void
+tnt_mem_slab_release(struct tnt_mem_ctx *ctx, void *ptr, size_t size) {
+	struct tnt_mem_slab *slab = (struct tnt_mem_slab *)ctx;
+	int cls = tnt_mem_slab_class(size);
+	if (cls >= TNT_SLAB_CLASSES) {
+		_tnt_realloc(ptr, 0);
+		return;
+	}
+	*(void **)ptr = slab->free_list[cls];
+	slab->free_list[cls] = ptr;
+	slab->used -= (size_t)TNT_MEM_ALIGN << cls;
+}
+
+struct tnt_mem_slab *tnt_mem_slab(struct tnt_mem_slab *slab) {
+	int alloc = (slab == NULL);
+	if (alloc) {
+		slab = _tnt_realloc(NULL, sizeof(struct tnt_mem_slab));
+		if (slab == NULL)
+			return NULL;
+	}
+	memset(slab, 0, sizeof(struct tnt_mem_slab));
+	slab->base.alloc = tnt_mem_slab_alloc;
+	slab->base.free = tnt_mem_slab_release;
+	slab->alloc = alloc;
+	return slab;
+}
+
+static void
+tnt_mem_pages_free(struct tnt_mem_page *page) {
+	while (page != NULL) {
+		struct tnt_mem_page *next = page->next;
+		_tnt_realloc(page, 0);
+		page = next;
+	}
+}
+
+void tnt_mem_slab_free(struct tnt_mem_slab *slab) {
+	if (slab == NULL)
+		return;
+	tnt_mem_pages_free(slab->pages);
+	if (slab->alloc)
+		_tnt_realloc(slab, 0);
+}
+
+static void *
+tnt_mem_arena_alloc(struct tnt_mem_ctx *ctx, size_t size) {
+	struct tnt_mem_arena *arena = (struct tnt_mem_arena *)ctx;
+	size = TNT_MEM_ROUND(size);
+	struct tnt_mem_page *chunk = arena->chunks;
+	if (chunk == NULL || chunk->size - arena->chunk_used < size) {
+		size_t hdr = TNT_MEM_ROUND(sizeof(*chunk));
+		size_t csize = arena->chunk_size;
+		if (csize < hdr + size)
+			csize = hdr + size;
+		chunk = _tnt_realloc(NULL, csize);
+		if (chunk == NULL)
+			return NULL;
+		chunk->next = arena->chunks;
+		chunk->size = csize;
+		arena->chunks = chunk;
+		arena->chunk_used = hdr;
+	}
+	void *ptr = (char *)chunk + arena->chunk_used;
+	arena->chunk_used += size;
+	arena->used += size;
+	return ptr;
+}
+
+static void
+tnt_mem_arena_release(struct tnt_mem_ctx *ctx, void *ptr, size_t size) {
+	struct tnt_mem_arena *arena = (struct tnt_mem_arena *)ctx;
+	size = TNT_MEM_ROUND(size);
+	struct tnt_mem_page *chunk = arena->chunks;
+	/* only the last block is given back */
+	if ((char *)ptr + size == (char *)chunk + arena->chunk_used) {
+		arena->chunk_used -= size;
+		arena->used -= size;
+	}
+}
+
+struct tnt_mem_arena *tnt_mem_arena(struct tnt_mem_arena *arena,
+				    size_t chunk) {
+	int alloc = (arena == NULL);
+	if (alloc) {
+		arena = _tnt_realloc(NULL, sizeof(struct tnt_mem_arena));
+		if (arena == NULL)
+			return NULL;
+	}
+	memset(arena, 0, sizeof(struct tnt_mem_arena));
+	arena->base.alloc = tnt_mem_arena_alloc;
+	arena->base.free = tnt_mem_arena_release;
+	arena->chunk_size = chunk ? chunk : 64 * 1024;
+	arena->alloc = alloc;
+	return arena;
+}
+
+void tnt_mem_arena_reset(struct tnt_mem_arena *arena) {
+	struct tnt_mem_page *chunk = arena->chunks;
+	if (chunk == NULL)
+		return;
+	tnt_mem_pages_free(chunk->next);
+	chunk->next = NULL;
+	arena->chunk_used = TNT_MEM_ROUND(sizeof(*chunk));
+	arena->used = 0;
+}
+
+void tnt_mem_arena_free(struct tnt_mem_arena *arena) {
+	if (arena == NULL)
+		return;
+	tnt_mem_pages_free(arena->chunks);
+	if (arena->alloc)
+		_tnt_realloc(arena, 0);
 }
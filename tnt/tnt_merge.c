@@ -0,0 +1,506 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <msgpuck.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_buf.h>
+#include <tarantool/tnt_object.h>
+#include <tarantool/tnt_select.h>
+#include <tarantool/tnt_schema.h>
+#include <tarantool/tnt_iter.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_merge.h>
+
+#include "pmatomic.h"
+#include "tnt_key.h"
+
+/* default count of tuples per page of stream */
+#define TNT_MERGE_PAGE 1000
+
+/* paging state of stream */
+struct tnt_merge_src {
+	struct tnt_stream *key; /* key of the last tuple of current page */
+	uint64_t fetched; /* count of tuples, that stream has returned */
+	uint32_t dup; /* count of fetched tuples with key equal to 'key' */
+	int eof; /* 1 if the last page is received */
+};
+
+struct tnt_merge *
+tnt_merge(struct tnt_merge *m, struct tnt_stream **streams, uint32_t count)
+{
+	if (count == 0)
+		return NULL;
+	int alloc = (m == NULL);
+	if (alloc) {
+		m = tnt_mem_alloc_tag(sizeof(struct tnt_merge), TNT_MEM_ITER);
+		if (m == NULL)
+			return NULL;
+	}
+	memset(m, 0, sizeof(struct tnt_merge));
+	m->alloc = alloc;
+	m->streams = streams;
+	m->page = TNT_MERGE_PAGE;
+	m->replies = tnt_mem_alloc_tag(count * sizeof(struct tnt_reply),
+				       TNT_MEM_ITER);
+	m->iters = tnt_mem_alloc_tag(count * sizeof(struct tnt_iter),
+				     TNT_MEM_ITER);
+	m->srcs = tnt_mem_alloc_tag(count * sizeof(struct tnt_merge_src),
+				    TNT_MEM_ITER);
+	m->heap = tnt_mem_alloc_tag(count * sizeof(uint32_t), TNT_MEM_ITER);
+	if (m->replies == NULL || m->iters == NULL || m->srcs == NULL ||
+	    m->heap == NULL) {
+		tnt_merge_free(m);
+		return NULL;
+	}
+	memset(m->srcs, 0, count * sizeof(struct tnt_merge_src));
+	for (; m->count < count; m->count++)
+		tnt_reply_init(&m->replies[m->count]);
+	m->refill = m->count;
+	return m;
+}
+
+void
+tnt_merge_page(struct tnt_merge *m, uint32_t page)
+{
+	m->page = (page > 0) ? page : 1;
+}
+
+/*
+ * Key parts of current tuple of stream n. Slot m->count is scratch for
+ * page processing.
+ */
+static inline const char **
+tnt_merge_fields(struct tnt_merge *m, uint32_t n)
+{
+	return m->fields + (size_t )n * m->part_count;
+}
+
+/*
+ * Order of streams by their current tuples, ties are broken by stream
+ * number to keep merge stable.
+ */
+static inline int
+tnt_merge_less(struct tnt_merge *m, uint32_t a, uint32_t b)
+{
+	int rc = tnt_key_compare_fields(tnt_merge_fields(m, a),
+					tnt_merge_fields(m, b), m->part_count);
+	if (m->reverse)
+		rc = -rc;
+	return rc != 0 ? rc < 0 : a < b;
+}
+
+static void
+tnt_merge_sift_down(struct tnt_merge *m, uint32_t pos)
+{
+	uint32_t *heap = m->heap;
+	for (;;) {
+		uint32_t least = pos, l = 2 * pos + 1, r = l + 1;
+		if (l < m->heap_size && tnt_merge_less(m, heap[l], heap[least]))
+			least = l;
+		if (r < m->heap_size && tnt_merge_less(m, heap[r], heap[least]))
+			least = r;
+		if (least == pos)
+			return;
+		uint32_t tmp = heap[pos];
+		heap[pos] = heap[least];
+		heap[least] = tmp;
+		pos = least;
+	}
+}
+
+static void
+tnt_merge_sift_up(struct tnt_merge *m, uint32_t pos)
+{
+	uint32_t *heap = m->heap;
+	while (pos > 0) {
+		uint32_t parent = (pos - 1) / 2;
+		if (!tnt_merge_less(m, heap[pos], heap[parent]))
+			return;
+		uint32_t tmp = heap[pos];
+		heap[pos] = heap[parent];
+		heap[parent] = tmp;
+		pos = parent;
+	}
+}
+
+/*
+ * Compare key parts with key, that's shorter or has the same length.
+ */
+static int
+tnt_merge_key_equal(struct tnt_merge *m, struct tnt_stream *key,
+		    const char **fields)
+{
+	if (key == NULL || TNT_SBUF_SIZE(key) == 0)
+		return 1;
+	const char *data = TNT_SBUF_DATA(key);
+	uint32_t count = mp_decode_array(&data);
+	for (uint32_t i = 0; i < count && i < m->part_count; i++) {
+		const char *field = fields[i];
+		if (tnt_key_compare_field(&data, &field) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Advance iterator of stream n and extract key parts of its new tuple.
+ * Pages after the first one aren't bounded by EQ and REQ key, so stream
+ * ends at the first tuple past it.
+ */
+static inline int
+tnt_merge_advance(struct tnt_merge *m, uint32_t n)
+{
+	if (!tnt_next(&m->iters[n]))
+		return 0;
+	const char **fields = tnt_merge_fields(m, n);
+	tnt_key_fields(TNT_IARRAY_ELEM(&m->iters[n]), m->parts, m->part_count,
+		       fields);
+	if ((m->iterator == TNT_ITER_EQ || m->iterator == TNT_ITER_REQ) &&
+	    !tnt_merge_key_equal(m, m->key, fields)) {
+		m->srcs[n].eof = 1;
+		return 0;
+	}
+	return 1;
+}
+
+/* count of tuples to request from stream n */
+static inline uint32_t
+tnt_merge_limit(struct tnt_merge *m, uint32_t n)
+{
+	uint64_t left = m->window - m->srcs[n].fetched;
+	return left < m->page ? left : m->page;
+}
+
+/*
+ * Start iterator over page of stream n, remember key of its last tuple and
+ * count of tuples with that key, which the next page skips (like
+ * tnt_cursor does for non-unique index).
+ */
+static int
+tnt_merge_receive(struct tnt_merge *m, uint32_t n, uint32_t limit)
+{
+	struct tnt_merge_src *src = &m->srcs[n];
+	struct tnt_reply *r = &m->replies[n];
+	if (r->data == NULL ||
+	    tnt_iter_array(&m->iters[n], r->data,
+			   r->data_end - r->data) == NULL) {
+		/* tuples are checked by reply parser */
+		src->eof = 1;
+		return 0;
+	}
+	const char *tuple = r->data;
+	uint32_t count = mp_decode_array(&tuple);
+	int first = (src->fetched == 0);
+	src->fetched += count;
+	if (count < limit || src->fetched >= m->window) {
+		src->eof = 1;
+		return 0;
+	}
+	const char **last = tnt_merge_fields(m, n);
+	const char **cur = tnt_merge_fields(m, m->count);
+	uint32_t run = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		tnt_key_fields(tuple, m->parts, m->part_count, cur);
+		if (!m->unique && i > 0 &&
+		    tnt_key_compare_fields(cur, last, m->part_count) == 0)
+			run++;
+		else
+			run = 1;
+		const char **tmp = last;
+		last = cur;
+		cur = tmp;
+		mp_next(&tuple);
+	}
+	if (!m->unique)
+		src->dup = (run == count && !first &&
+			    tnt_merge_key_equal(m, src->key, last)) ?
+			   src->dup + run : run;
+	if (src->key == NULL && (src->key = tnt_object(NULL)) == NULL)
+		goto oom;
+	tnt_object_reset(src->key);
+	if (tnt_object_add_array(src->key, m->part_count) == -1)
+		goto oom;
+	for (uint32_t i = 0; i < m->part_count; i++) {
+		const char *end = last[i];
+		mp_next(&end);
+		if (src->key->write(src->key, last[i], end - last[i]) == -1)
+			goto oom;
+	}
+	tnt_object_container_close(src->key);
+	return 0;
+oom:
+	TNT_SNET_CAST(m->streams[n])->error = TNT_EMEMORY;
+	return -1;
+}
+
+/*
+ * Request the next page of stream n, that continues after the key of its
+ * last tuple, and put stream back into heap.
+ */
+static int
+tnt_merge_fetch(struct tnt_merge *m, uint32_t n)
+{
+	struct tnt_stream *s = m->streams[n];
+	struct tnt_merge_src *src = &m->srcs[n];
+	if (pm_atomic_load(&s->wrcnt) != 0) {
+		TNT_SNET_CAST(s)->error = TNT_EBADVAL;
+		return -1;
+	}
+	int iterator = m->reverse ?
+		       (m->unique ? TNT_ITER_LT : TNT_ITER_LE) :
+		       (m->unique ? TNT_ITER_GT : TNT_ITER_GE);
+	uint32_t limit = tnt_merge_limit(m, n);
+	tnt_reply_free(&m->replies[n]);
+	tnt_reply_init(&m->replies[n]);
+	if (tnt_select(s, m->space, m->index, limit, src->dup, iterator,
+		       src->key) == -1 || tnt_flush(s) == -1 ||
+	    s->read_reply(s, &m->replies[n]) != 0) {
+		if (pm_atomic_load(&s->wrcnt) != 0)
+			tnt_net_drain(s);
+		return -1;
+	}
+	if (m->replies[n].error != NULL ||
+	    tnt_merge_receive(m, n, limit) == -1)
+		return -1;
+	if (tnt_merge_advance(m, n)) {
+		m->heap[m->heap_size++] = n;
+		tnt_merge_sift_up(m, m->heap_size - 1);
+	}
+	return 0;
+}
+
+static int
+tnt_merge_pop(struct tnt_merge *m, const char **tuple, size_t *size)
+{
+	/* page is replaced after its last tuple was handed out */
+	if (m->refill < m->count) {
+		uint32_t n = m->refill;
+		m->refill = m->count;
+		if (tnt_merge_fetch(m, n) == -1)
+			return -1;
+	}
+	if (m->heap_size == 0)
+		return 0;
+	uint32_t n = m->heap[0];
+	struct tnt_iter *it = &m->iters[n];
+	*tuple = TNT_IARRAY_ELEM(it);
+	*size = TNT_IARRAY_ELEM_END(it) - TNT_IARRAY_ELEM(it);
+	if (!tnt_merge_advance(m, n)) {
+		m->heap[0] = m->heap[--m->heap_size];
+		if (!m->srcs[n].eof)
+			m->refill = n;
+	}
+	tnt_merge_sift_down(m, 0);
+	return 1;
+}
+
+/*
+ * Send select for the first page to every stream and read replies.
+ */
+static int
+tnt_merge_scatter(struct tnt_merge *m, uint32_t limit, struct tnt_stream *key)
+{
+	uint32_t n;
+	for (n = 0; n < m->count; n++) {
+		struct tnt_stream *s = m->streams[n];
+		struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+		if (sn->nonblock || sn->uring != NULL ||
+		    pm_atomic_load(&s->wrcnt) != 0) {
+			sn->error = TNT_EBADVAL;
+			return -1;
+		}
+	}
+	for (n = 0; n < m->count; n++) {
+		struct tnt_stream *s = m->streams[n];
+		if (tnt_select(s, m->space, m->index, limit, 0, m->iterator,
+			       key) == -1)
+			goto error;
+	}
+	for (n = 0; n < m->count; n++)
+		if (tnt_flush(m->streams[n]) == -1)
+			goto error;
+	int rc = 0;
+	for (n = 0; n < m->count; n++) {
+		struct tnt_stream *s = m->streams[n];
+		/* read every reply, so that streams stay in sync */
+		if (s->read_reply(s, &m->replies[n]) != 0)
+			goto error;
+		if (m->replies[n].error != NULL)
+			rc = -1;
+	}
+	return rc;
+error:
+	/* requests in flight would fail the next select */
+	for (n = 0; n < m->count; n++)
+		if (pm_atomic_load(&m->streams[n]->wrcnt) != 0)
+			tnt_net_drain(m->streams[n]);
+	return -1;
+}
+
+int
+tnt_merge_select(struct tnt_merge *m, uint32_t space, uint32_t index,
+		 uint32_t limit, uint32_t offset, int iterator,
+		 struct tnt_stream *key)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(m->streams[0]);
+	uint32_t n;
+	for (n = 0; n < m->count; n++) {
+		tnt_reply_free(&m->replies[n]);
+		tnt_reply_init(&m->replies[n]);
+		m->srcs[n].fetched = 0;
+		m->srcs[n].dup = 0;
+		m->srcs[n].eof = 0;
+	}
+	m->heap_size = 0;
+	m->left = 0;
+	m->refill = m->count;
+	switch (iterator) {
+	case TNT_ITER_EQ:
+	case TNT_ITER_ALL:
+	case TNT_ITER_GE:
+	case TNT_ITER_GT:
+		m->reverse = 0;
+		break;
+	case TNT_ITER_REQ:
+	case TNT_ITER_LT:
+	case TNT_ITER_LE:
+		m->reverse = 1;
+		break;
+	default:
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	const struct tnt_schema_ival *def =
+		tnt_schema_index(tnt_net_schema(m->streams[0]), space, index);
+	if (def == NULL || def->part_count == 0) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	if (m->part_count != def->part_count) {
+		tnt_mem_free(m->parts);
+		tnt_mem_free(m->fields);
+		m->fields = NULL;
+		m->part_count = 0;
+		m->parts = tnt_mem_alloc_tag(def->part_count * sizeof(uint32_t),
+					     TNT_MEM_ITER);
+		if (m->parts == NULL)
+			goto oom;
+		m->fields = tnt_mem_alloc_tag((size_t )(m->count + 1) *
+					      def->part_count *
+					      sizeof(const char *),
+					      TNT_MEM_ITER);
+		if (m->fields == NULL)
+			goto oom;
+		m->part_count = def->part_count;
+	}
+	memcpy(m->parts, def->parts, m->part_count * sizeof(uint32_t));
+	m->space = space;
+	m->index = index;
+	m->iterator = iterator;
+	m->unique = def->unique || index == 0;
+	/* pages after the first one are checked against EQ and REQ key */
+	if (m->key == NULL && (m->key = tnt_object(NULL)) == NULL)
+		goto oom;
+	tnt_object_reset(m->key);
+	if (key != NULL && (iterator == TNT_ITER_EQ ||
+			    iterator == TNT_ITER_REQ) &&
+	    m->key->write(m->key, TNT_SBUF_DATA(key),
+			  TNT_SBUF_SIZE(key)) == -1)
+		goto oom;
+	/* every stream may contribute the whole window */
+	m->window = (uint64_t )offset + limit;
+	uint32_t page = tnt_merge_limit(m, 0);
+	if (tnt_merge_scatter(m, page, key) == -1)
+		return -1;
+	for (n = 0; n < m->count; n++) {
+		if (tnt_merge_receive(m, n, page) == -1)
+			return -1;
+		if (tnt_merge_advance(m, n))
+			m->heap[m->heap_size++] = n;
+	}
+	for (n = m->heap_size / 2; n > 0; n--)
+		tnt_merge_sift_down(m, n - 1);
+	const char *tuple;
+	size_t size;
+	int rc = 1;
+	while (offset > 0 && (rc = tnt_merge_pop(m, &tuple, &size)) == 1)
+		offset--;
+	if (rc == -1)
+		return -1;
+	m->left = limit;
+	return 0;
+oom:
+	sn->error = TNT_EMEMORY;
+	return -1;
+}
+
+int
+tnt_merge_next(struct tnt_merge *m, const char **tuple, size_t *size)
+{
+	if (m->left == 0)
+		return 0;
+	int rc = tnt_merge_pop(m, tuple, size);
+	if (rc != 1) {
+		m->left = 0;
+		return rc;
+	}
+	m->left--;
+	return 1;
+}
+
+void
+tnt_merge_free(struct tnt_merge *m)
+{
+	if (m == NULL)
+		return;
+	for (uint32_t n = 0; n < m->count; n++) {
+		tnt_reply_free(&m->replies[n]);
+		if (m->srcs != NULL && m->srcs[n].key != NULL)
+			tnt_stream_free(m->srcs[n].key);
+	}
+	if (m->key)
+		tnt_stream_free(m->key);
+	tnt_mem_free(m->replies);
+	tnt_mem_free(m->iters);
+	tnt_mem_free(m->srcs);
+	tnt_mem_free(m->heap);
+	tnt_mem_free(m->parts);
+	tnt_mem_free(m->fields);
+	if (m->alloc)
+		tnt_mem_free(m);
+}
@@ -51,18 +51,35 @@
 
 #include <tarantool/tnt_net.h>
 #include <tarantool/tnt_io.h>
+#include <tarantool/tnt_async.h>
+#include <tarantool/tnt_uring.h>
+#include <tarantool/tnt_stmt.h>
 
 #include "pmatomic.h"
+#include "tnt_assoc.h"
+#include "tnt_clock.h"
+#include "tnt_journal.h"
+#include "tnt_rpool.h"
 
 static void tnt_net_free(struct tnt_stream *s) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	tnt_uring_detach(s);
 	tnt_io_close(sn);
+	tnt_async_fail(s, TNT_EFAIL);
+	tnt_async_free(s);
+	tnt_stmt_cache_clear(s);
+	if (sn->stmts)
+		mh_assoc_delete(sn->stmts);
 	tnt_mem_free(sn->greeting);
 	tnt_iob_free(&sn->sbuf);
 	tnt_iob_free(&sn->rbuf);
+	tnt_iovq_free(&sn->sendq);
 	tnt_opt_free(&sn->opt);
-	tnt_schema_free(sn->schema);
-	tnt_mem_free(sn->schema);
+	tnt_schema_unref(sn->schema);
+	tnt_journal_free(sn->journal);
+	tnt_rpool_free(sn->rpool);
+	/* replies, that are still in use, hold their references */
+	tnt_mem_stats_unref(sn->stats);
 	tnt_mem_free(s->data);
 	s->data = NULL;
 }
@@ -74,38 +91,211 @@ tnt_net_read(struct tnt_stream *s, char *buf, size_t size) {
 	return tnt_io_recv(sn, buf, size);
 }
 
+/* remember submission time of the request, that has just been written */
+static void
+tnt_rtt_submit(struct tnt_stream *s) {
+	struct tnt_rtt *rtt = &TNT_SNET_CAST(s)->rtt;
+	uint64_t sync = s->reqid - 1;
+	rtt->sync[sync % TNT_RTT_SLOTS] = sync;
+	rtt->sent[sync % TNT_RTT_SLOTS] = tnt_clock_usec();
+}
+
+static void
+tnt_rtt_reply(struct tnt_stream *s, uint64_t sync) {
+	struct tnt_rtt *rtt = &TNT_SNET_CAST(s)->rtt;
+	uint32_t slot = sync % TNT_RTT_SLOTS;
+	if (rtt->sent[slot] == 0 || rtt->sync[slot] != sync)
+		return;
+	uint64_t usec = tnt_clock_usec() - rtt->sent[slot];
+	rtt->sent[slot] = 0;
+	rtt->last = (usec > UINT32_MAX) ? UINT32_MAX : usec;
+	if (rtt->srtt == 0)
+		rtt->srtt = (uint64_t)rtt->last << 3;
+	else
+		rtt->srtt = rtt->srtt - (rtt->srtt >> 3) + rtt->last;
+	if (rtt->srtt == 0)
+		rtt->srtt = 1;
+}
+
+uint32_t
+tnt_rtt(struct tnt_stream *s) {
+	return TNT_SNET_CAST(s)->rtt.srtt >> 3;
+}
+
+void
+tnt_stream_mem(struct tnt_stream *s, struct tnt_mem_stat *stat) {
+	struct tnt_mem_stats *stats = TNT_SNET_CAST(s)->stats;
+	for (int i = 0; i < TNT_MEM_TAG_MAX; ++i) {
+		struct tnt_mem_stat *st = &stats->tag[i];
+		stat[i].live = pm_atomic_load(&st->live);
+		stat[i].peak = pm_atomic_load(&st->peak);
+		stat[i].count = pm_atomic_load(&st->count);
+		stat[i].allocs = pm_atomic_load(&st->allocs);
+	}
+}
+
+void
+tnt_net_complete(struct tnt_stream *s, uint64_t sync) {
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	pm_atomic_fetch_sub(&s->wrcnt, 1);
+	tnt_rtt_reply(s, sync);
+	if (sn->journal != NULL)
+		tnt_journal_done(sn->journal, sync);
+}
+
+/* add request to reconnect journal before it's written */
+static int
+tnt_net_journal(struct tnt_stream *s, const struct iovec *iov, int count) {
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->journal == NULL)
+		return 0;
+	if (tnt_journal_add(sn->journal, s->reqid - 1, iov, count) == -1) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	return 0;
+}
+
 static ssize_t
 tnt_net_write(struct tnt_stream *s, const char *buf, size_t size) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct iovec iov = { (void *)buf, size };
+	if (tnt_net_journal(s, &iov, 1) == -1)
+		return -1;
 	ssize_t rc = tnt_io_send(sn, buf, size);
-	if (rc != -1)
+	if (rc != -1) {
 		pm_atomic_fetch_add(&s->wrcnt, 1);
+		tnt_rtt_submit(s);
+	} else if (sn->journal != NULL) {
+		tnt_journal_pop(sn->journal);
+	}
 	return rc;
 }
 
 static ssize_t
 tnt_net_writev(struct tnt_stream *s, struct iovec *iov, int count) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (tnt_net_journal(s, iov, count) == -1)
+		return -1;
 	ssize_t rc = tnt_io_sendv(sn, iov, count);
-	if (rc != -1)
+	if (rc != -1) {
 		pm_atomic_fetch_add(&s->wrcnt, 1);
+		tnt_rtt_submit(s);
+	} else if (sn->journal != NULL) {
+		tnt_journal_pop(sn->journal);
+	}
 	return rc;
 }
 
-static ssize_t
-tnt_net_recv_cb(struct tnt_stream *s, char *buf, ssize_t size) {
+/**
+ * Read until the whole reply is in rbuf (it grows to fit the reply, and
+ * every recv reads as much as there's free space), then parse it from
+ * there. With TNT_OPT_ZEROCOPY reply points into rbuf and holds a reference
+ * to its memory, otherwise reply is copied out. Buffer, that has grown for
+ * a large reply, is shrunk back, when it's drained.
+ *
+ * In non-blocking mode 1 is returned, if reply is still incomplete.
+ */
+static int
+tnt_net_reply_buf(struct tnt_stream *s, struct tnt_reply *r) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
-	return tnt_io_recv(sn, buf, size);
+	struct tnt_iob *b = &sn->rbuf;
+	size_t len = 0;
+	while (1) {
+		int rc = tnt_reply0(NULL, b->buf + b->off, b->top - b->off, &len);
+		if (rc == -1)
+			return -1;
+		if (rc == 0)
+			break;
+		ssize_t n = tnt_io_recv_more(sn, len);
+		if (n == -1)
+			return -1;
+		if (n == 0)
+			return 1;
+	}
+	char *buf = b->buf + b->off;
+	void *owner = NULL;
+	if (b->chunk == NULL) {
+		/* copy reply out, it's accounted in memory usage of stream */
+		if (sn->rpool != NULL)
+			buf = tnt_rpool_get(sn->rpool, len, &owner);
+		else
+			buf = owner = tnt_mem_alloc_ex(sn->opt.mem, sn->stats,
+						       len, TNT_MEM_REPLY);
+		if (buf == NULL) {
+			sn->error = TNT_EMEMORY;
+			return -1;
+		}
+		memcpy(buf, b->buf + b->off, len);
+	}
+	int alloc = r->alloc;
+	memset(r, 0, sizeof(struct tnt_reply));
+	r->alloc = alloc;
+	if (tnt_reply0(r, buf, len, NULL) == -1) {
+		if (owner != NULL && sn->rpool != NULL)
+			tnt_rpool_put(owner);
+		else
+			tnt_mem_free(owner);
+		return -1;
+	}
+	r->buf = buf + TNT_REPLY_IPROTO_HDR_SIZE;
+	r->buf_size = len - TNT_REPLY_IPROTO_HDR_SIZE;
+	if (b->chunk != NULL) {
+		r->buf_owner = tnt_iob_ref(b);
+		r->buf_release = tnt_iob_unref;
+	} else {
+		r->buf_owner = owner;
+		r->buf_release = (sn->rpool != NULL) ? tnt_rpool_put :
+						       tnt_mem_free;
+	}
+	b->off += len;
+	/* io_uring may receive into rbuf, it's reserved by tnt_uring_run */
+	size_t keep = (sn->opt.recv_buf > TNT_IO_RECV_MIN) ?
+		      (size_t)sn->opt.recv_buf : TNT_IO_RECV_MIN;
+	if (sn->uring == NULL && b->size > TNT_IO_RECV_SLACK * keep)
+		tnt_iob_shrink(b, keep);
+	return 0;
+}
+
+int
+tnt_net_lost(struct tnt_stream *s, struct tnt_reply *r) {
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct tnt_journal *j = sn->journal;
+	while (j != NULL && j->lost_count > 0) {
+		uint64_t sync = j->lost[j->lost_head++];
+		j->lost_count--;
+		if (tnt_async_lost(s, sync))
+			continue;
+		r->sync = sync;
+		sn->error = TNT_ELOST;
+		return -1;
+	}
+	return 0;
 }
 
 static int
-tnt_net_reply(struct tnt_stream *s, struct tnt_reply *r) {
+tnt_net_reply_next(struct tnt_stream *s, struct tnt_reply *r) {
+	/* report requests, that were lost on reconnect, first */
+	if (tnt_net_lost(s, r) == -1)
+		return -1;
 	if (pm_atomic_load(&s->wrcnt) == 0)
 		return 1;
-	int rv = tnt_reply_from(r, (tnt_reply_t)tnt_net_recv_cb, s);
-	if (r->error || (r->code & TNT_CHUNK) == 0) {
-		pm_atomic_fetch_sub(&s->wrcnt, 1);
-	}
+	int rv = tnt_net_reply_buf(s, r);
+	if (rv != 0)
+		return rv;
+	if (r->error || (r->code & TNT_CHUNK) == 0)
+		tnt_net_complete(s, r->sync);
+	return rv;
+}
+
+static int
+tnt_net_reply(struct tnt_stream *s, struct tnt_reply *r) {
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	int rv = tnt_net_reply_next(s, r);
+	/* backoff would stall event loop of non-blocking stream */
+	if (rv == -1 && sn->error == TNT_ESYSTEM && sn->journal != NULL &&
+	    !sn->nonblock && tnt_reconnect(s) == 0)
+		rv = tnt_net_reply_next(s, r);
 	return rv;
 }
 
@@ -129,6 +319,10 @@ struct tnt_stream *tnt_net(struct tnt_stream *s) {
 	/* initializing internal data */
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
 	sn->fd = -1;
+	if ((sn->stats = tnt_mem_stats_new()) == NULL) {
+		tnt_stream_free(s);
+		return NULL;
+	}
 	sn->greeting = tnt_mem_alloc(TNT_GREETING_SIZE);
 	if (sn->greeting == NULL) {
 		tnt_stream_free(s);
@@ -148,19 +342,54 @@ int tnt_set(struct tnt_stream *s, int opt, ...) {
 	return (sn->error == TNT_EOK) ? 0 : -1;
 }
 
+/* empty schema snapshot to be filled by connection */
+static struct tnt_schema *
+tnt_net_schema_new(struct tnt_stream_net *sn)
+{
+	struct tnt_schema *sch = tnt_schema_new(NULL);
+	/* shared snapshot may outlive allocator context of connection */
+	if (sch != NULL && sn->opt.schema_cache == NULL) {
+		sch->mem = sn->opt.mem;
+		sch->stats = sn->stats;
+	}
+	return sch;
+}
+
 int tnt_init(struct tnt_stream *s) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
-	if ((sn->schema = tnt_schema_new(NULL)) == NULL) {
+	/* io_uring does io on socket by itself, without callbacks */
+	if (sn->opt.uring && (sn->opt.send_cb || sn->opt.send_cbv ||
+			      sn->opt.recv_cb)) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	if (sn->opt.schema_cache != NULL)
+		sn->schema = tnt_schema_cache_get(sn->opt.schema_cache);
+	if (sn->schema == NULL &&
+	    (sn->schema = tnt_net_schema_new(sn)) == NULL) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	if (sn->opt.reply_pool > 0 && sn->rpool == NULL &&
+	    (sn->rpool = tnt_rpool_new(sn->opt.reply_pool, sn->opt.mem,
+				       sn->stats)) == NULL) {
 		sn->error = TNT_EMEMORY;
 		return -1;
 	}
 	if (tnt_iob_init(&sn->sbuf, sn->opt.send_buf, sn->opt.send_cb,
-		sn->opt.send_cbv, sn->opt.send_cb_arg) == -1) {
+		sn->opt.send_cbv, sn->opt.send_cb_arg, sn->opt.mem,
+		sn->stats) == -1) {
 		sn->error = TNT_EMEMORY;
 		return -1;
 	}
 	if (tnt_iob_init(&sn->rbuf, sn->opt.recv_buf, sn->opt.recv_cb, NULL,
-		sn->opt.recv_cb_arg) == -1) {
+		sn->opt.recv_cb_arg, sn->opt.mem, sn->stats) == -1) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	sn->sendq.mem = sn->opt.mem;
+	sn->sendq.stats = sn->stats;
+	if (sn->opt.zerocopy && tnt_iob_share(&sn->rbuf) == -1) {
 		sn->error = TNT_EMEMORY;
 		return -1;
 	}
@@ -168,16 +397,52 @@ int tnt_init(struct tnt_stream *s) {
 	return 0;
 }
 
-int tnt_reload_schema(struct tnt_stream *s)
+int
+tnt_net_sync(struct tnt_stream *s, int (*fn)(struct tnt_stream *, void *),
+	     void *arg)
 {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
 	if (!sn->connected || pm_atomic_load(&s->wrcnt) != 0)
 		return -1;
+	if (sn->uring) {
+		/* ring mustn't receive, while reply is read from socket */
+		struct tnt_uring *ring = tnt_uring_detach(s);
+		int rc = tnt_net_sync(s, fn, arg);
+		if (tnt_uring_attach(ring, s) == -1)
+			return -1;
+		return rc;
+	}
+	if (sn->nonblock) {
+		if ((sn->error = tnt_io_set_nonblock(sn, 0)) != TNT_EOK)
+			return -1;
+		int rc = tnt_net_sync(s, fn, arg);
+		if ((sn->error = tnt_io_set_nonblock(sn, 1)) != TNT_EOK)
+			return -1;
+		return rc;
+	}
+	return fn(s, arg);
+}
+
+static int
+tnt_load_schema(struct tnt_stream *s, void *arg)
+{
+	(void )arg;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	/* schema requests use fixed syncs, they aren't journaled */
+	struct tnt_journal *j = sn->journal;
+	sn->journal = NULL;
 	uint64_t oldsync = tnt_stream_reqid(s, 127);
 	tnt_get_space(s);
 	tnt_get_index(s);
 	tnt_stream_reqid(s, oldsync);
+	sn->journal = j;
 	tnt_flush(s);
+	/* snapshot is immutable, so new one is filled instead of flushing */
+	struct tnt_schema *sch = tnt_net_schema_new(sn);
+	if (sch == NULL) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
 	struct tnt_iter it; tnt_iter_reply(&it, s);
 	struct tnt_reply bkp; tnt_reply_init(&bkp);
 	int sloaded = 0;
@@ -187,7 +452,8 @@ int tnt_reload_schema(struct tnt_stream *s)
 		case(127):
 			if (r->error)
 				goto error;
-			tnt_schema_add_spaces(sn->schema, r);
+			tnt_schema_add_spaces(sch, r);
+			sch->version = r->schema_id;
 			sloaded += 1;
 			break;
 		case(128):
@@ -199,26 +465,37 @@ int tnt_reload_schema(struct tnt_stream *s)
 				break;
 			}
 			sloaded += 2;
-			tnt_schema_add_indexes(sn->schema, r);
+			tnt_schema_add_indexes(sch, r);
 			break;
 		default:
 			goto error;
 		}
 	}
 	if (bkp.buf) {
-		tnt_schema_add_indexes(sn->schema, &bkp);
+		tnt_schema_add_indexes(sch, &bkp);
 		sloaded += 2;
 		tnt_reply_free(&bkp);
 	}
 	if (sloaded != 3) goto error;
 
 	tnt_iter_free(&it);
+	if (sn->opt.schema_cache != NULL)
+		tnt_schema_cache_publish(sn->opt.schema_cache, sch);
+	tnt_schema_unref(sn->schema);
+	sn->schema = sch;
 	return 0;
 error:
 	tnt_iter_free(&it);
+	tnt_reply_free(&bkp);
+	tnt_schema_unref(sch);
 	return -1;
 }
 
+int tnt_reload_schema(struct tnt_stream *s)
+{
+	return tnt_net_sync(s, tnt_load_schema, NULL);
+}
+
 static int
 tnt_authenticate(struct tnt_stream *s)
 {
@@ -238,17 +515,27 @@ tnt_authenticate(struct tnt_stream *s)
 			sn->error = TNT_ELOGIN;
 		return -1;
 	}
+	uint64_t version = rep.schema_id;
 	tnt_reply_free(&rep);
+	/* take schema of the same version from cache, if it's there */
+	struct tnt_schema *sch = NULL;
+	if (sn->opt.schema_cache != NULL)
+		sch = tnt_schema_cache_get(sn->opt.schema_cache);
+	if (sch != NULL && sch->version != 0 && sch->version == version) {
+		tnt_schema_unref(sn->schema);
+		sn->schema = sch;
+		return 0;
+	}
+	tnt_schema_unref(sch);
 	tnt_reload_schema(s);
 	return 0;
 }
 
-int tnt_connect(struct tnt_stream *s)
+/* connect, read greeting and authenticate */
+static int
+tnt_net_handshake(struct tnt_stream *s)
 {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
-	if (!sn->inited) tnt_init(s);
-	if (sn->connected)
-		tnt_close(s);
 	sn->error = tnt_io_connect(sn);
 	if (sn->error != TNT_EOK)
 		return -1;
@@ -258,14 +545,141 @@ int tnt_connect(struct tnt_stream *s)
 	if (sn->opt.uri->login && sn->opt.uri->password)
 		if (tnt_authenticate(s) == -1)
 			return -1;
+	if (sn->opt.nonblock) {
+		sn->error = tnt_io_set_nonblock(sn, 1);
+		if (sn->error != TNT_EOK)
+			return -1;
+	}
+	return 0;
+}
+
+int tnt_connect(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (!sn->inited) tnt_init(s);
+	if (sn->connected)
+		tnt_close(s);
+	if (tnt_net_handshake(s) == -1)
+		return -1;
+	if (sn->opt.uring && tnt_uring_attach(sn->opt.uring, s) == -1)
+		return -1;
+	if (sn->opt.reconnect > 0 && sn->opt.uring == NULL &&
+	    sn->journal == NULL) {
+		sn->journal = tnt_journal_new(sn->stats);
+		if (sn->journal == NULL) {
+			sn->error = TNT_EMEMORY;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* drop connection, but keep requests in flight in journal */
+static void
+tnt_net_drop(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	tnt_io_close(sn);
+	tnt_iob_clear(&sn->sbuf);
+	tnt_iob_clear(&sn->rbuf);
+	sn->sendq.count = 0;
+	/* statement ids are session-local */
+	tnt_stmt_cache_clear(s);
+	memset(sn->rtt.sent, 0, sizeof(sn->rtt.sent));
+	s->wrcnt = 0;
+}
+
+int tnt_reconnect(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct tnt_journal *j = sn->journal;
+	if (j == NULL) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	/* auth and schema requests go before replayed ones */
+	sn->journal = NULL;
+	int rc = -1;
+	for (int attempt = 0; rc == -1 && attempt < sn->opt.reconnect;
+	     attempt++) {
+		if (attempt > 0)
+			tnt_journal_backoff(j, attempt - 1,
+					    sn->opt.reconnect_delay,
+					    sn->opt.reconnect_max_delay);
+		tnt_net_drop(s);
+		rc = tnt_net_handshake(s);
+	}
+	enum tnt_error error = sn->error;
+	if (rc == -1)
+		tnt_io_close(sn);
+	sn->journal = j;
+	j->reconnects++;
+	uint32_t count = j->count;
+	for (uint32_t i = 0; i < count; i++) {
+		struct tnt_journal_entry *e = tnt_journal_entry(j, i);
+		if (e->done)
+			continue;
+		if (rc == 0 && e->idempotent &&
+		    tnt_io_send(sn, e->data, e->size) != -1) {
+			pm_atomic_fetch_add(&s->wrcnt, 1);
+			continue;
+		}
+		if (tnt_journal_lose(j, e->sync) == -1)
+			error = TNT_EMEMORY;
+		e->done = 1;
+		tnt_mem_free(e->data);
+		e->data = NULL;
+	}
+	tnt_journal_compact(j);
+	if (rc == 0 && tnt_flush(s) == -1)
+		return -1;
+	sn->error = error;
+	return rc;
+}
+
+int tnt_idempotent(struct tnt_stream *s, uint64_t sync)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->journal == NULL)
+		return -1;
+	struct tnt_journal_entry *e = tnt_journal_find(sn->journal, sync);
+	if (e == NULL || e->done)
+		return -1;
+	if (e->data != NULL) {
+		e->idempotent = 1;
+		return 0;
+	}
+	/*
+	 * Request isn't copied, when it's written, it's copied from sbuf,
+	 * while it isn't sent. Bytes, that aren't sent, are the tail of
+	 * written ones, unless some of them are queued by reference.
+	 */
+	for (int i = 0; i < sn->sendq.count; i++)
+		if (sn->sendq.iov[i].iov_base != NULL)
+			return -1;
+	uint64_t tail = sn->journal->written - e->end + e->size;
+	if (tail > sn->sbuf.off)
+		return -1;
+	const char *data = sn->sbuf.buf + sn->sbuf.off - tail;
+	if (tnt_journal_keep(sn->journal, e, data) == -1) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
 	return 0;
 }
 
 void tnt_close(struct tnt_stream *s) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	tnt_uring_detach(s);
 	tnt_iob_clear(&sn->sbuf);
 	tnt_iob_clear(&sn->rbuf);
+	sn->sendq.count = 0;
 	tnt_io_close(sn);
+	tnt_async_fail(s, TNT_EFAIL);
+	tnt_stmt_cache_clear(s);
+	memset(sn->rtt.sent, 0, sizeof(sn->rtt.sent));
+	if (sn->journal != NULL)
+		tnt_journal_clear(sn->journal);
 	s->wrcnt = 0;
 	s->reqid = 0;
 }
@@ -275,6 +689,22 @@ ssize_t tnt_flush(struct tnt_stream *s) {
 	return tnt_io_flush(sn);
 }
 
+int tnt_wants(struct tnt_stream *s) {
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	int events = 0;
+	if (!sn->connected)
+		return 0;
+	if (sn->sbuf.off > 0 || sn->sendq.count > 0)
+		events |= TNT_WANT_WRITE;
+	if (pm_atomic_load(&s->wrcnt) > 0)
+		events |= TNT_WANT_READ;
+	return events;
+}
+
+int tnt_process_io(struct tnt_stream *s) {
+	return tnt_async_dispatch(s, 0);
+}
+
 int tnt_fd(struct tnt_stream *s) {
 	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
 	return sn->fd;
@@ -304,6 +734,7 @@ static struct tnt_error_desc tnt_error_list[] =
 	{ TNT_ETMOUT,   "operation timeout"        },
 	{ TNT_EBADVAL,  "bad argument"             },
 	{ TNT_ELOGIN,   "failed to login"          },
+	{ TNT_ELOST,    "request lost on reconnect" },
 	{ TNT_LAST,      NULL                      }
 };
 
@@ -327,13 +758,49 @@ int tnt_errno(struct tnt_stream *s) {
 int tnt_get_spaceno(struct tnt_stream *s, const char *space,
 		    size_t space_len)
 {
-	struct tnt_schema *sch = (TNT_SNET_CAST(s))->schema;
-	return tnt_schema_stosid(sch, space, space_len);
+	return tnt_schema_stosid(tnt_net_schema(s), space, space_len);
 }
 
 int tnt_get_indexno(struct tnt_stream *s, int spaceno, const char *index,
 		    size_t index_len)
 {
-	struct tnt_schema *sch = TNT_SNET_CAST(s)->schema;
-	return tnt_schema_stoiid(sch, spaceno, index, index_len);
+	return tnt_schema_stoiid(tnt_net_schema(s), spaceno, index,
+				 index_len);
+}
+
+int
+tnt_net_drain(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	enum tnt_error error = sn->error;
+	int errno_ = sn->errno_;
+	if (tnt_flush(s) != -1) {
+		while (pm_atomic_load(&s->wrcnt) > 0) {
+			struct tnt_reply r;
+			tnt_reply_init(&r);
+			int rc = s->read_reply(s, &r);
+			tnt_reply_free(&r);
+			/* lost request is accounted as well */
+			if (rc != 0 && (rc != -1 || sn->error != TNT_ELOST))
+				break;
+		}
+	}
+	int rc = 0;
+	if (pm_atomic_load(&s->wrcnt) > 0) {
+		tnt_close(s);
+		rc = -1;
+	}
+	sn->error = error;
+	sn->errno_ = errno_;
+	return rc;
+}
+
+struct tnt_schema *
+tnt_net_schema(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->opt.schema_cache != NULL && sn->schema != NULL)
+		sn->schema = tnt_schema_cache_renew(sn->opt.schema_cache,
+						    sn->schema);
+	return sn->schema;
 }
@@ -17,6 +17,7 @@ tnt_sbuf_object_free(struct tnt_stream *s)
 	struct tnt_sbuf_object *sbo = TNT_SOBJ_CAST(s);
 	if (sbo->stack) tnt_mem_free(sbo->stack);
 	sbo->stack = NULL;
+	tnt_mem_free(sbo->extents);
 	tnt_mem_free(sbo);
 }
 
@@ -31,16 +32,64 @@ tnt_object_type(struct tnt_stream *s, enum tnt_sbo_type type)
 static int
 tnt_sbuf_object_grow_stack(struct tnt_sbuf_object *sbo)
 {
-	if (sbo->stack_alloc == 128) return -1;
-	uint8_t new_stack_alloc = 2 * sbo->stack_alloc;
-	struct tnt_sbo_stack *stack = tnt_mem_alloc(new_stack_alloc * sizeof(
-				struct tnt_sbo_stack));
+	uint32_t new_stack_alloc = 2 * sbo->stack_alloc;
+	struct tnt_sbo_stack *stack = tnt_mem_realloc_tag(sbo->stack,
+			new_stack_alloc * sizeof(struct tnt_sbo_stack),
+			TNT_MEM_OBJECT);
 	if (!stack) return -1;
 	sbo->stack_alloc = new_stack_alloc;
 	sbo->stack = stack;
 	return 0;
 }
 
+static int
+tnt_sbuf_object_add_extent(struct tnt_sbuf_object *sbo, size_t offset)
+{
+	if (sbo->extents_size == sbo->extents_alloc) {
+		uint32_t new_alloc = sbo->extents_alloc ?
+				     2 * sbo->extents_alloc : 16;
+		size_t *extents = tnt_mem_realloc_tag(sbo->extents,
+						  new_alloc * sizeof(size_t),
+						  TNT_MEM_OBJECT);
+		if (!extents) return -1;
+		sbo->extents_alloc = new_alloc;
+		sbo->extents = extents;
+	}
+	sbo->extents[sbo->extents_size++] = offset;
+	return 0;
+}
+
+/*
+ * Replace 5-byte headers of closed containers with minimal ones. Extents
+ * are sorted by offset, so every byte is moved at most once.
+ */
+static void
+tnt_sbuf_object_shrink(struct tnt_stream *s)
+{
+	struct tnt_stream_buf   *sb = TNT_SBUF_CAST(s);
+	struct tnt_sbuf_object *sbo = TNT_SOBJ_CAST(s);
+	if (sbo->extents_size == 0)
+		return;
+	char *data = sb->data;
+	size_t src = sbo->extents[0], dst = src;
+	for (uint32_t i = 0; i < sbo->extents_size; ++i) {
+		size_t offset = sbo->extents[i];
+		memmove(data + dst, data + src, offset - src);
+		dst += offset - src;
+		const char *hdr = data + offset;
+		char *end = NULL;
+		if (mp_typeof(*hdr) == MP_MAP)
+			end = mp_encode_map(data + dst, mp_decode_map(&hdr));
+		else
+			end = mp_encode_array(data + dst, mp_decode_array(&hdr));
+		dst = end - data;
+		src = offset + 5;
+	}
+	memmove(data + dst, data + src, sb->size - src);
+	sb->size -= src - dst;
+	sbo->extents_size = 0;
+}
+
 static char *
 tnt_sbuf_object_resize(struct tnt_stream *s, size_t size) {
 	struct tnt_stream_buf *sb = TNT_SBUF_CAST(s);
@@ -48,7 +97,8 @@ tnt_sbuf_object_resize(struct tnt_stream *s, size_t size) {
 		size_t newsize = 2 * (sb->alloc);
 		if (newsize < sb->size + size)
 			newsize = sb->size + size;
-		char *nd = tnt_mem_realloc(sb->data, newsize);
+		char *nd = tnt_mem_realloc_tag(sb->data, newsize,
+					       TNT_MEM_OBJECT);
 		if (nd == NULL) {
 			tnt_mem_free(sb->data);
 			return NULL;
@@ -69,14 +119,16 @@ tnt_object(struct tnt_stream *s)
 	sb->resize = tnt_sbuf_object_resize;
 	sb->free = tnt_sbuf_object_free;
 
-	struct tnt_sbuf_object *sbo = tnt_mem_alloc(sizeof(struct tnt_sbuf_object));
+	struct tnt_sbuf_object *sbo = tnt_mem_alloc_tag(sizeof(struct tnt_sbuf_object),
+							TNT_MEM_OBJECT);
 	if (sbo == NULL)
 		goto error;
 	sb->subdata = sbo;
+	memset(sbo, 0, sizeof(struct tnt_sbuf_object));
 	sbo->stack_size = 0;
 	sbo->stack_alloc = 8;
-	sbo->stack = tnt_mem_alloc(sbo->stack_alloc *
-			sizeof(struct tnt_sbo_stack));
+	sbo->stack = tnt_mem_alloc_tag(sbo->stack_alloc *
+			sizeof(struct tnt_sbo_stack), TNT_MEM_OBJECT);
 	if (sbo->stack == NULL)
 		goto error;
 	tnt_object_type(s, TNT_SBO_SIMPLE);
@@ -222,6 +274,10 @@ tnt_object_add_array (struct tnt_stream *s, uint32_t size)
 		end = mp_encode_array32(data, 0);
 	} else if (TNT_SOBJ_CAST(s)->type == TNT_SBO_PACKED) {
 		end = mp_encode_array(data, 0);
+	} else if (TNT_SOBJ_CAST(s)->type == TNT_SBO_DEFERRED) {
+		if (tnt_sbuf_object_add_extent(sbo, sb->size) == -1)
+			return -1;
+		end = mp_encode_array32(data, 0);
 	} else {
 		return -1;
 	}
@@ -257,6 +313,10 @@ tnt_object_add_map (struct tnt_stream *s, uint32_t size)
 		end = mp_encode_map32(data, 0);
 	} else if (TNT_SOBJ_CAST(s)->type == TNT_SBO_PACKED) {
 		end = mp_encode_map(data, 0);
+	} else if (TNT_SOBJ_CAST(s)->type == TNT_SBO_DEFERRED) {
+		if (tnt_sbuf_object_add_extent(sbo, sb->size) == -1)
+			return -1;
+		end = mp_encode_map32(data, 0);
 	} else {
 		return -1;
 	}
@@ -303,6 +363,15 @@ tnt_object_container_close (struct tnt_stream *s)
 		}
 		sb->size += (sz - 1);
 		return 0;
+	} else if (sbo->type == TNT_SBO_DEFERRED) {
+		/* headers are shrunk, when the outermost container is closed */
+		if (type == MP_MAP)
+			mp_encode_map32(lenp, size/2);
+		else
+			mp_encode_array32(lenp, size);
+		if (sbo->stack_size == 0)
+			tnt_sbuf_object_shrink(s);
+		return 0;
 	}
 	return -1;
 }
@@ -319,23 +388,20 @@ int tnt_object_verify(struct tnt_stream *obj, int8_t type)
 
 ssize_t tnt_object_vformat(struct tnt_stream *s, const char *fmt, va_list vl)
 {
-	if (tnt_object_type(s, TNT_SBO_PACKED) == -1)
+	if (tnt_object_type(s, TNT_SBO_DEFERRED) == -1)
 		return -1;
-	ssize_t result = 0, rv = 0;
+	size_t start = TNT_SBUF_SIZE(s);
 
 	for (const char *f = fmt; *f; f++) {
 		if (f[0] == '[') {
-			if ((rv = tnt_object_add_array(s, 0)) == -1)
+			if (tnt_object_add_array(s, 0) == -1)
 				return -1;
-			result += rv;
 		} else if (f[0] == '{') {
-			if ((rv = tnt_object_add_map(s, 0)) == -1)
+			if (tnt_object_add_map(s, 0) == -1)
 				return -1;
-			result += rv;
 		} else if (f[0] == ']' || f[0] == '}') {
-			if ((rv = tnt_object_container_close(s)) == -1)
+			if (tnt_object_container_close(s) == -1)
 				return -1;
-			result += rv;
 		} else if (f[0] == '%') {
 			f++;
 			assert(f[0]);
@@ -351,32 +417,27 @@ ssize_t tnt_object_vformat(struct tnt_stream *s, const char *fmt, va_list vl)
 			} else if (f[0] == 's') {
 				const char *str = va_arg(vl, const char *);
 				uint32_t len = (uint32_t)strlen(str);
-				if ((rv = tnt_object_add_str(s, str, len)) == -1)
+				if (tnt_object_add_str(s, str, len) == -1)
 					return -1;
-				result += rv;
 			} else if (f[0] == '.' && f[1] == '*' && f[2] == 's') {
 				uint32_t len = va_arg(vl, uint32_t);
 				const char *str = va_arg(vl, const char *);
-				if ((rv = tnt_object_add_str(s, str, len)) == -1)
+				if (tnt_object_add_str(s, str, len) == -1)
 					return -1;
-				result += rv;
 				f += 2;
 			} else if (f[0] == 'f') {
 				float v = (float)va_arg(vl, double);
-				if ((rv = tnt_object_add_float(s, v)) == -1)
+				if (tnt_object_add_float(s, v) == -1)
 					return -1;
-				result += rv;
 			} else if (f[0] == 'l' && f[1] == 'f') {
 				double v = va_arg(vl, double);
-				if ((rv = tnt_object_add_double(s, v)) == -1)
+				if (tnt_object_add_double(s, v) == -1)
 					return -1;
-				result += rv;
 				f++;
 			} else if (f[0] == 'b') {
 				bool v = (bool)va_arg(vl, int);
-				if ((rv = tnt_object_add_bool(s, v)) == -1)
+				if (tnt_object_add_bool(s, v) == -1)
 					return -1;
-				result += rv;
 			} else if (f[0] == 'l'
 				   && (f[1] == 'd' || f[1] == 'i')) {
 				int_value = va_arg(vl, long);
@@ -419,18 +480,16 @@ ssize_t tnt_object_vformat(struct tnt_stream *s, const char *fmt, va_list vl)
 			}
 
 			if (int_status) {
-				if ((rv = tnt_object_add_int(s, int_value)) == -1)
+				if (tnt_object_add_int(s, int_value) == -1)
 					return -1;
-				result += rv;
 			}
 		} else if (f[0] == 'N' && f[1] == 'I' && f[2] == 'L') {
-			if ((rv = tnt_object_add_nil(s)) == -1)
+			if (tnt_object_add_nil(s) == -1)
 				return -1;
-			result += rv;
 			f += 2;
 		}
 	}
-	return result;
+	return TNT_SBUF_SIZE(s) - start;
 }
 
 ssize_t tnt_object_format(struct tnt_stream *s, const char *fmt, ...)
@@ -442,6 +501,352 @@ ssize_t tnt_object_format(struct tnt_stream *s, const char *fmt, ...)
 	return res;
 }
 
+/**
+ * \internal
+ * \brief compiled format operations
+ *
+ * Containers and nils are encoded at compile time and merged into runs of
+ * raw bytes, everything else takes the next argument.
+ */
+enum tnt_format_code {
+	TNT_FMT_RAW = 0,
+	TNT_FMT_INT,
+	TNT_FMT_UINT,
+	TNT_FMT_LONG,
+	TNT_FMT_ULONG,
+	TNT_FMT_LLONG,
+	TNT_FMT_ULLONG,
+	TNT_FMT_FLOAT,
+	TNT_FMT_DOUBLE,
+	TNT_FMT_BOOL,
+	TNT_FMT_STR,
+	TNT_FMT_STRL,
+	/* compile time only */
+	TNT_FMT_ARRAY,
+	TNT_FMT_MAP,
+	TNT_FMT_NIL,
+};
+
+struct tnt_format_op {
+	uint8_t code;
+	uint32_t off; /* raw bytes offset or container size */
+	uint32_t len; /* raw bytes length */
+	uint32_t tail; /* max size of this and next ops, without strings */
+};
+
+struct tnt_format {
+	uint32_t count; /* count of operations */
+	uint32_t items; /* count of top-level values */
+	struct tnt_format_op *ops;
+	char *raw;
+};
+
+/* parse next element of format, return its code or -1 on error */
+static int
+tnt_format_next(const char **fmt)
+{
+	const char *f = *fmt;
+	int code = -1;
+	switch (*f) {
+	case '[':
+		code = TNT_FMT_ARRAY;
+		break;
+	case '{':
+		code = TNT_FMT_MAP;
+		break;
+	case 'N':
+		if (f[1] != 'I' || f[2] != 'L')
+			return 0;
+		code = TNT_FMT_NIL;
+		f += 2;
+		break;
+	case '%':
+		f++;
+		if (f[0] == 'd' || f[0] == 'i') {
+			code = TNT_FMT_INT;
+		} else if (f[0] == 'u') {
+			code = TNT_FMT_UINT;
+		} else if (f[0] == 's') {
+			code = TNT_FMT_STR;
+		} else if (f[0] == '.' && f[1] == '*' && f[2] == 's') {
+			code = TNT_FMT_STRL;
+			f += 2;
+		} else if (f[0] == 'f') {
+			code = TNT_FMT_FLOAT;
+		} else if (f[0] == 'l' && f[1] == 'f') {
+			code = TNT_FMT_DOUBLE;
+			f++;
+		} else if (f[0] == 'b') {
+			code = TNT_FMT_BOOL;
+		} else if (f[0] == 'l' && (f[1] == 'd' || f[1] == 'i')) {
+			code = TNT_FMT_LONG;
+			f++;
+		} else if (f[0] == 'l' && f[1] == 'u') {
+			code = TNT_FMT_ULONG;
+			f++;
+		} else if (f[0] == 'l' && f[1] == 'l' &&
+			   (f[2] == 'd' || f[2] == 'i')) {
+			code = TNT_FMT_LLONG;
+			f += 2;
+		} else if (f[0] == 'l' && f[1] == 'l' && f[2] == 'u') {
+			code = TNT_FMT_ULLONG;
+			f += 2;
+		} else if (f[0] == 'h' && (f[1] == 'd' || f[1] == 'i')) {
+			code = TNT_FMT_INT;
+			f++;
+		} else if (f[0] == 'h' && f[1] == 'u') {
+			code = TNT_FMT_UINT;
+			f++;
+		} else if (f[0] == 'h' && f[1] == 'h' &&
+			   (f[2] == 'd' || f[2] == 'i')) {
+			code = TNT_FMT_INT;
+			f += 2;
+		} else if (f[0] == 'h' && f[1] == 'h' && f[2] == 'u') {
+			code = TNT_FMT_UINT;
+			f += 2;
+		} else if (f[0] == '%') {
+			code = 0;
+		} else {
+			return -1;
+		}
+		break;
+	default:
+		return 0;
+	}
+	*fmt = f;
+	return code;
+}
+
+/* max size of encoded argument of operation (header only for strings) */
+static uint32_t
+tnt_format_op_size(const struct tnt_format_op *op)
+{
+	switch (op->code) {
+	case TNT_FMT_RAW:
+		return op->len;
+	case TNT_FMT_BOOL:
+		return 1;
+	case TNT_FMT_FLOAT:
+	case TNT_FMT_STR:
+	case TNT_FMT_STRL:
+		return 5;
+	default:
+		return 9;
+	}
+}
+
+struct tnt_format *
+tnt_format_compile(const char *fmt)
+{
+	size_t flen = strlen(fmt);
+	/* every element takes at least one symbol of format */
+	struct tnt_format_op *items = tnt_mem_alloc_tag((flen + 1) *
+		(sizeof(struct tnt_format_op) + sizeof(uint32_t)),
+		TNT_MEM_OBJECT);
+	if (items == NULL)
+		return NULL;
+	uint32_t *stack = (uint32_t *)(items + flen + 1);
+	uint32_t count = 0, depth = 0, top = 0;
+	struct tnt_format *result = NULL;
+
+	/* 1. parse format, counting elements of containers */
+	for (const char *f = fmt; *f; f++) {
+		if (*f == ']' || *f == '}') {
+			if (depth == 0)
+				goto cleanup;
+			struct tnt_format_op *c = &items[stack[--depth]];
+			if ((c->code == TNT_FMT_MAP) != (*f == '}'))
+				goto cleanup;
+			if (c->code == TNT_FMT_MAP && c->off % 2)
+				goto cleanup;
+			continue;
+		}
+		int code = tnt_format_next(&f);
+		if (code == -1)
+			goto cleanup;
+		if (code == 0)
+			continue;
+		if (depth > 0)
+			items[stack[depth - 1]].off += 1;
+		else
+			top += 1;
+		items[count].code = code;
+		items[count].off = 0;
+		if (code == TNT_FMT_ARRAY || code == TNT_FMT_MAP)
+			stack[depth++] = count;
+		count++;
+	}
+	if (depth > 0)
+		goto cleanup;
+
+	/* 2. encode containers and nils, merging them into raw runs */
+	uint32_t ops = 0;
+	size_t raw_size = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		switch (items[i].code) {
+		case TNT_FMT_ARRAY:
+			raw_size += mp_sizeof_array(items[i].off);
+			break;
+		case TNT_FMT_MAP:
+			raw_size += mp_sizeof_map(items[i].off / 2);
+			break;
+		case TNT_FMT_NIL:
+			raw_size += mp_sizeof_nil();
+			break;
+		default:
+			ops += 2;
+		}
+	}
+	ops += 1;
+	result = tnt_mem_alloc_tag(sizeof(struct tnt_format) +
+			       ops * sizeof(struct tnt_format_op) + raw_size,
+			       TNT_MEM_OBJECT);
+	if (result == NULL)
+		goto cleanup;
+	result->ops = (struct tnt_format_op *)(result + 1);
+	result->raw = (char *)(result->ops + ops);
+	result->items = top;
+	char *raw = result->raw;
+	struct tnt_format_op *op = NULL;
+	for (uint32_t i = 0; i < count; ++i) {
+		char *end = raw;
+		switch (items[i].code) {
+		case TNT_FMT_ARRAY:
+			end = mp_encode_array(raw, items[i].off);
+			break;
+		case TNT_FMT_MAP:
+			end = mp_encode_map(raw, items[i].off / 2);
+			break;
+		case TNT_FMT_NIL:
+			end = mp_encode_nil(raw);
+			break;
+		default:
+			op = op ? op + 1 : result->ops;
+			op->code = items[i].code;
+			op->off = op->len = 0;
+			continue;
+		}
+		if (op == NULL || op->code != TNT_FMT_RAW) {
+			op = op ? op + 1 : result->ops;
+			op->code = TNT_FMT_RAW;
+			op->off = raw - result->raw;
+			op->len = 0;
+		}
+		op->len += end - raw;
+		raw = end;
+	}
+	result->count = op ? op - result->ops + 1 : 0;
+
+	/* 3. precompute sizes, that must be reserved before every op */
+	uint32_t tail = 0;
+	for (uint32_t i = result->count; i > 0; --i) {
+		tail += tnt_format_op_size(&result->ops[i - 1]);
+		result->ops[i - 1].tail = tail;
+	}
+cleanup:
+	tnt_mem_free(items);
+	return result;
+}
+
+void
+tnt_format_free(struct tnt_format *f)
+{
+	tnt_mem_free(f);
+}
+
+ssize_t
+tnt_format_vexec(struct tnt_stream *s, const struct tnt_format *f,
+		 va_list vl)
+{
+	struct tnt_stream_buf *sb = TNT_SBUF_CAST(s);
+	struct tnt_sbuf_object *sbo = TNT_SOBJ_CAST(s);
+	if (sb->as == 1)
+		return -1;
+	if (f->count == 0)
+		return 0;
+	size_t start = sb->size;
+	char *p = sb->resize(s, f->ops[0].tail);
+	if (p == NULL)
+		return -1;
+	const struct tnt_format_op *op = f->ops, *end = f->ops + f->count;
+	for (; op < end; ++op) {
+		const char *str = NULL;
+		uint32_t len = 0;
+		int64_t ival = 0;
+		switch (op->code) {
+		case TNT_FMT_RAW:
+			memcpy(p, f->raw + op->off, op->len);
+			p += op->len;
+			continue;
+		case TNT_FMT_INT:
+			ival = va_arg(vl, int);
+			break;
+		case TNT_FMT_LONG:
+			ival = va_arg(vl, long);
+			break;
+		case TNT_FMT_LLONG:
+			ival = va_arg(vl, long long);
+			break;
+		case TNT_FMT_UINT:
+			p = mp_encode_uint(p, va_arg(vl, unsigned int));
+			continue;
+		case TNT_FMT_ULONG:
+			p = mp_encode_uint(p, va_arg(vl, unsigned long));
+			continue;
+		case TNT_FMT_ULLONG:
+			p = mp_encode_uint(p, va_arg(vl, unsigned long long));
+			continue;
+		case TNT_FMT_FLOAT:
+			p = mp_encode_float(p, (float)va_arg(vl, double));
+			continue;
+		case TNT_FMT_DOUBLE:
+			p = mp_encode_double(p, va_arg(vl, double));
+			continue;
+		case TNT_FMT_BOOL:
+			p = mp_encode_bool(p, va_arg(vl, int) != 0);
+			continue;
+		case TNT_FMT_STR:
+			str = va_arg(vl, const char *);
+			len = (uint32_t)strlen(str);
+			goto string;
+		case TNT_FMT_STRL:
+			len = va_arg(vl, uint32_t);
+			str = va_arg(vl, const char *);
+			goto string;
+		default:
+			return -1;
+		}
+		if (ival < 0)
+			p = mp_encode_int(p, ival);
+		else
+			p = mp_encode_uint(p, ival);
+		continue;
+string:
+		/* reserve string body and the rest of the program */
+		sb->size = p - sb->data;
+		if ((p = sb->resize(s, op->tail + len)) == NULL)
+			return -1;
+		p = mp_encode_strl(p, len);
+		memcpy(p, str, len);
+		p += len;
+	}
+	sb->size = p - sb->data;
+	s->wrcnt++;
+	if (sbo->stack_size > 0)
+		sbo->stack[sbo->stack_size - 1].size += f->items;
+	return sb->size - start;
+}
+
+ssize_t
+tnt_format_exec(struct tnt_stream *s, const struct tnt_format *f, ...)
+{
+	va_list args;
+	va_start(args, f);
+	ssize_t res = tnt_format_vexec(s, f, args);
+	va_end(args);
+	return res;
+}
+
 struct tnt_stream *tnt_object_as(struct tnt_stream *s, char *buf,
 				 size_t buf_len)
 {
@@ -470,6 +875,7 @@ int tnt_object_reset(struct tnt_stream *s)
 	sb->size = 0;
 	sb->rdoff = 0;
 	sbo->stack_size = 0;
+	sbo->extents_size = 0;
 	sbo->type = TNT_SBO_SIMPLE;
 
 	return 0;
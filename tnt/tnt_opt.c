@@ -51,6 +51,8 @@ tnt_opt_init(struct tnt_opt *opt)
 	opt->send_buf = 16384;
 	opt->tmout_connect.tv_sec = 16;
 	opt->tmout_connect.tv_usec = 0;
+	opt->reconnect_delay = 100;
+	opt->reconnect_max_delay = 10000;
 	opt->uri = tnt_mem_alloc(sizeof(struct uri));
 	if (!opt->uri) return -1;
 	return 0;
@@ -110,6 +112,36 @@ tnt_opt_set(struct tnt_opt *opt, enum tnt_opt_type name, va_list args)
 	case TNT_OPT_RECV_BUF:
 		opt->recv_buf = va_arg(args, int);
 		break;
+	case TNT_OPT_NONBLOCK:
+		opt->nonblock = va_arg(args, int);
+		break;
+	case TNT_OPT_ZEROCOPY:
+		opt->zerocopy = va_arg(args, int);
+		break;
+	case TNT_OPT_SEND_ZEROCOPY:
+		opt->send_zerocopy = va_arg(args, int);
+		break;
+	case TNT_OPT_URING:
+		opt->uring = va_arg(args, struct tnt_uring *);
+		break;
+	case TNT_OPT_RECONNECT:
+		opt->reconnect = va_arg(args, int);
+		break;
+	case TNT_OPT_RECONNECT_DELAY:
+		opt->reconnect_delay = va_arg(args, int);
+		break;
+	case TNT_OPT_RECONNECT_MAX_DELAY:
+		opt->reconnect_max_delay = va_arg(args, int);
+		break;
+	case TNT_OPT_MEM:
+		opt->mem = va_arg(args, struct tnt_mem_ctx *);
+		break;
+	case TNT_OPT_REPLY_POOL:
+		opt->reply_pool = va_arg(args, int);
+		break;
+	case TNT_OPT_SCHEMA_CACHE:
+		opt->schema_cache = va_arg(args, struct tnt_schema_cache *);
+		break;
 	default:
 		return TNT_EFAIL;
 	}
@@ -0,0 +1,240 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <sys/types.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_async.h>
+#include <tarantool/tnt_pool.h>
+#include <tarantool/tnt_schema.h>
+
+#include "pmatomic.h"
+
+struct tnt_pool *
+tnt_pool(struct tnt_pool *p, int size)
+{
+	if (size <= 0)
+		return NULL;
+	int alloc = (p == NULL);
+	if (alloc) {
+		p = tnt_mem_alloc_tag(sizeof(struct tnt_pool),
+				      TNT_MEM_REQUEST);
+		if (p == NULL)
+			return NULL;
+	}
+	memset(p, 0, sizeof(struct tnt_pool));
+	p->alloc = alloc;
+	p->seed = 2463534242U;
+	p->members = tnt_mem_alloc_tag(size * sizeof(struct tnt_stream *),
+				       TNT_MEM_REQUEST);
+	if (p->members == NULL)
+		goto error;
+	memset(p->members, 0, size * sizeof(struct tnt_stream *));
+	if ((p->schema = tnt_schema_cache_new()) == NULL)
+		goto error;
+	for (; p->size < size; p->size++) {
+		p->members[p->size] = tnt_net(NULL);
+		if (p->members[p->size] == NULL)
+			goto error;
+		tnt_set(p->members[p->size], TNT_OPT_SCHEMA_CACHE, p->schema);
+	}
+	return p;
+error:
+	tnt_pool_free(p);
+	return NULL;
+}
+
+int
+tnt_pool_set(struct tnt_pool *p, int opt, ...)
+{
+	int rc = 0;
+	va_list args;
+	va_start(args, opt);
+	for (int i = 0; i < p->size; i++) {
+		struct tnt_stream_net *sn = TNT_SNET_CAST(p->members[i]);
+		va_list member_args;
+		va_copy(member_args, args);
+		sn->error = tnt_opt_set(&sn->opt, opt, member_args);
+		va_end(member_args);
+		if (sn->error != TNT_EOK)
+			rc = -1;
+	}
+	va_end(args);
+	return rc;
+}
+
+int
+tnt_pool_connect(struct tnt_pool *p)
+{
+	int connected = 0;
+	for (int i = 0; i < p->size; i++) {
+		if (tnt_connect(p->members[i]) == 0)
+			connected++;
+	}
+	return (connected > 0) ? connected : -1;
+}
+
+struct tnt_stream *
+tnt_pool_get(struct tnt_pool *p)
+{
+	struct tnt_stream *best = NULL;
+	uint32_t best_load = 0;
+	int best_n = 0;
+	for (int i = 0; i < p->size; i++) {
+		int n = (p->next + i) % p->size;
+		struct tnt_stream *s = p->members[n];
+		if (!TNT_SNET_CAST(s)->connected)
+			continue;
+		uint32_t load = pm_atomic_load(&s->wrcnt);
+		if (best == NULL || load < best_load) {
+			best = s;
+			best_load = load;
+			best_n = n;
+			if (load == 0)
+				break;
+		}
+	}
+	if (best != NULL)
+		p->next = (best_n + 1) % p->size;
+	return best;
+}
+
+static uint32_t
+tnt_pool_random(struct tnt_pool *p)
+{
+	/* xorshift32 */
+	uint32_t x = p->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	p->seed = x;
+	return x;
+}
+
+/* Find connected member starting from n, skipping member skip */
+static int
+tnt_pool_probe(struct tnt_pool *p, int n, int skip)
+{
+	for (int i = 0; i < p->size; i++) {
+		int m = (n + i) % p->size;
+		if (m != skip && TNT_SNET_CAST(p->members[m])->connected)
+			return m;
+	}
+	return -1;
+}
+
+/* Expected completion time of the next request on member */
+static uint64_t
+tnt_pool_cost(struct tnt_stream *s)
+{
+	uint64_t rtt = tnt_rtt(s);
+	return (rtt ? rtt : 1) * ((uint64_t)pm_atomic_load(&s->wrcnt) + 1);
+}
+
+struct tnt_stream *
+tnt_pool_pick(struct tnt_pool *p)
+{
+	int a = tnt_pool_probe(p, tnt_pool_random(p) % p->size, -1);
+	if (a == -1)
+		return NULL;
+	if (p->size == 1)
+		return p->members[a];
+	int b = tnt_pool_probe(p, (a + 1 + tnt_pool_random(p) %
+				   (p->size - 1)) % p->size, a);
+	if (b != -1 && tnt_pool_cost(p->members[b]) <
+		       tnt_pool_cost(p->members[a]))
+		a = b;
+	return p->members[a];
+}
+
+struct tnt_stream *
+tnt_pool_member(struct tnt_pool *p, int n)
+{
+	if (n < 0 || n >= p->size)
+		return NULL;
+	return p->members[n];
+}
+
+int
+tnt_pool_flush(struct tnt_pool *p)
+{
+	int rc = 0;
+	for (int i = 0; i < p->size; i++) {
+		struct tnt_stream *s = p->members[i];
+		if (TNT_SNET_CAST(s)->connected && tnt_flush(s) == -1)
+			rc = -1;
+	}
+	return rc;
+}
+
+int
+tnt_pool_dispatch(struct tnt_pool *p)
+{
+	int processed = 0, rc = 0;
+	for (int i = 0; i < p->size; i++) {
+		struct tnt_stream *s = p->members[i];
+		if (!TNT_SNET_CAST(s)->connected)
+			continue;
+		int n = tnt_async_dispatch(s, 0);
+		if (n == -1)
+			rc = -1;
+		else
+			processed += n;
+	}
+	return (rc == -1) ? -1 : processed;
+}
+
+void
+tnt_pool_close(struct tnt_pool *p)
+{
+	for (int i = 0; i < p->size; i++)
+		tnt_close(p->members[i]);
+}
+
+void
+tnt_pool_free(struct tnt_pool *p)
+{
+	if (p == NULL)
+		return;
+	for (int i = 0; i < p->size; i++)
+		tnt_stream_free(p->members[i]);
+	if (p->members)
+		tnt_mem_free(p->members);
+	tnt_schema_cache_free(p->schema);
+	if (p->alloc)
+		tnt_mem_free(p);
+}
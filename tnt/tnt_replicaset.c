@@ -0,0 +1,418 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/poll.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_select.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_replicaset.h>
+
+#include "tnt_clock.h"
+
+/* position of the first sample in sorted window, that isn't less than usec */
+static uint32_t
+tnt_latency_lower(struct tnt_latency *l, uint32_t usec)
+{
+	uint32_t lo = 0, hi = l->count;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (l->sorted[mid] < usec)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void
+tnt_latency_add(struct tnt_latency *l, uint32_t usec)
+{
+	uint32_t i;
+	if (l->count == TNT_LATENCY_WINDOW) {
+		/* the oldest sample leaves the window */
+		i = tnt_latency_lower(l, l->samples[l->pos]);
+		memmove(l->sorted + i, l->sorted + i + 1,
+			(l->count - i - 1) * sizeof(uint32_t));
+		l->count--;
+	}
+	i = tnt_latency_lower(l, usec);
+	memmove(l->sorted + i + 1, l->sorted + i,
+		(l->count - i) * sizeof(uint32_t));
+	l->sorted[i] = usec;
+	l->count++;
+	l->samples[l->pos] = usec;
+	l->pos = (l->pos + 1) % TNT_LATENCY_WINDOW;
+}
+
+uint32_t
+tnt_latency_percentile(struct tnt_latency *l, double p)
+{
+	if (l->count == 0)
+		return 0;
+	/* nearest rank */
+	uint32_t rank = (uint32_t)(p * l->count + 0.999999);
+	if (rank > l->count)
+		rank = l->count;
+	return l->sorted[rank > 0 ? rank - 1 : 0];
+}
+
+struct tnt_replicaset *
+tnt_replicaset(struct tnt_replicaset *rs, uint32_t count)
+{
+	if (count == 0)
+		return NULL;
+	int alloc = (rs == NULL);
+	if (alloc) {
+		rs = tnt_mem_alloc_tag(sizeof(struct tnt_replicaset),
+				       TNT_MEM_REQUEST);
+		if (rs == NULL)
+			return NULL;
+	}
+	memset(rs, 0, sizeof(struct tnt_replicaset));
+	rs->alloc = alloc;
+	rs->percentile = 0.95;
+	rs->min_delay = 1000;
+	rs->replicas = tnt_mem_alloc_tag(count * sizeof(struct tnt_replica),
+					 TNT_MEM_REQUEST);
+	if (rs->replicas == NULL)
+		goto error;
+	memset(rs->replicas, 0, count * sizeof(struct tnt_replica));
+	for (; rs->count < count; rs->count++) {
+		rs->replicas[rs->count].s = tnt_net(NULL);
+		if (rs->replicas[rs->count].s == NULL)
+			goto error;
+	}
+	return rs;
+error:
+	tnt_replicaset_free(rs);
+	return NULL;
+}
+
+struct tnt_stream *
+tnt_replicaset_member(struct tnt_replicaset *rs, uint32_t n)
+{
+	if (n >= rs->count)
+		return NULL;
+	return rs->replicas[n].s;
+}
+
+int
+tnt_replicaset_connect(struct tnt_replicaset *rs)
+{
+	int connected = 0;
+	for (uint32_t i = 0; i < rs->count; i++) {
+		struct tnt_replica *rp = &rs->replicas[i];
+		rp->failed = (tnt_set(rp->s, TNT_OPT_NONBLOCK, 1) == -1 ||
+			      tnt_connect(rp->s) == -1);
+		if (!rp->failed)
+			connected++;
+	}
+	return connected > 0 ? connected : -1;
+}
+
+int
+tnt_replicaset_hedge(struct tnt_replicaset *rs, double percentile,
+		     uint32_t min_delay)
+{
+	if (!(percentile > 0 && percentile <= 1))
+		return -1;
+	rs->percentile = percentile;
+	rs->min_delay = min_delay;
+	return 0;
+}
+
+uint32_t
+tnt_replicaset_latency(struct tnt_replicaset *rs, uint32_t n, double p)
+{
+	if (n >= rs->count)
+		return 0;
+	return tnt_latency_percentile(&rs->replicas[n].latency, p);
+}
+
+/* Read in flight on one replica */
+struct tnt_replicaset_slot {
+	uint32_t n; /* replica number */
+	uint64_t sync; /* sync of request */
+	uint64_t start; /* send time, usec */
+};
+
+/*
+ * Choose live replica with the lowest median latency, that has no read in
+ * flight. Replicas without samples come first, ties are broken round-robin.
+ */
+static int64_t
+tnt_replicaset_choose(struct tnt_replicaset *rs,
+		      struct tnt_replicaset_slot *slots, uint32_t active)
+{
+	int64_t best = -1;
+	uint32_t best_latency = 0;
+	for (uint32_t i = 0; i < rs->count; i++) {
+		uint32_t n = (rs->next + i) % rs->count;
+		struct tnt_replica *rp = &rs->replicas[n];
+		if (rp->failed || !TNT_SNET_CAST(rp->s)->connected)
+			continue;
+		uint32_t j = 0;
+		while (j < active && slots[j].n != n)
+			j++;
+		if (j < active)
+			continue;
+		uint32_t latency = tnt_latency_percentile(&rp->latency, 0.5);
+		if (best == -1 || latency < best_latency) {
+			best = n;
+			best_latency = latency;
+		}
+	}
+	return best;
+}
+
+/*
+ * Send read to replica.
+ * Returns -1 if request can't be built, 1 if replica has failed.
+ */
+static int
+tnt_replicaset_send(struct tnt_replicaset *rs,
+		    struct tnt_replicaset_slot *slot, uint32_t n,
+		    tnt_replicaset_build_t build, void *arg)
+{
+	struct tnt_replica *rp = &rs->replicas[n];
+	slot->n = n;
+	slot->sync = rp->s->reqid;
+	slot->start = tnt_clock_usec();
+	if (build(rp->s, arg) == -1)
+		return -1;
+	rp->reads++;
+	if (tnt_flush(rp->s) == -1) {
+		rp->failed = 1;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Read available replies of replica, dropping late replies of previous
+ * reads. Returns 0 if reply to slot's request is read, 1 if it isn't
+ * received yet and -1 if replica has failed.
+ */
+static int
+tnt_replicaset_recv(struct tnt_replicaset *rs,
+		    struct tnt_replicaset_slot *slot, struct tnt_reply *r)
+{
+	struct tnt_replica *rp = &rs->replicas[slot->n];
+	while (1) {
+		int rc = rp->s->read_reply(rp->s, r);
+		if (rc == -1)
+			rp->failed = 1;
+		if (rc != 0)
+			return rc;
+		if (r->sync == slot->sync)
+			return 0;
+		if (rp->stale > 0)
+			rp->stale--;
+		tnt_reply_free(r);
+		tnt_reply_init(r);
+	}
+}
+
+/*
+ * Account reply of slot w. Replicas, that have lost, will reply later;
+ * the ones, that were asked before the winner, took at least this long.
+ */
+static void
+tnt_replicaset_win(struct tnt_replicaset *rs,
+		   struct tnt_replicaset_slot *slots, uint32_t active,
+		   uint32_t w)
+{
+	uint64_t now = tnt_clock_usec();
+	for (uint32_t i = 0; i < active; i++) {
+		struct tnt_replica *rp = &rs->replicas[slots[i].n];
+		uint64_t usec = now - slots[i].start;
+		if (usec > UINT32_MAX)
+			usec = UINT32_MAX;
+		if (i == w) {
+			rp->wins++;
+			rs->next = (slots[i].n + 1) % rs->count;
+		} else {
+			rp->stale++;
+		}
+		if (i == w || slots[i].start <= slots[w].start)
+			tnt_latency_add(&rp->latency, usec);
+	}
+}
+
+static uint64_t
+tnt_replicaset_delay(struct tnt_replicaset *rs, uint32_t n)
+{
+	uint32_t delay = tnt_latency_percentile(&rs->replicas[n].latency,
+						rs->percentile);
+	return delay < rs->min_delay ? rs->min_delay : delay;
+}
+
+int
+tnt_replicaset_read(struct tnt_replicaset *rs, tnt_replicaset_build_t build,
+		    void *arg, struct tnt_reply *r)
+{
+	struct tnt_replicaset_slot slots[2];
+	struct pollfd pfds[2];
+	uint32_t active = 0, i;
+	uint64_t deadline = 0;
+	int hedged = 0;
+	tnt_reply_init(r);
+	while (1) {
+		uint64_t now = tnt_clock_usec();
+		if (active == 0 || (!hedged && now >= deadline)) {
+			int64_t n = tnt_replicaset_choose(rs, slots, active);
+			if (n == -1 && active == 0)
+				return -1;
+			if (n == -1) {
+				/* there's no replica to hedge to */
+				hedged = 1;
+				continue;
+			}
+			int rc = tnt_replicaset_send(rs, &slots[active], n,
+						     build, arg);
+			if (rc == -1)
+				goto error;
+			if (rc == 1)
+				continue;
+			if (active == 0) {
+				deadline = slots[0].start +
+					   tnt_replicaset_delay(rs, n);
+				hedged = 0;
+			} else {
+				rs->hedges++;
+				hedged = 1;
+			}
+			active++;
+		}
+		for (i = 0; i < active; i++) {
+			int rc = tnt_replicaset_recv(rs, &slots[i], r);
+			if (rc == 0) {
+				tnt_replicaset_win(rs, slots, active, i);
+				return 0;
+			}
+			if (rc == -1)
+				slots[i--] = slots[--active];
+		}
+		if (active == 0)
+			continue;
+		int timeout = -1;
+		if (!hedged) {
+			now = tnt_clock_usec();
+			if (now >= deadline)
+				continue;
+			timeout = (deadline - now + 999) / 1000;
+		}
+		for (i = 0; i < active; i++) {
+			struct tnt_stream *s = rs->replicas[slots[i].n].s;
+			pfds[i].fd = tnt_fd(s);
+			pfds[i].events = POLLIN |
+				((tnt_wants(s) & TNT_WANT_WRITE) ? POLLOUT : 0);
+			pfds[i].revents = 0;
+		}
+		if (poll(pfds, active, timeout) == -1 && errno != EINTR) {
+			struct tnt_stream_net *sn =
+				TNT_SNET_CAST(rs->replicas[slots[0].n].s);
+			sn->error = TNT_ESYSTEM;
+			sn->errno_ = errno;
+			goto error;
+		}
+		for (i = 0; i < active; i++) {
+			struct tnt_replica *rp = &rs->replicas[slots[i].n];
+			if ((pfds[i].revents & POLLOUT) &&
+			    tnt_flush(rp->s) == -1)
+				rp->failed = 1;
+		}
+	}
+error:
+	/* replies to reads in flight will come later */
+	for (i = 0; i < active; i++)
+		rs->replicas[slots[i].n].stale++;
+	return -1;
+}
+
+struct tnt_replicaset_select_arg {
+	uint32_t space;
+	uint32_t index;
+	uint32_t limit;
+	uint32_t offset;
+	uint8_t iterator;
+	struct tnt_stream *key;
+};
+
+static ssize_t
+tnt_replicaset_select_build(struct tnt_stream *s, void *arg)
+{
+	struct tnt_replicaset_select_arg *a = arg;
+	return tnt_select(s, a->space, a->index, a->limit, a->offset,
+			  a->iterator, a->key);
+}
+
+int
+tnt_replicaset_select(struct tnt_replicaset *rs, uint32_t space,
+		      uint32_t index, uint32_t limit, uint32_t offset,
+		      uint8_t iterator, struct tnt_stream *key,
+		      struct tnt_reply *r)
+{
+	struct tnt_replicaset_select_arg a = {
+		space, index, limit, offset, iterator, key
+	};
+	return tnt_replicaset_read(rs, tnt_replicaset_select_build, &a, r);
+}
+
+void
+tnt_replicaset_close(struct tnt_replicaset *rs)
+{
+	for (uint32_t i = 0; i < rs->count; i++) {
+		tnt_close(rs->replicas[i].s);
+		rs->replicas[i].stale = 0;
+	}
+}
+
+void
+tnt_replicaset_free(struct tnt_replicaset *rs)
+{
+	if (rs == NULL)
+		return;
+	for (uint32_t i = 0; i < rs->count; i++)
+		tnt_stream_free(rs->replicas[i].s);
+	tnt_mem_free(rs->replicas);
+	if (rs->alloc)
+		tnt_mem_free(rs);
+}
@@ -42,7 +42,7 @@
 struct tnt_reply *tnt_reply_init(struct tnt_reply *r) {
 	int alloc = (r == NULL);
 	if (alloc) {
-		r = tnt_mem_alloc(sizeof(struct tnt_reply));
+		r = tnt_mem_alloc_tag(sizeof(struct tnt_reply), TNT_MEM_REPLY);
 		if (!r) return NULL;
 	}
 	memset(r, 0, sizeof(struct tnt_reply));
@@ -52,8 +52,13 @@ struct tnt_reply *tnt_reply_init(struct tnt_reply *r) {
 
 void tnt_reply_free(struct tnt_reply *r) {
 	if (r->buf) {
-		tnt_mem_free((void *)r->buf);
+		if (r->buf_release)
+			r->buf_release(r->buf_owner);
+		else
+			tnt_mem_free((void *)r->buf);
 		r->buf = NULL;
+		r->buf_release = NULL;
+		r->buf_owner = NULL;
 	}
 	if (r->alloc) tnt_mem_free(r);
 }
@@ -70,7 +75,7 @@ int tnt_reply_from(struct tnt_reply *r, tnt_reply_t rcv, void *ptr) {
 	if (mp_typeof(*length) != MP_UINT)
 		goto rollback;
 	size_t size = mp_decode_uint(&data);
-	r->buf = tnt_mem_alloc(size);
+	r->buf = tnt_mem_alloc_tag(size, TNT_MEM_REPLY);
 	r->buf_size = size;
 	if (r->buf == NULL)
 		goto rollback;
@@ -175,7 +180,8 @@ tnt_reply_body0(struct tnt_reply *r, const char *buf, size_t size, size_t *off)
 		   *data = NULL, *data_end = NULL,
 		   *metadata = NULL, *metadata_end = NULL,
 		   *sqlinfo = NULL, *sqlinfo_end = NULL;
-	uint64_t bitmap = 0;
+	uint64_t bitmap = 0, stmt_id = 0;
+	uint32_t bind_count = 0;
 	uint32_t n = mp_decode_map(&p);
 	while (n-- > 0) {
 		uint32_t key = mp_decode_uint(&p);
@@ -212,14 +218,29 @@ tnt_reply_body0(struct tnt_reply *r, const char *buf, size_t size, size_t *off)
 			sqlinfo_end = p;
 			break;
 		}
+		case TNT_STMT_ID: {
+			if (mp_typeof(*p) != MP_UINT)
+				return -1;
+			stmt_id = mp_decode_uint(&p);
+			break;
+		}
+		case TNT_BIND_COUNT: {
+			if (mp_typeof(*p) != MP_UINT)
+				return -1;
+			bind_count = mp_decode_uint(&p);
+			break;
+		}
 		default: {
 			mp_next(&p);
 			break;
 		}
 		}
-		bitmap |= (1ULL << key);
+		if (key < 64)
+			bitmap |= (1ULL << key);
 	}
 	if (r) {
+		r->stmt_id = stmt_id;
+		r->bind_count = bind_count;
 		r->error = error;
 		r->error_end = error_end;
 		r->data = data;
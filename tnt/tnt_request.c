@@ -24,7 +24,8 @@
 struct tnt_request *tnt_request_init(struct tnt_request *req) {
 	int alloc = (req == NULL);
 	if (req == NULL) {
-		req = tnt_mem_alloc(sizeof(struct tnt_request));
+		req = tnt_mem_alloc_tag(sizeof(struct tnt_request),
+					TNT_MEM_REQUEST);
 		if (!req) return NULL;
 	}
 	memset(req, 0, sizeof(struct tnt_request));
@@ -127,6 +128,25 @@ int tnt_request_set_key_format(struct tnt_request *req, const char *fmt, ...)
 	return tnt_request_set_key(req, req->key_object);
 }
 
+int
+tnt_request_set_key_compiled(struct tnt_request *req,
+			     const struct tnt_format *fmt, ...)
+{
+	if (req->key_object)
+		tnt_object_reset(req->key_object);
+	else
+		req->key_object = tnt_object(NULL);
+	if (!req->key_object)
+		return -1;
+	va_list args;
+	va_start(args, fmt);
+	ssize_t res = tnt_format_vexec(req->key_object, fmt, args);
+	va_end(args);
+	if (res == -1)
+		return -1;
+	return tnt_request_set_key(req, req->key_object);
+}
+
 int
 tnt_request_set_func(struct tnt_request *req, const char *func,
 		     uint32_t flen)
@@ -212,6 +232,25 @@ int tnt_request_set_tuple_format(struct tnt_request *req, const char *fmt, ...)
 	return tnt_request_set_tuple(req, req->tuple_object);
 }
 
+int
+tnt_request_set_tuple_compiled(struct tnt_request *req,
+			       const struct tnt_format *fmt, ...)
+{
+	if (req->tuple_object)
+		tnt_object_reset(req->tuple_object);
+	else
+		req->tuple_object = tnt_object(NULL);
+	if (!req->tuple_object)
+		return -1;
+	va_list args;
+	va_start(args, fmt);
+	ssize_t res = tnt_format_vexec(req->tuple_object, fmt, args);
+	va_end(args);
+	if (res == -1)
+		return -1;
+	return tnt_request_set_tuple(req, req->tuple_object);
+}
+
 int
 tnt_request_writeout(struct tnt_stream *s, struct tnt_request *req,
 		     uint64_t *sync) {
@@ -334,3 +373,179 @@ tnt_request_compile(struct tnt_stream *s, struct tnt_request *req) {
 		return -1;
 	return sync;
 }
+
+struct tnt_tmpl *
+tnt_request_template(struct tnt_request *req, struct tnt_tmpl *t)
+{
+	enum tnt_request_t tp = req->hdr.type;
+	switch (tp) {
+	case TNT_OP_SELECT:
+	case TNT_OP_INSERT:
+	case TNT_OP_REPLACE:
+	case TNT_OP_UPDATE:
+	case TNT_OP_DELETE:
+	case TNT_OP_CALL_16:
+	case TNT_OP_EVAL:
+	case TNT_OP_UPSERT:
+	case TNT_OP_CALL:
+	case TNT_OP_PING:
+		break;
+	default:
+		return NULL;
+	}
+	size_t name_len = 0;
+	if ((is_call(tp) || tp == TNT_OP_EVAL) && req->key)
+		name_len = req->key_end - req->key;
+	/* fields (1 + 5 each) and function name (1 + 5 + name_len) */
+	char *body = tnt_mem_alloc_tag(64 + name_len, TNT_MEM_REQUEST);
+	if (body == NULL)
+		return NULL;
+	int alloc = (t == NULL);
+	if (alloc) {
+		t = tnt_mem_alloc_tag(sizeof(struct tnt_tmpl), TNT_MEM_REQUEST);
+		if (t == NULL) {
+			tnt_mem_free(body);
+			return NULL;
+		}
+	}
+	memset(t, 0, sizeof(struct tnt_tmpl));
+	t->alloc = alloc;
+	t->body = body;
+
+	char *pos = t->head;
+	pos = mp_store_u8(pos, 0xce);              /* 1 */
+	pos = mp_store_u32(pos, 0);                /* 4, patched */
+	pos = mp_encode_map(pos, 2);               /* 1 */
+	pos = mp_encode_uint(pos, TNT_CODE);       /* 1 */
+	pos = mp_encode_uint(pos, tp);             /* 1 */
+	pos = mp_encode_uint(pos, TNT_SYNC);       /* 1 */
+	pos = mp_store_u8(pos, 0xcf);              /* 1 */
+	pos = mp_store_u64(pos, 0);                /* 8, patched */
+	assert(pos == t->head + TNT_TMPL_HEAD_SIZE);
+
+	pos = body;
+	char *map = pos++;
+	size_t nd = 0;
+	if (tp < TNT_OP_CALL_16 || tp == TNT_OP_UPSERT) {
+		pos = mp_encode_uint(pos, TNT_SPACE);
+		pos = mp_encode_uint(pos, req->space_id);
+		nd += 1;
+	}
+	if (req->index_id && (tp == TNT_OP_SELECT ||
+			      tp == TNT_OP_UPDATE ||
+			      tp == TNT_OP_DELETE)) {
+		pos = mp_encode_uint(pos, TNT_INDEX);
+		pos = mp_encode_uint(pos, req->index_id);
+		nd += 1;
+	}
+	if (tp == TNT_OP_SELECT) {
+		pos = mp_encode_uint(pos, TNT_LIMIT);
+		pos = mp_encode_uint(pos, req->limit);
+		nd += 1;
+	}
+	if (req->offset && tp == TNT_OP_SELECT) {
+		pos = mp_encode_uint(pos, TNT_OFFSET);
+		pos = mp_encode_uint(pos, req->offset);
+		nd += 1;
+	}
+	if (req->iterator && tp == TNT_OP_SELECT) {
+		pos = mp_encode_uint(pos, TNT_ITERATOR);
+		pos = mp_encode_uint(pos, req->iterator);
+		nd += 1;
+	}
+	switch (tp) {
+	case TNT_OP_EVAL:
+	case TNT_OP_CALL_16:
+	case TNT_OP_CALL:
+		if (req->key == NULL)
+			break;
+		pos = mp_encode_uint(pos, (tp == TNT_OP_EVAL) ?
+					  TNT_EXPRESSION : TNT_FUNCTION);
+		pos = mp_encode_str(pos, req->key, name_len);
+		nd += 1;
+		break;
+	case TNT_OP_SELECT:
+	case TNT_OP_UPDATE:
+	case TNT_OP_DELETE:
+	case TNT_OP_UPSERT:
+		pos = mp_encode_uint(pos, (tp == TNT_OP_UPSERT) ?
+					  TNT_OPS : TNT_KEY);
+		t->key = 1;
+		t->key_off = pos - body;
+		nd += 1;
+		break;
+	default:
+		break;
+	}
+	if (tp != TNT_OP_SELECT && tp != TNT_OP_DELETE && tp != TNT_OP_PING) {
+		pos = mp_encode_uint(pos, TNT_TUPLE);
+		t->tuple = 1;
+		t->tuple_off = pos - body;
+		nd += 1;
+	}
+	if (req->index_base && (tp == TNT_OP_UPDATE || tp == TNT_OP_UPSERT)) {
+		pos = mp_encode_uint(pos, TNT_INDEX_BASE);
+		pos = mp_encode_uint(pos, req->index_base);
+		nd += 1;
+	}
+	assert(mp_sizeof_map(nd) == 1);
+	mp_encode_map(map, nd);
+	t->body_size = pos - body;
+	return t;
+}
+
+int64_t
+tnt_tmpl_write(struct tnt_stream *s, struct tnt_tmpl *t,
+	       struct tnt_stream *key, struct tnt_stream *tuple)
+{
+	static char empty[1] = { (char)0x90 };
+	/* only header is patched, template itself may be sent by reference */
+	char head[TNT_TMPL_HEAD_SIZE];
+	memcpy(head, t->head, TNT_TMPL_HEAD_SIZE);
+	struct iovec v[6]; int v_sz = 0;
+	v[v_sz].iov_base  = head;
+	v[v_sz++].iov_len = TNT_TMPL_HEAD_SIZE;
+	size_t off = 0;
+	if (t->key) {
+		if (t->key_off > off) {
+			v[v_sz].iov_base  = t->body + off;
+			v[v_sz++].iov_len = t->key_off - off;
+			off = t->key_off;
+		}
+		v[v_sz].iov_base  = key ? TNT_SBUF_DATA(key) : empty;
+		v[v_sz++].iov_len = key ? TNT_SBUF_SIZE(key) : sizeof(empty);
+	}
+	if (t->tuple) {
+		if (t->tuple_off > off) {
+			v[v_sz].iov_base  = t->body + off;
+			v[v_sz++].iov_len = t->tuple_off - off;
+			off = t->tuple_off;
+		}
+		v[v_sz].iov_base  = tuple ? TNT_SBUF_DATA(tuple) : empty;
+		v[v_sz++].iov_len = tuple ? TNT_SBUF_SIZE(tuple) : sizeof(empty);
+	}
+	if (t->body_size > off) {
+		v[v_sz].iov_base  = t->body + off;
+		v[v_sz++].iov_len = t->body_size - off;
+	}
+	size_t plen = 0;
+	for (int i = 0; i < v_sz; ++i) plen += v[i].iov_len;
+	/* length prefix isn't counted in request length */
+	mp_store_u32(head + 1, plen - 5);
+	uint64_t sync = s->reqid++;
+	mp_store_u64(head + TNT_TMPL_HEAD_SIZE - 8, sync);
+	if (s->writev(s, v, v_sz) == -1)
+		return -1;
+	return sync;
+}
+
+void
+tnt_tmpl_free(struct tnt_tmpl *t)
+{
+	if (t == NULL)
+		return;
+	tnt_mem_free(t->body);
+	t->body = NULL;
+	if (t->alloc)
+		tnt_mem_free(t);
+}
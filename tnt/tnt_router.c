@@ -0,0 +1,348 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_buf.h>
+#include <tarantool/tnt_select.h>
+#include <tarantool/tnt_insert.h>
+#include <tarantool/tnt_update.h>
+#include <tarantool/tnt_delete.h>
+#include <tarantool/tnt_call.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_router.h>
+
+#include "PMurHash.h"
+#include "pmatomic.h"
+
+struct tnt_router *
+tnt_router(struct tnt_router *r, uint32_t shards, uint32_t buckets)
+{
+	if (shards == 0 || buckets < shards)
+		return NULL;
+	int alloc = (r == NULL);
+	if (alloc) {
+		r = tnt_mem_alloc_tag(sizeof(struct tnt_router),
+				      TNT_MEM_REQUEST);
+		if (r == NULL)
+			return NULL;
+	}
+	memset(r, 0, sizeof(struct tnt_router));
+	r->alloc = alloc;
+	r->buckets = tnt_mem_alloc_tag(buckets * sizeof(uint32_t),
+				       TNT_MEM_REQUEST);
+	r->shards = tnt_mem_alloc_tag(shards * sizeof(struct tnt_stream *),
+				      TNT_MEM_REQUEST);
+	if (r->buckets == NULL || r->shards == NULL)
+		goto error;
+	memset(r->shards, 0, shards * sizeof(struct tnt_stream *));
+	for (; r->bucket_count < buckets; r->bucket_count++)
+		r->buckets[r->bucket_count] = r->bucket_count % shards;
+	for (; r->shard_count < shards; r->shard_count++) {
+		r->shards[r->shard_count] = tnt_net(NULL);
+		if (r->shards[r->shard_count] == NULL)
+			goto error;
+	}
+	return r;
+error:
+	tnt_router_free(r);
+	return NULL;
+}
+
+struct tnt_stream *
+tnt_router_member(struct tnt_router *r, uint32_t n)
+{
+	if (n >= r->shard_count)
+		return NULL;
+	return r->shards[n];
+}
+
+int
+tnt_router_connect(struct tnt_router *r)
+{
+	int rc = 0;
+	for (uint32_t i = 0; i < r->shard_count; i++)
+		if (tnt_connect(r->shards[i]) == -1)
+			rc = -1;
+	return rc;
+}
+
+int
+tnt_router_map(struct tnt_router *r, uint32_t bucket, uint32_t shard)
+{
+	if (bucket >= r->bucket_count || shard >= r->shard_count)
+		return -1;
+	r->buckets[bucket] = shard;
+	return 0;
+}
+
+uint32_t
+tnt_router_bucket(struct tnt_router *r, struct tnt_stream *key)
+{
+	return PMurHash32(r->seed, TNT_SBUF_DATA(key), TNT_SBUF_SIZE(key)) %
+	       r->bucket_count;
+}
+
+struct tnt_stream *
+tnt_router_get(struct tnt_router *r, struct tnt_stream *key)
+{
+	r->last = r->buckets[tnt_router_bucket(r, key)];
+	return r->shards[r->last];
+}
+
+ssize_t
+tnt_router_select(struct tnt_router *r, uint32_t space, uint32_t index,
+		  uint32_t limit, uint32_t offset, uint8_t iterator,
+		  struct tnt_stream *key)
+{
+	return tnt_select(tnt_router_get(r, key), space, index, limit, offset,
+			  iterator, key);
+}
+
+ssize_t
+tnt_router_insert(struct tnt_router *r, uint32_t space,
+		  struct tnt_stream *key, struct tnt_stream *tuple)
+{
+	return tnt_insert(tnt_router_get(r, key), space, tuple);
+}
+
+ssize_t
+tnt_router_replace(struct tnt_router *r, uint32_t space,
+		   struct tnt_stream *key, struct tnt_stream *tuple)
+{
+	return tnt_replace(tnt_router_get(r, key), space, tuple);
+}
+
+ssize_t
+tnt_router_update(struct tnt_router *r, uint32_t space, uint32_t index,
+		  struct tnt_stream *key, struct tnt_stream *ops)
+{
+	return tnt_update(tnt_router_get(r, key), space, index, key, ops);
+}
+
+ssize_t
+tnt_router_delete(struct tnt_router *r, uint32_t space, uint32_t index,
+		  struct tnt_stream *key)
+{
+	return tnt_delete(tnt_router_get(r, key), space, index, key);
+}
+
+ssize_t
+tnt_router_call(struct tnt_router *r, struct tnt_stream *key,
+		const char *proc, size_t plen, struct tnt_stream *args)
+{
+	return tnt_call(tnt_router_get(r, key), proc, plen, args);
+}
+
+int
+tnt_router_flush(struct tnt_router *r)
+{
+	int rc = 0;
+	for (uint32_t i = 0; i < r->shard_count; i++) {
+		struct tnt_stream *s = r->shards[i];
+		if (TNT_SNET_CAST(s)->connected && tnt_flush(s) == -1)
+			rc = -1;
+	}
+	return rc;
+}
+
+/*
+ * Find item by sync of its request among items of one shard, whose syncs
+ * are ascending.
+ */
+static int64_t
+tnt_router_find(const uint64_t *syncs, uint32_t begin, uint32_t end,
+		uint64_t sync)
+{
+	while (begin < end) {
+		uint32_t mid = begin + (end - begin) / 2;
+		if (syncs[mid] == sync)
+			return mid;
+		if (syncs[mid] < sync)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	return -1;
+}
+
+int
+tnt_router_batch(struct tnt_router *r, struct tnt_stream **keys,
+		 uint32_t count, tnt_router_batch_t build, void *arg,
+		 struct tnt_reply *replies)
+{
+	uint32_t i, n;
+	for (i = 0; i < count; i++)
+		tnt_reply_init(&replies[i]);
+	if (count == 0)
+		return 0;
+	/* items are grouped by shard: order[start[n]..start[n + 1]) */
+	struct tnt_mem_stats *stats = TNT_SNET_CAST(r->shards[r->last])->stats;
+	uint32_t *start = tnt_mem_alloc_ex(NULL, stats, (r->shard_count + 1) *
+					   sizeof(uint32_t), TNT_MEM_REQUEST);
+	uint32_t *order = tnt_mem_alloc_ex(NULL, stats, count *
+					   sizeof(uint32_t), TNT_MEM_REQUEST);
+	uint32_t *shard = tnt_mem_alloc_ex(NULL, stats, count *
+					   sizeof(uint32_t), TNT_MEM_REQUEST);
+	uint64_t *syncs = tnt_mem_alloc_ex(NULL, stats, count *
+					   sizeof(uint64_t), TNT_MEM_REQUEST);
+	uint32_t written = 0; /* count of shards, requests are written to */
+	int rc = -1;
+	if (start == NULL || order == NULL || shard == NULL || syncs == NULL) {
+		TNT_SNET_CAST(r->shards[r->last])->error = TNT_EMEMORY;
+		goto cleanup;
+	}
+	memset(start, 0, (r->shard_count + 1) * sizeof(uint32_t));
+	for (i = 0; i < count; i++) {
+		shard[i] = r->buckets[tnt_router_bucket(r, keys[i])];
+		start[shard[i] + 1]++;
+	}
+	for (n = 0; n < r->shard_count; n++) {
+		struct tnt_stream *s = r->shards[n];
+		struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+		if (start[n + 1] > 0 && (sn->nonblock || sn->uring != NULL ||
+					 pm_atomic_load(&s->wrcnt) != 0)) {
+			r->last = n;
+			sn->error = TNT_EBADVAL;
+			goto cleanup;
+		}
+		start[n + 1] += start[n];
+	}
+	for (i = 0; i < count; i++)
+		order[start[shard[i]]++] = i;
+	for (n = r->shard_count; n > 0; n--)
+		start[n] = start[n - 1];
+	start[0] = 0;
+	/* write requests of every shard, then send them all at once */
+	for (n = 0; n < r->shard_count; n++) {
+		struct tnt_stream *s = r->shards[n];
+		r->last = n;
+		written = n + 1;
+		for (i = start[n]; i < start[n + 1]; i++) {
+			syncs[i] = s->reqid;
+			if (build(s, order[i], arg) == -1)
+				goto cleanup;
+		}
+	}
+	for (n = 0; n < r->shard_count; n++) {
+		r->last = n;
+		if (start[n + 1] > start[n] && tnt_flush(r->shards[n]) == -1)
+			goto cleanup;
+	}
+	for (n = 0; n < r->shard_count; n++) {
+		struct tnt_stream *s = r->shards[n];
+		r->last = n;
+		for (i = start[n]; i < start[n + 1]; i++) {
+			struct tnt_reply reply;
+			tnt_reply_init(&reply);
+			if (s->read_reply(s, &reply) != 0)
+				goto cleanup;
+			int64_t k = tnt_router_find(syncs, start[n],
+						    start[n + 1], reply.sync);
+			if (k == -1) {
+				tnt_reply_free(&reply);
+				TNT_SNET_CAST(s)->error = TNT_EFAIL;
+				goto cleanup;
+			}
+			memcpy(&replies[order[k]], &reply,
+			       sizeof(struct tnt_reply));
+		}
+	}
+	rc = 0;
+cleanup:
+	if (rc == -1) {
+		/* requests in flight would fail the next batch */
+		for (n = 0; n < written; n++)
+			if (start[n + 1] > start[n] &&
+			    pm_atomic_load(&r->shards[n]->wrcnt) != 0)
+				tnt_net_drain(r->shards[n]);
+		for (i = 0; i < count; i++) {
+			tnt_reply_free(&replies[i]);
+			tnt_reply_init(&replies[i]);
+		}
+	}
+	tnt_mem_free(start);
+	tnt_mem_free(order);
+	tnt_mem_free(shard);
+	tnt_mem_free(syncs);
+	return rc;
+}
+
+struct tnt_router_select_arg {
+	uint32_t space;
+	uint32_t index;
+	struct tnt_stream **keys;
+};
+
+static ssize_t
+tnt_router_select_build(struct tnt_stream *s, uint32_t n, void *arg)
+{
+	struct tnt_router_select_arg *a = arg;
+	return tnt_select(s, a->space, a->index, UINT32_MAX, 0, TNT_ITER_EQ,
+			  a->keys[n]);
+}
+
+int
+tnt_router_select_batch(struct tnt_router *r, uint32_t space, uint32_t index,
+			struct tnt_stream **keys, uint32_t count,
+			struct tnt_reply *replies)
+{
+	struct tnt_router_select_arg a = { space, index, keys };
+	return tnt_router_batch(r, keys, count, tnt_router_select_build, &a,
+				replies);
+}
+
+void
+tnt_router_close(struct tnt_router *r)
+{
+	for (uint32_t i = 0; i < r->shard_count; i++)
+		tnt_close(r->shards[i]);
+}
+
+void
+tnt_router_free(struct tnt_router *r)
+{
+	if (r == NULL)
+		return;
+	for (uint32_t i = 0; i < r->shard_count; i++)
+		tnt_stream_free(r->shards[i]);
+	tnt_mem_free(r->shards);
+	tnt_mem_free(r->buckets);
+	if (r->alloc)
+		tnt_mem_free(r);
+}
@@ -0,0 +1,166 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include <tarantool/tnt_mem.h>
+
+#include "pmatomic.h"
+#include "tnt_rpool.h"
+
+struct tnt_rpool *
+tnt_rpool_new(size_t cap, struct tnt_mem_ctx *mem,
+	      struct tnt_mem_stats *stats)
+{
+	struct tnt_rpool *p = tnt_mem_alloc_tag(sizeof(struct tnt_rpool),
+						TNT_MEM_REPLY);
+	if (p == NULL)
+		return NULL;
+	memset(p, 0, sizeof(struct tnt_rpool));
+	p->cap = cap;
+	p->refs = 1;
+	p->mem = mem;
+	p->stats = stats;
+	return p;
+}
+
+static void
+tnt_rpool_unref(struct tnt_rpool *p)
+{
+	if (pm_atomic_fetch_sub(&p->refs, 1) == 1)
+		tnt_mem_free(p);
+}
+
+static inline void
+tnt_rpool_lock(struct tnt_rpool *p)
+{
+	while (pm_atomic_exchange(&p->lock, 1) != 0)
+		sched_yield();
+}
+
+static inline void
+tnt_rpool_unlock(struct tnt_rpool *p)
+{
+	pm_atomic_store(&p->lock, 0);
+}
+
+void
+tnt_rpool_free(struct tnt_rpool *p)
+{
+	if (p == NULL)
+		return;
+	struct tnt_rpool_buf *free[TNT_RPOOL_BUCKETS];
+	tnt_rpool_lock(p);
+	memcpy(free, p->free, sizeof(free));
+	memset(p->free, 0, sizeof(p->free));
+	p->cached = 0;
+	/* buffers in use are freed, when they're returned */
+	p->cap = 0;
+	tnt_rpool_unlock(p);
+	for (int i = 0; i < TNT_RPOOL_BUCKETS; ++i) {
+		while (free[i] != NULL) {
+			struct tnt_rpool_buf *b = free[i];
+			free[i] = b->next;
+			tnt_mem_free(b);
+		}
+	}
+	tnt_rpool_unref(p);
+}
+
+static inline int
+tnt_rpool_bucket(size_t size)
+{
+	int n = 0;
+	size_t bsize = (size_t)1 << TNT_RPOOL_MIN_SHIFT;
+	while (bsize < size) {
+		bsize <<= 1;
+		n++;
+	}
+	return n;
+}
+
+char *
+tnt_rpool_get(struct tnt_rpool *p, size_t size, void **owner)
+{
+	int n = tnt_rpool_bucket(size);
+	struct tnt_rpool_buf *b = NULL;
+	if (n < TNT_RPOOL_BUCKETS) {
+		tnt_rpool_lock(p);
+		b = p->free[n];
+		if (b != NULL) {
+			p->free[n] = b->next;
+			p->cached -= b->size;
+			p->hits++;
+		}
+		tnt_rpool_unlock(p);
+	}
+	if (b == NULL) {
+		/* too big buffers aren't rounded, they're never kept */
+		size_t bsize = (n < TNT_RPOOL_BUCKETS) ?
+			(size_t)1 << (TNT_RPOOL_MIN_SHIFT + n) : size;
+		b = tnt_mem_alloc_ex(p->mem, p->stats,
+				     sizeof(struct tnt_rpool_buf) + bsize,
+				     TNT_MEM_REPLY);
+		if (b == NULL)
+			return NULL;
+		b->pool = p;
+		b->size = bsize;
+		pm_atomic_fetch_add(&p->misses, 1);
+	}
+	b->next = NULL;
+	pm_atomic_fetch_add(&p->refs, 1);
+	*owner = b;
+	return (char *)(b + 1);
+}
+
+void
+tnt_rpool_put(void *owner)
+{
+	struct tnt_rpool_buf *b = owner;
+	struct tnt_rpool *p = b->pool;
+	int n = tnt_rpool_bucket(b->size);
+	int keep = 0;
+	if (n < TNT_RPOOL_BUCKETS && b->size == (size_t)1 <<
+	    (TNT_RPOOL_MIN_SHIFT + n)) {
+		tnt_rpool_lock(p);
+		if (p->cached + b->size <= p->cap) {
+			b->next = p->free[n];
+			p->free[n] = b;
+			p->cached += b->size;
+			keep = 1;
+		}
+		tnt_rpool_unlock(p);
+	}
+	if (!keep)
+		tnt_mem_free(b);
+	tnt_rpool_unref(p);
+}
@@ -0,0 +1,55 @@
+#ifndef TNT_RPOOL_H_INCLUDED
+#define TNT_RPOOL_H_INCLUDED
+
+#include <stddef.h>
+
+/*
+ * Pool of reply buffers of a stream. Freed buffers are kept in free lists
+ * by power of two size, until total size of kept buffers reaches the cap.
+ * Every buffer in use holds a reference to the pool, so replies may
+ * outlive the stream. Replies may be freed on any thread: references are
+ * counted atomically and free lists are guarded by a spin lock.
+ */
+
+/* Buckets of 64 bytes, 128 bytes, ..., 16M */
+#define TNT_RPOOL_MIN_SHIFT 6
+#define TNT_RPOOL_BUCKETS 19
+
+struct tnt_mem_ctx;
+struct tnt_mem_stats;
+
+struct tnt_rpool_buf {
+	struct tnt_rpool *pool;
+	struct tnt_rpool_buf *next; /* next free buffer of bucket */
+	size_t size; /* capacity */
+};
+
+struct tnt_rpool {
+	struct tnt_rpool_buf *free[TNT_RPOOL_BUCKETS];
+	size_t cached; /* total capacity of free buffers */
+	size_t cap; /* maximal total capacity of free buffers */
+	int lock; /* guards free lists, cached and hits */
+	int refs; /* stream and buffers in use */
+	struct tnt_mem_ctx *mem;
+	struct tnt_mem_stats *stats;
+	size_t hits; /* count of reused buffers */
+	size_t misses; /* count of allocated buffers */
+};
+
+struct tnt_rpool *
+tnt_rpool_new(size_t cap, struct tnt_mem_ctx *mem,
+	      struct tnt_mem_stats *stats);
+
+/* Drop the stream's reference and every free buffer */
+void
+tnt_rpool_free(struct tnt_rpool *p);
+
+/* Get buffer of at least size bytes; owner is passed to tnt_rpool_put */
+char *
+tnt_rpool_get(struct tnt_rpool *p, size_t size, void **owner);
+
+/* Return buffer to its pool (it's tnt_reply's buf_release) */
+void
+tnt_rpool_put(void *owner);
+
+#endif /* TNT_RPOOL_H_INCLUDED */
@@ -0,0 +1,383 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <msgpuck.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_buf.h>
+#include <tarantool/tnt_object.h>
+#include <tarantool/tnt_select.h>
+#include <tarantool/tnt_schema.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_cursor.h>
+#include <tarantool/tnt_scan.h>
+
+#include "pmatomic.h"
+
+/* default count of tuples per page */
+#define TNT_SCAN_PAGE 1000
+
+struct tnt_scan *
+tnt_scan(struct tnt_scan *sc, uint32_t space, uint32_t index,
+	 uint32_t ranges)
+{
+	if (ranges == 0)
+		return NULL;
+	int alloc = (sc == NULL);
+	if (alloc) {
+		sc = tnt_mem_alloc_tag(sizeof(struct tnt_scan), TNT_MEM_ITER);
+		if (sc == NULL)
+			return NULL;
+	}
+	memset(sc, 0, sizeof(struct tnt_scan));
+	sc->alloc = alloc;
+	sc->space = space;
+	sc->index = index;
+	sc->page = TNT_SCAN_PAGE;
+	sc->ranges = tnt_mem_alloc_tag(ranges * sizeof(struct tnt_scan_range),
+				       TNT_MEM_ITER);
+	if (sc->ranges == NULL) {
+		tnt_scan_free(sc);
+		return NULL;
+	}
+	memset(sc->ranges, 0, ranges * sizeof(struct tnt_scan_range));
+	sc->range_count = ranges;
+	return sc;
+}
+
+void
+tnt_scan_page(struct tnt_scan *sc, uint32_t page)
+{
+	sc->page = (page > 0) ? page : 1;
+}
+
+/*
+ * Copy key into *dst (NULL key makes bound unbounded).
+ */
+static int
+tnt_scan_key(struct tnt_stream **dst, struct tnt_stream *key)
+{
+	if (key == NULL) {
+		if (*dst)
+			tnt_stream_free(*dst);
+		*dst = NULL;
+		return 0;
+	}
+	const char *data = TNT_SBUF_DATA(key);
+	if (TNT_SBUF_SIZE(key) == 0 || mp_typeof(*data) != MP_ARRAY)
+		return -1;
+	if (*dst == NULL && (*dst = tnt_object(NULL)) == NULL)
+		return -1;
+	tnt_object_reset(*dst);
+	if ((*dst)->write(*dst, data, TNT_SBUF_SIZE(key)) == -1)
+		return -1;
+	return 0;
+}
+
+int
+tnt_scan_range(struct tnt_scan *sc, uint32_t n, struct tnt_stream *from,
+	       struct tnt_stream *to)
+{
+	if (n >= sc->range_count)
+		return -1;
+	struct tnt_scan_range *range = &sc->ranges[n];
+	if (tnt_scan_key(&range->from, from) == -1 ||
+	    tnt_scan_key(&range->to, to) == -1)
+		return -1;
+	return 0;
+}
+
+struct tnt_scan_bounds {
+	struct tnt_scan *sc;
+	struct tnt_reply first;
+	struct tnt_reply last;
+};
+
+/*
+ * Select the first and the last tuple of index.
+ */
+static int
+tnt_scan_select_bounds(struct tnt_stream *s, void *arg)
+{
+	struct tnt_scan_bounds *b = arg;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct tnt_stream *key = tnt_object(NULL);
+	if (key == NULL || tnt_object_add_array(key, 0) == -1) {
+		if (key)
+			tnt_stream_free(key);
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	ssize_t rc1 = tnt_select(s, b->sc->space, b->sc->index, 1, 0,
+				 TNT_ITER_ALL, key);
+	ssize_t rc2 = tnt_select(s, b->sc->space, b->sc->index, 1, 0,
+				 TNT_ITER_LE, key);
+	tnt_stream_free(key);
+	if (rc1 == -1 || rc2 == -1 || tnt_flush(s) == -1)
+		return -1;
+	if (s->read_reply(s, &b->first) != 0 ||
+	    s->read_reply(s, &b->last) != 0)
+		return -1;
+	if (b->first.error || b->last.error) {
+		sn->error = TNT_EFAIL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Get the first key part of the only tuple of reply.
+ */
+static const char *
+tnt_scan_first_part(struct tnt_reply *r, uint32_t fieldno)
+{
+	const char *data = r->data;
+	if (data == NULL || mp_typeof(*data) != MP_ARRAY ||
+	    mp_decode_array(&data) == 0 || mp_typeof(*data) != MP_ARRAY)
+		return NULL;
+	if (mp_decode_array(&data) <= fieldno)
+		return NULL;
+	for (uint32_t i = 0; i < fieldno; i++)
+		mp_next(&data);
+	return data;
+}
+
+/*
+ * Encode [lo + off], where lo is negative (if neg) or non-negative value
+ * with magnitude mag.
+ */
+static int
+tnt_scan_bound(struct tnt_stream *key, int neg, uint64_t mag, uint64_t off)
+{
+	tnt_object_reset(key);
+	if (tnt_object_add_array(key, 1) == -1)
+		return -1;
+	ssize_t rc;
+	if (neg && off < mag)
+		rc = tnt_object_add_int(key, -(int64_t )(mag - off - 1) - 1);
+	else
+		rc = tnt_object_add_uint(key, neg ? off - mag : mag + off);
+	if (rc == -1)
+		return -1;
+	tnt_object_container_close(key);
+	return 0;
+}
+
+int
+tnt_scan_split(struct tnt_scan *sc, struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	const struct tnt_schema_ival *def =
+		tnt_schema_index(tnt_net_schema(s), sc->space, sc->index);
+	if (def == NULL || def->part_count == 0) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+	struct tnt_scan_bounds b;
+	b.sc = sc;
+	tnt_reply_init(&b.first);
+	tnt_reply_init(&b.last);
+	struct tnt_stream *lo = NULL, *hi = tnt_object(NULL);
+	int rc = -1;
+	if (hi == NULL) {
+		sn->error = TNT_EMEMORY;
+		goto cleanup;
+	}
+	if (tnt_net_sync(s, tnt_scan_select_bounds, &b) == -1)
+		goto cleanup;
+	const char *min = tnt_scan_first_part(&b.first, def->parts[0]);
+	const char *max = tnt_scan_first_part(&b.last, def->parts[0]);
+	if (min == NULL || max == NULL) {
+		/* index is empty, the first range is the whole index */
+		if (tnt_scan_range(sc, 0, NULL, NULL) == -1 ||
+		    tnt_scan_bound(hi, 0, 0, 0) == -1)
+			goto oom;
+		for (uint32_t n = 1; n < sc->range_count; n++)
+			if (tnt_scan_range(sc, n, hi, hi) == -1)
+				goto oom;
+		rc = 0;
+		goto cleanup;
+	}
+	if ((mp_typeof(*min) != MP_UINT && mp_typeof(*min) != MP_INT) ||
+	    (mp_typeof(*max) != MP_UINT && mp_typeof(*max) != MP_INT)) {
+		sn->error = TNT_EBADVAL;
+		goto cleanup;
+	}
+	/* integers are handled as two's complement, span fits uint64 */
+	int neg = 0;
+	uint64_t vmin, vmax;
+	if (mp_typeof(*min) == MP_UINT) {
+		vmin = mp_decode_uint(&min);
+	} else {
+		int64_t v = mp_decode_int(&min);
+		neg = (v < 0);
+		vmin = (uint64_t )v;
+	}
+	if (mp_typeof(*max) == MP_UINT)
+		vmax = mp_decode_uint(&max);
+	else
+		vmax = (uint64_t )mp_decode_int(&max);
+	uint64_t mag = neg ? (uint64_t )0 - vmin : vmin;
+	uint64_t step = (vmax - vmin) / sc->range_count;
+	for (uint32_t n = 0; n < sc->range_count; n++) {
+		struct tnt_stream *tmp = lo;
+		lo = hi;
+		hi = tmp;
+		if (n + 1 < sc->range_count) {
+			if (hi == NULL && (hi = tnt_object(NULL)) == NULL)
+				goto oom;
+			if (tnt_scan_bound(hi, neg, mag, step * (n + 1)) == -1)
+				goto oom;
+		}
+		if (tnt_scan_range(sc, n, n > 0 ? lo : NULL,
+				   n + 1 < sc->range_count ? hi : NULL) == -1)
+			goto oom;
+	}
+	rc = 0;
+	goto cleanup;
+oom:
+	sn->error = TNT_EMEMORY;
+cleanup:
+	tnt_reply_free(&b.first);
+	tnt_reply_free(&b.last);
+	if (lo)
+		tnt_stream_free(lo);
+	if (hi)
+		tnt_stream_free(hi);
+	return rc;
+}
+
+struct tnt_scan_worker {
+	struct tnt_scan *sc;
+	uint32_t n;
+	struct tnt_stream *s;
+	pthread_t thread;
+};
+
+static void *
+tnt_scan_worker(void *arg)
+{
+	struct tnt_scan_worker *w = arg;
+	struct tnt_scan *sc = w->sc;
+	struct tnt_scan_range *range = &sc->ranges[w->n];
+	struct tnt_stream_net *sn = TNT_SNET_CAST(w->s);
+	struct tnt_cursor c;
+	range->status = -1;
+	if (tnt_cursor(&c, w->s, sc->space, sc->index) == NULL) {
+		sn->error = tnt_schema_index(tnt_net_schema(w->s), sc->space,
+					     sc->index) ?
+			TNT_EMEMORY : TNT_EBADVAL;
+		return NULL;
+	}
+	tnt_cursor_page(&c, sc->page);
+	if (tnt_cursor_range(&c, range->from, range->to) == -1) {
+		sn->error = TNT_EMEMORY;
+		tnt_cursor_free(&c);
+		return NULL;
+	}
+	const char *tuple;
+	size_t size;
+	int rc = 0;
+	while (!pm_atomic_load(&sc->stop) &&
+	       (rc = tnt_cursor_next(&c, &tuple, &size)) == 1) {
+		range->count++;
+		if (sc->cb(tuple, size, w->n, sc->arg) == -1) {
+			pm_atomic_store(&sc->stop, 1);
+			break;
+		}
+	}
+	range->status = (rc == -1) ? -1 : 0;
+	tnt_cursor_free(&c);
+	return NULL;
+}
+
+int
+tnt_scan_run(struct tnt_scan *sc, struct tnt_stream **streams,
+	     tnt_scan_cb_t cb, void *arg)
+{
+	struct tnt_scan_worker *workers = tnt_mem_alloc_tag(
+		sc->range_count * sizeof(struct tnt_scan_worker), TNT_MEM_ITER);
+	if (workers == NULL)
+		return -1;
+	sc->cb = cb;
+	sc->arg = arg;
+	sc->stop = 0;
+	uint32_t n, started = 0;
+	for (n = 0; n < sc->range_count; n++) {
+		sc->ranges[n].count = 0;
+		sc->ranges[n].status = -1;
+	}
+	int rc = 0;
+	for (; started < sc->range_count; started++) {
+		struct tnt_scan_worker *w = &workers[started];
+		w->sc = sc;
+		w->n = started;
+		w->s = streams[started];
+		if (pthread_create(&w->thread, NULL, tnt_scan_worker, w) != 0) {
+			pm_atomic_store(&sc->stop, 1);
+			rc = -1;
+			break;
+		}
+	}
+	for (n = 0; n < started; n++)
+		pthread_join(workers[n].thread, NULL);
+	tnt_mem_free(workers);
+	for (n = 0; n < sc->range_count && rc == 0; n++)
+		if (sc->ranges[n].status == -1)
+			rc = -1;
+	if (rc == 0 && sc->stop)
+		rc = 1;
+	return rc;
+}
+
+void
+tnt_scan_free(struct tnt_scan *sc)
+{
+	if (sc == NULL)
+		return;
+	for (uint32_t n = 0; n < sc->range_count; n++) {
+		if (sc->ranges[n].from)
+			tnt_stream_free(sc->ranges[n].from);
+		if (sc->ranges[n].to)
+			tnt_stream_free(sc->ranges[n].to);
+	}
+	tnt_mem_free(sc->ranges);
+	if (sc->alloc)
+		tnt_mem_free(sc);
+}
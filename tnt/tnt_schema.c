@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <assert.h>
 #include <stdint.h>
+#include <sched.h>
 
 #include <msgpuck.h>
 
@@ -17,10 +18,22 @@
 #include <tarantool/tnt_select.h>
 
 #include "tnt_assoc.h"
+#include "pmatomic.h"
+
+/* cached schema, which is shared by connections */
+struct tnt_schema_cache {
+	struct tnt_schema *current;
+	/* count of readers, that may have loaded current, but haven't
+	 * referenced it yet */
+	int readers;
+};
 
 static inline void
 tnt_schema_ival_free(struct tnt_schema_ival *val) {
-	if (val) tnt_mem_free((void *)val->name);
+	if (val) {
+		tnt_mem_free((void *)val->name);
+		tnt_mem_free(val->parts);
+	}
 	tnt_mem_free(val);
 }
 
@@ -55,8 +68,8 @@ tnt_schema_index_free(struct mh_assoc_t *schema) {
 			mh_assoc_del(schema, index_slot, NULL);
 		} while (0);
 		tnt_schema_ival_free(ival);
-		if (av1) tnt_mem_free((void *)av1);
-		if (av2) tnt_mem_free((void *)av2);
+		tnt_mem_free(av1);
+		tnt_mem_free(av2);
 	}
 }
 
@@ -103,21 +116,23 @@ tnt_schema_space_free(struct mh_assoc_t *schema) {
 			mh_assoc_del(schema, space_slot, NULL);
 		} while (0);
 		tnt_schema_sval_free(sval);
-		if (av1) tnt_mem_free((void *)av1);
-		if (av2) tnt_mem_free((void *)av2);
+		tnt_mem_free(av1);
+		tnt_mem_free(av2);
 	}
 }
 
 static inline int
-tnt_schema_add_space(struct mh_assoc_t *schema, const char **data)
+tnt_schema_add_space(struct tnt_schema *obj, const char **data)
 {
+	struct mh_assoc_t *schema = obj->space_hash;
 	struct tnt_schema_sval *space = NULL;
 	struct assoc_val *space_string = NULL, *space_number = NULL;
 	const char *tuple = *data;
 	if (mp_typeof(*tuple) != MP_ARRAY)
 		goto error;
 	uint32_t tuple_len = mp_decode_array(&tuple); (void )tuple_len;
-	space = tnt_mem_alloc(sizeof(struct tnt_schema_sval));
+	space = tnt_mem_alloc_ex(NULL, obj->stats,
+				 sizeof(struct tnt_schema_sval), TNT_MEM_SCHEMA);
 	if (!space)
 		goto error;
 	memset(space, 0, sizeof(struct tnt_schema_sval));
@@ -128,7 +143,8 @@ tnt_schema_add_space(struct mh_assoc_t *schema, const char **data)
 	if (mp_typeof(*tuple) != MP_STR)
 		goto error;
 	const char *name_tmp = mp_decode_str(&tuple, &space->name_len);
-	space->name = tnt_mem_alloc(space->name_len);
+	space->name = tnt_mem_alloc_ex(NULL, obj->stats, space->name_len,
+				       TNT_MEM_SCHEMA);
 	if (!space->name)
 		goto error;
 	memcpy(space->name, name_tmp, space->name_len);
@@ -136,13 +152,15 @@ tnt_schema_add_space(struct mh_assoc_t *schema, const char **data)
 	space->index = mh_assoc_new();
 	if (!space->index)
 		goto error;
-	space_string = tnt_mem_alloc(sizeof(struct assoc_val));
+	space_string = tnt_mem_alloc_ex(obj->mem, obj->stats,
+					sizeof(struct assoc_val), TNT_MEM_SCHEMA);
 	if (!space_string)
 		goto error;
 	space_string->key.id     = space->name;
 	space_string->key.id_len = space->name_len;
 	space_string->data = space;
-	space_number = tnt_mem_alloc(sizeof(struct assoc_val));
+	space_number = tnt_mem_alloc_ex(obj->mem, obj->stats,
+					sizeof(struct assoc_val), TNT_MEM_SCHEMA);
 	if (!space_number)
 		goto error;
 	space_number->key.id = (void *)&(space->number);
@@ -157,13 +175,12 @@ tnt_schema_add_space(struct mh_assoc_t *schema, const char **data)
 error:
 	mp_next(data);
 	tnt_schema_sval_free(space);
-	if (space_string) tnt_mem_free(space_string);
-	if (space_number) tnt_mem_free(space_number);
+	tnt_mem_free(space_string);
+	tnt_mem_free(space_number);
 	return -1;
 }
 
 int tnt_schema_add_spaces(struct tnt_schema *schema_obj, struct tnt_reply *r) {
-	struct mh_assoc_t *schema = schema_obj->space_hash;
 	const char *tuple = r->data;
 	if (mp_check(&tuple, tuple + (r->data_end - r->data)))
 		return -1;
@@ -172,14 +189,92 @@ int tnt_schema_add_spaces(struct tnt_schema *schema_obj, struct tnt_reply *r) {
 		return -1;
 	uint32_t space_count = mp_decode_array(&tuple);
 	while (space_count-- > 0) {
-		if (tnt_schema_add_space(schema, &tuple))
+		if (tnt_schema_add_space(schema_obj, &tuple))
 			return -1;
 	}
 	return 0;
 }
 
+/*
+ * Decode "unique" flag from index options and field numbers from index
+ * parts. Both the old ([[fieldno, type], ...]) and the new
+ * ([{field = fieldno, type = type, ...}, ...]) parts formats are
+ * understood. Unknown layout leaves index without parts.
+ */
 static inline int
-tnt_schema_add_index(struct mh_assoc_t *schema, const char **data) {
+tnt_schema_index_parts(struct tnt_schema_ival *index, const char *tuple,
+		       struct tnt_mem_stats *stats)
+{
+	if (mp_typeof(*tuple) == MP_MAP) {
+		uint32_t opts = mp_decode_map(&tuple);
+		while (opts-- > 0) {
+			uint32_t klen = 0;
+			const char *k = NULL;
+			if (mp_typeof(*tuple) == MP_STR)
+				k = mp_decode_str(&tuple, &klen);
+			else
+				mp_next(&tuple);
+			if (k && klen == 6 && !memcmp(k, "unique", 6) &&
+			    mp_typeof(*tuple) == MP_BOOL)
+				index->unique = mp_decode_bool(&tuple);
+			else
+				mp_next(&tuple);
+		}
+	} else {
+		mp_next(&tuple);
+	}
+	if (mp_typeof(*tuple) != MP_ARRAY)
+		return 0;
+	uint32_t count = mp_decode_array(&tuple);
+	if (count == 0)
+		return 0;
+	index->parts = tnt_mem_alloc_ex(NULL, stats, count * sizeof(uint32_t),
+					TNT_MEM_SCHEMA);
+	if (!index->parts)
+		return -1;
+	for (uint32_t i = 0; i < count; i++) {
+		const char *part = tuple;
+		mp_next(&tuple);
+		if (mp_typeof(*part) == MP_ARRAY) {
+			if (mp_decode_array(&part) == 0 ||
+			    mp_typeof(*part) != MP_UINT)
+				goto unknown;
+			index->parts[i] = mp_decode_uint(&part);
+			continue;
+		}
+		if (mp_typeof(*part) != MP_MAP)
+			goto unknown;
+		uint32_t size = mp_decode_map(&part);
+		int found = 0;
+		while (size-- > 0 && !found) {
+			uint32_t klen = 0;
+			const char *k = NULL;
+			if (mp_typeof(*part) == MP_STR)
+				k = mp_decode_str(&part, &klen);
+			else
+				mp_next(&part);
+			if (k && klen == 5 && !memcmp(k, "field", 5) &&
+			    mp_typeof(*part) == MP_UINT) {
+				index->parts[i] = mp_decode_uint(&part);
+				found = 1;
+			} else {
+				mp_next(&part);
+			}
+		}
+		if (!found)
+			goto unknown;
+	}
+	index->part_count = count;
+	return 0;
+unknown:
+	tnt_mem_free(index->parts);
+	index->parts = NULL;
+	return 0;
+}
+
+static inline int
+tnt_schema_add_index(struct tnt_schema *obj, const char **data) {
+	struct mh_assoc_t *schema = obj->space_hash;
 	const struct tnt_schema_sval *space = NULL;
 	struct tnt_schema_ival *index = NULL;
 	struct assoc_val *index_number = NULL, *index_string = NULL;
@@ -198,7 +293,8 @@ tnt_schema_add_index(struct mh_assoc_t *schema, const char **data) {
 	if (space_slot == mh_end(schema))
 		return -1;
 	space = (*mh_assoc_node(schema, space_slot))->data;
-	index = tnt_mem_alloc(sizeof(struct tnt_schema_ival));
+	index = tnt_mem_alloc_ex(NULL, obj->stats,
+				 sizeof(struct tnt_schema_ival), TNT_MEM_SCHEMA);
 	if (!index)
 		goto error;
 	memset(index, 0, sizeof(struct tnt_schema_ival));
@@ -208,17 +304,25 @@ tnt_schema_add_index(struct mh_assoc_t *schema, const char **data) {
 	if (mp_typeof(*tuple) != MP_STR)
 		goto error;
 	const char *name_tmp = mp_decode_str(&tuple, &index->name_len);
-	index->name = tnt_mem_alloc(index->name_len);
+	index->name = tnt_mem_alloc_ex(NULL, obj->stats, index->name_len,
+				       TNT_MEM_SCHEMA);
 	if (!index->name)
 		goto error;
 	memcpy((void *)index->name, name_tmp, index->name_len);
+	if (tuple_len >= 6) {
+		mp_next(&tuple); /* skip index type */
+		if (tnt_schema_index_parts(index, tuple, obj->stats) == -1)
+			goto error;
+	}
 
-	index_string = tnt_mem_alloc(sizeof(struct assoc_val));
+	index_string = tnt_mem_alloc_ex(obj->mem, obj->stats,
+					sizeof(struct assoc_val), TNT_MEM_SCHEMA);
 	if (!index_string) goto error;
 	index_string->key.id     = index->name;
 	index_string->key.id_len = index->name_len;
 	index_string->data = index;
-	index_number = tnt_mem_alloc(sizeof(struct assoc_val));
+	index_number = tnt_mem_alloc_ex(obj->mem, obj->stats,
+					sizeof(struct assoc_val), TNT_MEM_SCHEMA);
 	if (!index_number) goto error;
 	index_number->key.id     = (void *)&(index->number);
 	index_number->key.id_len = sizeof(uint32_t);
@@ -231,14 +335,13 @@ tnt_schema_add_index(struct mh_assoc_t *schema, const char **data) {
 	return 0;
 error:
 	mp_next(data);
-	if (index_string) tnt_mem_free(index_string);
-	if (index_number) tnt_mem_free(index_number);
+	tnt_mem_free(index_string);
+	tnt_mem_free(index_number);
 	tnt_schema_ival_free(index);
 	return -1;
 }
 
 int tnt_schema_add_indexes(struct tnt_schema *schema_obj, struct tnt_reply *r) {
-	struct mh_assoc_t *schema = schema_obj->space_hash;
 	const char *tuple = r->data;
 	if (mp_check(&tuple, tuple + (r->data_end - r->data)))
 		return -1;
@@ -247,7 +350,7 @@ int tnt_schema_add_indexes(struct tnt_schema *schema_obj, struct tnt_reply *r) {
 		return -1;
 	uint32_t space_count = mp_decode_array(&tuple);
 	while (space_count-- > 0) {
-		if (tnt_schema_add_index(schema, &tuple))
+		if (tnt_schema_add_index(schema_obj, &tuple))
 			return -1;
 	}
 	return 0;
@@ -283,14 +386,36 @@ int32_t tnt_schema_stoiid(struct tnt_schema *schema_obj, uint32_t sid,
 	return index->number;
 }
 
+const struct tnt_schema_ival *
+tnt_schema_index(struct tnt_schema *schema_obj, uint32_t sid, uint32_t iid)
+{
+	struct mh_assoc_t *schema = schema_obj->space_hash;
+	struct assoc_key space_key = {(void *)&sid, sizeof(uint32_t)};
+	mh_int_t space_slot = mh_assoc_find(schema, &space_key, NULL);
+	if (space_slot == mh_end(schema))
+		return NULL;
+	const struct tnt_schema_sval *space =
+		(*mh_assoc_node(schema, space_slot))->data;
+	struct assoc_key index_key = {(void *)&iid, sizeof(uint32_t)};
+	mh_int_t index_slot = mh_assoc_find(space->index, &index_key, NULL);
+	if (index_slot == mh_end(space->index))
+		return NULL;
+	return (*mh_assoc_node(space->index, index_slot))->data;
+}
+
 struct tnt_schema *tnt_schema_new(struct tnt_schema *s) {
 	int alloc = (s == NULL);
 	if (!s) {
-		s = tnt_mem_alloc(sizeof(struct tnt_schema));
+		s = tnt_mem_alloc_tag(sizeof(struct tnt_schema),
+				      TNT_MEM_SCHEMA);
 		if (!s) return NULL;
 	}
 	s->space_hash = mh_assoc_new();
 	s->alloc = alloc;
+	s->mem = NULL;
+	s->stats = NULL;
+	s->refs = 1;
+	s->version = 0;
 	return s;
 }
 
@@ -305,6 +430,80 @@ void tnt_schema_free(struct tnt_schema *obj) {
 	mh_assoc_delete(obj->space_hash);
 }
 
+struct tnt_schema *
+tnt_schema_ref(struct tnt_schema *sch) {
+	pm_atomic_fetch_add(&sch->refs, 1);
+	return sch;
+}
+
+void
+tnt_schema_unref(struct tnt_schema *sch) {
+	if (sch == NULL || pm_atomic_fetch_sub(&sch->refs, 1) != 1)
+		return;
+	int alloc = sch->alloc;
+	tnt_schema_free(sch);
+	if (alloc)
+		tnt_mem_free(sch);
+}
+
+struct tnt_schema_cache *
+tnt_schema_cache_new(void) {
+	struct tnt_schema_cache *cache = tnt_mem_alloc_tag(
+			sizeof(struct tnt_schema_cache), TNT_MEM_SCHEMA);
+	if (cache == NULL)
+		return NULL;
+	cache->current = NULL;
+	cache->readers = 0;
+	return cache;
+}
+
+void
+tnt_schema_cache_free(struct tnt_schema_cache *cache) {
+	if (cache == NULL)
+		return;
+	tnt_schema_unref(cache->current);
+	tnt_mem_free(cache);
+}
+
+struct tnt_schema *
+tnt_schema_cache_get(struct tnt_schema_cache *cache) {
+	pm_atomic_fetch_add(&cache->readers, 1);
+	struct tnt_schema *sch = pm_atomic_load(&cache->current);
+	if (sch != NULL)
+		pm_atomic_fetch_add(&sch->refs, 1);
+	pm_atomic_fetch_sub(&cache->readers, 1);
+	return sch;
+}
+
+void
+tnt_schema_cache_publish(struct tnt_schema_cache *cache,
+			 struct tnt_schema *sch) {
+	tnt_schema_ref(sch);
+	struct tnt_schema *old = pm_atomic_exchange(&cache->current, sch);
+	/*
+	 * Grace period: reader may have loaded the old snapshot before the
+	 * exchange, so it's released after every such reader has referenced
+	 * it. Readers hold the counter for a few instructions only, but a
+	 * preempted one must get CPU to release it.
+	 */
+	while (pm_atomic_load(&cache->readers) != 0)
+		sched_yield();
+	tnt_schema_unref(old);
+}
+
+struct tnt_schema *
+tnt_schema_cache_renew(struct tnt_schema_cache *cache,
+		       struct tnt_schema *sch) {
+	struct tnt_schema *current = pm_atomic_load_explicit(&cache->current,
+			pm_memory_order_relaxed);
+	if (current == sch || current == NULL)
+		return sch;
+	if ((current = tnt_schema_cache_get(cache)) == NULL)
+		return sch;
+	tnt_schema_unref(sch);
+	return current;
+}
+
 ssize_t
 tnt_get_space(struct tnt_stream *s)
 {
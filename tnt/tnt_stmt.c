@@ -0,0 +1,227 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+
+#include <msgpuck.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_execute.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_stmt.h>
+
+#include "tnt_assoc.h"
+
+/* metadata map keys */
+#define TNT_STMT_FIELD_NAME 0
+#define TNT_STMT_FIELD_TYPE 1
+
+/*
+ * Statement, its columns, metadata and text are allocated as one
+ * block, so metadata is decoded only once, when statement is prepared.
+ */
+static struct tnt_stmt *
+tnt_stmt_new(const char *sql, size_t sql_len, struct tnt_reply *r)
+{
+	uint32_t count = 0;
+	size_t msize = 0;
+	if (r->metadata) {
+		const char *p = r->metadata;
+		count = mp_decode_array(&p);
+		msize = r->metadata_end - r->metadata;
+	}
+	size_t size = sizeof(struct tnt_stmt) +
+		      count * sizeof(struct tnt_stmt_column) + msize + sql_len;
+	struct tnt_stmt *stmt = tnt_mem_alloc_tag(size, TNT_MEM_REQUEST);
+	if (stmt == NULL)
+		return NULL;
+	memset(stmt, 0, sizeof(struct tnt_stmt));
+	stmt->id = r->stmt_id;
+	stmt->bind_count = r->bind_count;
+	stmt->column_count = count;
+	stmt->columns = (struct tnt_stmt_column *)(stmt + 1);
+	char *metadata = (char *)(stmt->columns + count);
+	if (msize > 0)
+		memcpy(metadata, r->metadata, msize);
+	stmt->metadata = metadata;
+	stmt->metadata_size = msize;
+	char *text = metadata + msize;
+	memcpy(text, sql, sql_len);
+	stmt->sql = text;
+	stmt->sql_len = sql_len;
+
+	const char *p = metadata;
+	if (count > 0)
+		mp_decode_array(&p);
+	for (uint32_t i = 0; i < count; ++i) {
+		struct tnt_stmt_column *col = &stmt->columns[i];
+		memset(col, 0, sizeof(struct tnt_stmt_column));
+		if (mp_typeof(*p) != MP_MAP) {
+			mp_next(&p);
+			continue;
+		}
+		uint32_t n = mp_decode_map(&p);
+		while (n-- > 0) {
+			if (mp_typeof(*p) != MP_UINT) {
+				mp_next(&p);
+				mp_next(&p);
+				continue;
+			}
+			uint64_t key = mp_decode_uint(&p);
+			if (mp_typeof(*p) != MP_STR) {
+				mp_next(&p);
+				continue;
+			}
+			switch (key) {
+			case TNT_STMT_FIELD_NAME:
+				col->name = mp_decode_str(&p, &col->name_len);
+				break;
+			case TNT_STMT_FIELD_TYPE:
+				col->type = mp_decode_str(&p, &col->type_len);
+				break;
+			default:
+				mp_next(&p);
+				break;
+			}
+		}
+	}
+	return stmt;
+}
+
+struct tnt_stmt_load {
+	const char *sql;
+	size_t sql_len;
+	struct tnt_stmt *stmt;
+};
+
+static int
+tnt_stmt_load(struct tnt_stream *s, void *arg)
+{
+	struct tnt_stmt_load *ld = arg;
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (tnt_prepare(s, ld->sql, ld->sql_len) == -1 || tnt_flush(s) == -1)
+		return -1;
+	struct tnt_reply r;
+	tnt_reply_init(&r);
+	if (s->read_reply(s, &r) != 0)
+		return -1;
+	if (r.error != NULL || r.stmt_id == 0) {
+		tnt_reply_free(&r);
+		return -1;
+	}
+	ld->stmt = tnt_stmt_new(ld->sql, ld->sql_len, &r);
+	tnt_reply_free(&r);
+	if (ld->stmt == NULL) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	return 0;
+}
+
+const struct tnt_stmt *
+tnt_stmt_prepare(struct tnt_stream *s, const char *sql, size_t len)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sql == NULL || len == 0 || len > UINT32_MAX)
+		return NULL;
+	struct assoc_key key = { sql, (uint32_t)len };
+	if (sn->stmts != NULL) {
+		mh_int_t slot = mh_assoc_find(sn->stmts, &key, NULL);
+		if (slot != mh_end(sn->stmts))
+			return (*mh_assoc_node(sn->stmts, slot))->data;
+	} else {
+		sn->stmts = mh_assoc_new();
+		if (sn->stmts == NULL) {
+			sn->error = TNT_EMEMORY;
+			return NULL;
+		}
+	}
+	struct tnt_stmt_load ld = { sql, len, NULL };
+	if (tnt_net_sync(s, tnt_stmt_load, &ld) == -1) {
+		tnt_mem_free(ld.stmt);
+		return NULL;
+	}
+	struct assoc_val *val = tnt_mem_alloc_tag(sizeof(struct assoc_val),
+						  TNT_MEM_REQUEST);
+	if (val == NULL)
+		goto oom;
+	val->key.id = ld.stmt->sql;
+	val->key.id_len = ld.stmt->sql_len;
+	val->data = ld.stmt;
+	if (mh_assoc_put(sn->stmts, (const struct assoc_val **)&val,
+			 NULL, NULL) == mh_end(sn->stmts))
+		goto oom;
+	return ld.stmt;
+oom:
+	tnt_mem_free(val);
+	tnt_mem_free(ld.stmt);
+	sn->error = TNT_EMEMORY;
+	return NULL;
+}
+
+ssize_t
+tnt_stmt_execute(struct tnt_stream *s, const struct tnt_stmt *stmt,
+		 struct tnt_stream *params)
+{
+	return tnt_execute_id(s, stmt->id, params);
+}
+
+ssize_t
+tnt_execute_prepared(struct tnt_stream *s, const char *sql, size_t len,
+		     struct tnt_stream *params)
+{
+	const struct tnt_stmt *stmt = tnt_stmt_prepare(s, sql, len);
+	if (stmt == NULL)
+		return tnt_execute(s, sql, len, params);
+	return tnt_execute_id(s, stmt->id, params);
+}
+
+void
+tnt_stmt_cache_clear(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	if (sn->stmts == NULL)
+		return;
+	mh_int_t pos = 0;
+	mh_foreach(sn->stmts, pos) {
+		struct assoc_val *val = *mh_assoc_node(sn->stmts, pos);
+		tnt_mem_free(val->data);
+		tnt_mem_free(val);
+	}
+	/* mh_assoc_clear keeps bitmap of used slots, so hash is recreated */
+	mh_assoc_delete(sn->stmts);
+	sn->stmts = NULL;
+}
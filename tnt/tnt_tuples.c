@@ -0,0 +1,283 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+
+#include <msgpuck.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_proto.h>
+#include <tarantool/tnt_reply.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_io.h>
+#include <tarantool/tnt_tuples.h>
+#include <tarantool/tnt_async.h>
+
+#include "pmatomic.h"
+
+/**
+ * \internal
+ * \brief state of reply, that is being read
+ */
+struct tnt_tuples {
+	struct tnt_stream_net *sn;
+	struct tnt_iob *b;
+	size_t rem; /* bytes of reply, that aren't consumed yet */
+	char *keep; /* header and body fields, except of tuples */
+	size_t keep_size;
+	size_t keep_alloc;
+};
+
+/* make sure, that at least size bytes of reply are in receive buffer */
+static int
+tnt_tuples_need(struct tnt_tuples *t, size_t size)
+{
+	struct tnt_iob *b = t->b;
+	if (size > t->rem)
+		size = t->rem;
+	while (b->top - b->off < size) {
+		if (tnt_io_recv_more(t->sn, size - (b->top - b->off)) <= 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* make sure, that the next msgpack value is in buffer, return its size */
+static ssize_t
+tnt_tuples_value(struct tnt_tuples *t)
+{
+	struct tnt_iob *b = t->b;
+	while (1) {
+		size_t avail = b->top - b->off;
+		if (avail > t->rem)
+			avail = t->rem;
+		const char *p = b->buf + b->off;
+		if (avail > 0 && mp_check(&p, b->buf + b->off + avail) == 0)
+			return p - (b->buf + b->off);
+		if (avail == t->rem)
+			return -1;
+		/*
+		 * Wait for twice as much data, so that huge values are
+		 * checked only a few times.
+		 */
+		size_t want = 2 * avail;
+		if (want < TNT_IO_RECV_MIN)
+			want = TNT_IO_RECV_MIN;
+		if (tnt_tuples_need(t, want) == -1)
+			return -1;
+	}
+}
+
+static inline void
+tnt_tuples_consume(struct tnt_tuples *t, size_t size)
+{
+	t->b->off += size;
+	t->rem -= size;
+}
+
+/* append data to t->keep */
+static int
+tnt_tuples_put(struct tnt_tuples *t, const char *data, size_t size)
+{
+	if (t->keep_size + size > t->keep_alloc) {
+		size_t nalloc = t->keep_alloc ? 2 * t->keep_alloc : 256;
+		while (nalloc < t->keep_size + size)
+			nalloc *= 2;
+		char *keep = tnt_mem_realloc_ex(NULL, t->sn->stats, t->keep,
+						nalloc, TNT_MEM_REPLY);
+		if (keep == NULL) {
+			t->sn->error = TNT_EMEMORY;
+			return -1;
+		}
+		t->keep = keep;
+		t->keep_alloc = nalloc;
+	}
+	memcpy(t->keep + t->keep_size, data, size);
+	t->keep_size += size;
+	return 0;
+}
+
+/* copy the next size bytes of reply into t->keep and consume them */
+static int
+tnt_tuples_keep(struct tnt_tuples *t, size_t size)
+{
+	if (tnt_tuples_put(t, t->b->buf + t->b->off, size) == -1)
+		return -1;
+	tnt_tuples_consume(t, size);
+	return 0;
+}
+
+/* pass tuples of TNT_DATA array to callback, dropping them after it */
+static int
+tnt_tuples_data(struct tnt_tuples *t, tnt_tuple_cb_t cb, void *arg)
+{
+	struct tnt_iob *b = t->b;
+	if (tnt_tuples_need(t, 5) == -1)
+		return -1;
+	const char *p = b->buf + b->off;
+	if (t->rem == 0 || mp_typeof(*p) != MP_ARRAY)
+		return -1;
+	uint32_t count = mp_decode_array(&p);
+	tnt_tuples_consume(t, p - (b->buf + b->off));
+	int skip = 0;
+	while (count-- > 0) {
+		ssize_t n = tnt_tuples_value(t);
+		if (n == -1)
+			return -1;
+		if (!skip && cb(b->buf + b->off, n, arg) == -1)
+			skip = 1;
+		tnt_tuples_consume(t, n);
+	}
+	return 0;
+}
+
+/* read body map, keeping all fields except of TNT_DATA */
+static int
+tnt_tuples_body(struct tnt_tuples *t, tnt_tuple_cb_t cb, void *arg)
+{
+	struct tnt_iob *b = t->b;
+	if (tnt_tuples_need(t, 5) == -1)
+		return -1;
+	const char *p = b->buf + b->off;
+	if (mp_typeof(*p) != MP_MAP)
+		return -1;
+	uint32_t count = mp_decode_map(&p);
+	tnt_tuples_consume(t, p - (b->buf + b->off));
+	/* count of kept fields is known at the end, so map32 is used */
+	size_t map = t->keep_size;
+	if (tnt_tuples_put(t, "\xdf\0\0\0\0", 5) == -1)
+		return -1;
+	uint32_t fields = 0;
+	while (count-- > 0) {
+		ssize_t n = tnt_tuples_value(t);
+		if (n == -1)
+			return -1;
+		p = b->buf + b->off;
+		if (mp_typeof(*p) != MP_UINT)
+			return -1;
+		if (mp_decode_uint(&p) == TNT_DATA) {
+			tnt_tuples_consume(t, n);
+			if (tnt_tuples_data(t, cb, arg) == -1)
+				return -1;
+			continue;
+		}
+		if (tnt_tuples_keep(t, n) == -1 ||
+		    (n = tnt_tuples_value(t)) == -1 ||
+		    tnt_tuples_keep(t, n) == -1)
+			return -1;
+		fields++;
+	}
+	mp_store_u32(t->keep + map + 1, fields);
+	return 0;
+}
+
+int
+tnt_reply_tuples(struct tnt_stream *s, struct tnt_reply *r,
+		 tnt_tuple_cb_t cb, void *arg)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	int alloc = r->alloc;
+again:
+	memset(r, 0, sizeof(struct tnt_reply));
+	r->alloc = alloc;
+	/* report requests, that were lost on reconnect, first */
+	if (tnt_net_lost(s, r) == -1)
+		return -1;
+	if (pm_atomic_load(&s->wrcnt) == 0)
+		return 1;
+	if (sn->nonblock || sn->uring) {
+		sn->error = TNT_EBADVAL;
+		return -1;
+	}
+
+	struct tnt_tuples t;
+	memset(&t, 0, sizeof(struct tnt_tuples));
+	t.sn = sn;
+	t.b = &sn->rbuf;
+	t.rem = TNT_REPLY_IPROTO_HDR_SIZE;
+	if (tnt_tuples_need(&t, TNT_REPLY_IPROTO_HDR_SIZE) == -1)
+		return -1;
+	const char *p = t.b->buf + t.b->off;
+	if (mp_typeof(*p) != MP_UINT)
+		return -1;
+	size_t length = mp_decode_uint(&p);
+	tnt_tuples_consume(&t, TNT_REPLY_IPROTO_HDR_SIZE);
+	t.rem = length;
+
+	ssize_t n = tnt_tuples_value(&t);
+	if (n == -1 || tnt_tuples_keep(&t, n) == -1)
+		goto error;
+	size_t hdr_size = t.keep_size;
+	if (tnt_reply_hdr0(r, t.keep, hdr_size, NULL) == -1)
+		goto error;
+	if (tnt_async_pending(s, r->sync)) {
+		/* callback gets the whole reply, as with tnt_async_process */
+		if (tnt_tuples_need(&t, t.rem) == -1 ||
+		    tnt_tuples_keep(&t, t.rem) == -1)
+			goto error;
+		struct tnt_reply ar;
+		tnt_reply_init(&ar);
+		if (tnt_reply_hdr0(&ar, t.keep, hdr_size, NULL) == -1 ||
+		    (t.keep_size > hdr_size &&
+		     tnt_reply_body0(&ar, t.keep + hdr_size,
+				     t.keep_size - hdr_size, NULL) == -1))
+			goto error;
+		ar.buf = t.keep;
+		ar.buf_size = t.keep_size;
+		if (ar.error || (ar.code & TNT_CHUNK) == 0)
+			tnt_net_complete(s, ar.sync);
+		tnt_async_complete(s, &ar);
+		tnt_reply_free(&ar);
+		goto again;
+	}
+	if (t.rem > 0 && tnt_tuples_body(&t, cb, arg) == -1)
+		goto error;
+	if (t.rem > 0)
+		goto error;
+	if (t.keep_size > hdr_size &&
+	    tnt_reply_body0(r, t.keep + hdr_size, t.keep_size - hdr_size,
+			    NULL) == -1)
+		goto error;
+	r->buf = t.keep;
+	r->buf_size = t.keep_size;
+	if (r->error || (r->code & TNT_CHUNK) == 0)
+		tnt_net_complete(s, r->sync);
+	return 0;
+error:
+	tnt_mem_free(t.keep);
+	memset(r, 0, sizeof(struct tnt_reply));
+	r->alloc = alloc;
+	return -1;
+}
@@ -235,7 +235,7 @@ tnt_update_splice(struct tnt_stream *ops, uint32_t fieldno,
 	size_t buf_size = mp_sizeof_uint(position) +
 		          mp_sizeof_uint(offset) +
 			  mp_sizeof_str(buffer_len);
-	char *buf = tnt_mem_alloc(buf_size), *data = NULL;
+	char *buf = tnt_mem_alloc_tag(buf_size, TNT_MEM_REQUEST), *data = NULL;
 	if (!buf) return -1;
 	data = buf;
 	data = mp_encode_uint(data, position);
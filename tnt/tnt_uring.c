@@ -0,0 +1,704 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <tarantool/tnt_mem.h>
+#include <tarantool/tnt_stream.h>
+#include <tarantool/tnt_net.h>
+#include <tarantool/tnt_io.h>
+#include <tarantool/tnt_async.h>
+#include <tarantool/tnt_uring.h>
+
+#ifdef TNT_HAVE_IO_URING
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "pmatomic.h"
+
+#if !defined(MIN)
+#	define MIN(a, b) (a) < (b) ? (a) : (b)
+#endif /* !defined(MIN) */
+
+#ifndef RWF_NOWAIT
+#	define RWF_NOWAIT 0x00000008
+#endif /* RWF_NOWAIT */
+
+/* maximal length of single send/recv */
+#define TNT_URING_IO_MAX (1U << 30)
+
+enum tnt_uring_op {
+	TNT_URING_SEND = 1,
+	TNT_URING_RECV,
+	TNT_URING_CANCEL
+};
+
+#define TNT_URING_DATA(slot, op) (((uint64_t)(slot) << 2) | (op))
+#define TNT_URING_SLOT(data) ((int)((data) >> 2))
+#define TNT_URING_OP(data) ((int)((data) & 3))
+
+/**
+ * \internal
+ * \brief io_uring state of attached stream
+ *
+ * Stream buffers are registered at 2 * slot (sbuf) and 2 * slot + 1 (rbuf).
+ */
+struct tnt_uring_conn {
+	struct tnt_uring *ring;
+	struct tnt_stream *s;
+	int slot; /* index in ring->conns */
+	int send; /* send is in flight */
+	unsigned send_seq; /* position of send entry in submission queue */
+	int recv; /* recv is in flight, rbuf mustn't move */
+	int ready; /* data was received, replies may be dispatched */
+	int failed; /* network error, stream isn't served anymore */
+	int fixed; /* registered buffers are used */
+	struct iovec reg[2]; /* currently registered sbuf and rbuf */
+	struct iovec *iov; /* send queue fragments for sendmsg */
+	int iov_size;
+	struct msghdr msg;
+	struct tnt_iob park[2]; /* sbuf and rbuf of detached stream (s is
+				 * NULL), that kernel may still use */
+};
+
+struct tnt_uring {
+	int fd;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_array;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned tail; /* tail of filled entries, they're submitted up to
+			* sq_head */
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+	int fixed; /* registered buffers table is available */
+	int sends; /* count of sends in flight */
+	int inflight; /* count of all requests in flight */
+	struct tnt_uring_conn **conns;
+	int size; /* capacity of conns */
+};
+
+static int
+tnt_uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+tnt_uring_enter(struct tnt_uring *ring, unsigned submit, unsigned wait)
+{
+	unsigned flags = (wait > 0) ? IORING_ENTER_GETEVENTS : 0;
+	int rc;
+	do {
+		rc = syscall(__NR_io_uring_enter, ring->fd, submit, wait, flags,
+			     NULL, 0);
+	} while (rc == -1 && errno == EINTR);
+	return rc;
+}
+
+static int
+tnt_uring_register(struct tnt_uring *ring, unsigned opcode, void *arg,
+		   unsigned size)
+{
+	return syscall(__NR_io_uring_register, ring->fd, opcode, arg, size);
+}
+
+/**
+ * Register sparse table of buffers, that are filled by streams later.
+ */
+static int
+tnt_uring_register_table(struct tnt_uring *ring)
+{
+#ifdef IORING_RSRC_REGISTER_SPARSE
+	struct io_uring_rsrc_register reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.nr = ring->size * 2;
+	reg.flags = IORING_RSRC_REGISTER_SPARSE;
+	return tnt_uring_register(ring, IORING_REGISTER_BUFFERS2, &reg,
+				  sizeof(reg));
+#else
+	(void)ring;
+	return -1;
+#endif /* IORING_RSRC_REGISTER_SPARSE */
+}
+
+/**
+ * Point registered buffer to new memory, if buffer was moved or resized.
+ * If kernel refuses to register it, stream falls back to plain send/recv.
+ */
+static int
+tnt_uring_update(struct tnt_uring_conn *c, int idx, char *buf, size_t size)
+{
+	if (!c->fixed)
+		return -1;
+	if (c->reg[idx].iov_base == buf && c->reg[idx].iov_len == size)
+		return 0;
+#ifdef IORING_RSRC_REGISTER_SPARSE
+	struct iovec iov = { buf, size };
+	struct io_uring_rsrc_update2 up;
+	memset(&up, 0, sizeof(up));
+	up.offset = c->slot * 2 + idx;
+	up.data = (uintptr_t)&iov;
+	up.nr = 1;
+	if (tnt_uring_register(c->ring, IORING_REGISTER_BUFFERS_UPDATE, &up,
+			       sizeof(up)) == 1) {
+		c->reg[idx] = iov;
+		return 0;
+	}
+#endif /* IORING_RSRC_REGISTER_SPARSE */
+	c->fixed = 0;
+	return -1;
+}
+
+static struct io_uring_sqe *
+tnt_uring_sqe(struct tnt_uring *ring)
+{
+	unsigned head = pm_atomic_load_explicit(ring->sq_head,
+						pm_memory_order_acquire);
+	/* entries, that aren't submitted yet, mustn't be overwritten */
+	if (ring->tail - head == ring->sq_entries)
+		return NULL;
+	unsigned idx = ring->tail & ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+	ring->sq_array[idx] = idx;
+	ring->tail++;
+	ring->inflight++;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	return sqe;
+}
+
+/* whether entry at position seq of submission queue is taken by kernel */
+static int
+tnt_uring_submitted(struct tnt_uring *ring, unsigned seq)
+{
+	unsigned head = pm_atomic_load_explicit(ring->sq_head,
+						pm_memory_order_acquire);
+	return ring->tail - seq > ring->tail - head;
+}
+
+/**
+ * Entries, that kernel hasn't taken (on partial submit, EAGAIN or EBUSY),
+ * stay between sq_head and tail and are submitted on the next call.
+ */
+static int
+tnt_uring_submit(struct tnt_uring *ring, unsigned wait)
+{
+	unsigned head = pm_atomic_load_explicit(ring->sq_head,
+						pm_memory_order_acquire);
+	unsigned submit = ring->tail - head;
+	if (submit == 0 && wait == 0)
+		return 0;
+	pm_atomic_store_explicit(ring->sq_tail, ring->tail,
+				 pm_memory_order_release);
+	if (tnt_uring_enter(ring, submit, wait) == -1 &&
+	    errno != EAGAIN && errno != EBUSY)
+		return -1;
+	return 0;
+}
+
+static void
+tnt_uring_fail(struct tnt_uring_conn *c, int err)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(c->s);
+	sn->error = TNT_ESYSTEM;
+	sn->errno_ = err;
+	c->failed = 1;
+}
+
+/**
+ * Parked connection is freed with buffers, when its last request completes.
+ */
+static void
+tnt_uring_unpark(struct tnt_uring_conn *c, int op)
+{
+	if (op == TNT_URING_SEND) {
+		c->send = 0;
+		c->ring->sends--;
+	} else {
+		c->recv = 0;
+	}
+	if (c->send || c->recv)
+		return;
+	if (c->reg[0].iov_base != NULL)
+		tnt_uring_update(c, 0, NULL, 0);
+	if (c->reg[1].iov_base != NULL)
+		tnt_uring_update(c, 1, NULL, 0);
+	c->ring->conns[c->slot] = NULL;
+	tnt_iob_free(&c->park[0]);
+	tnt_iob_free(&c->park[1]);
+	tnt_mem_free(c->iov);
+	tnt_mem_free(c);
+}
+
+static void
+tnt_uring_complete(struct tnt_uring *ring, uint64_t data, int res)
+{
+	ring->inflight--;
+	if (TNT_URING_OP(data) == TNT_URING_CANCEL)
+		return;
+	struct tnt_uring_conn *c = ring->conns[TNT_URING_SLOT(data)];
+	if (c == NULL)
+		return;
+	if (c->s == NULL) {
+		tnt_uring_unpark(c, TNT_URING_OP(data));
+		return;
+	}
+	struct tnt_stream_net *sn = TNT_SNET_CAST(c->s);
+	if (TNT_URING_OP(data) == TNT_URING_SEND) {
+		c->send = 0;
+		ring->sends--;
+		if (res > 0)
+			tnt_io_sent(sn, res);
+		else if (res < 0 && res != -EAGAIN && res != -EINTR)
+			tnt_uring_fail(c, -res);
+		return;
+	}
+	c->recv = 0;
+	if (res > 0) {
+		sn->rbuf.top += res;
+		c->ready = 1;
+	} else if (res == 0) {
+		tnt_uring_fail(c, ECONNRESET);
+	} else if (res != -EAGAIN && res != -EINTR && res != -ECANCELED) {
+		tnt_uring_fail(c, -res);
+	}
+}
+
+static void
+tnt_uring_reap(struct tnt_uring *ring)
+{
+	unsigned head = *ring->cq_head;
+	unsigned tail = pm_atomic_load_explicit(ring->cq_tail,
+						pm_memory_order_acquire);
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+		tnt_uring_complete(ring, cqe->user_data, cqe->res);
+		head++;
+	}
+	pm_atomic_store_explicit(ring->cq_head, head, pm_memory_order_release);
+}
+
+/**
+ * Send entry, that isn't submitted yet, is filled again, since sbuf may be
+ * moved since then.
+ */
+static struct io_uring_sqe *
+tnt_uring_send_sqe(struct tnt_uring_conn *c)
+{
+	struct tnt_uring *ring = c->ring;
+	if (!c->send) {
+		c->send_seq = ring->tail;
+		return tnt_uring_sqe(ring);
+	}
+	struct io_uring_sqe *sqe = &ring->sqes[c->send_seq & ring->sq_mask];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	return sqe;
+}
+
+/**
+ * Send buffer (or send queue fragments) is written without waiting for
+ * socket, so send completes during submit and sbuf may be modified after.
+ */
+static int
+tnt_uring_prep_send(struct tnt_uring_conn *c)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(c->s);
+	struct io_uring_sqe *sqe;
+	if (sn->sendq.count == 0 &&
+	    tnt_uring_update(c, 0, sn->sbuf.buf, sn->sbuf.size) == 0) {
+		/* queue is full, send is prepared on the next run */
+		if ((sqe = tnt_uring_send_sqe(c)) == NULL)
+			return 0;
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->addr = (uintptr_t)sn->sbuf.buf;
+		sqe->len = MIN(sn->sbuf.off, TNT_URING_IO_MAX);
+		sqe->buf_index = c->slot * 2;
+		sqe->off = -1;
+		sqe->rw_flags = RWF_NOWAIT;
+	} else {
+		int count = MIN(sn->sendq.count > 0 ? sn->sendq.count : 1,
+				getiovmax());
+		if (c->iov_size < count) {
+			struct iovec *iov = tnt_mem_realloc_tag(c->iov,
+					count * sizeof(struct iovec),
+					TNT_MEM_IOB);
+			if (iov == NULL) {
+				sn->error = TNT_EMEMORY;
+				return -1;
+			}
+			c->iov = iov;
+			c->iov_size = count;
+		}
+		memset(&c->msg, 0, sizeof(struct msghdr));
+		c->msg.msg_iov = c->iov;
+		c->msg.msg_iovlen = tnt_io_pending(sn, c->iov, count);
+		if ((sqe = tnt_uring_send_sqe(c)) == NULL)
+			return 0;
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->addr = (uintptr_t)&c->msg;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_DONTWAIT;
+	}
+	sqe->fd = sn->fd;
+	sqe->user_data = TNT_URING_DATA(c->slot, TNT_URING_SEND);
+	if (!c->send)
+		c->ring->sends++;
+	c->send = 1;
+	return 0;
+}
+
+/**
+ * Receive is read directly into free space of rbuf, so replies are parsed
+ * in place as with plain recv (\sa TNT_OPT_ZEROCOPY).
+ */
+static int
+tnt_uring_prep_recv(struct tnt_uring_conn *c)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(c->s);
+	struct tnt_iob *b = &sn->rbuf;
+	if (tnt_iob_reserve(b, TNT_IO_RECV_MIN) == -1) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	int fixed = (tnt_uring_update(c, 1, b->buf, b->size) == 0);
+	struct io_uring_sqe *sqe = tnt_uring_sqe(c->ring);
+	if (sqe == NULL)
+		return 0;
+	sqe->fd = sn->fd;
+	sqe->addr = (uintptr_t)(b->buf + b->top);
+	sqe->len = MIN(b->size - b->top, TNT_URING_IO_MAX);
+	if (fixed) {
+		sqe->opcode = IORING_OP_READ_FIXED;
+		sqe->buf_index = c->slot * 2 + 1;
+		sqe->off = -1;
+	} else {
+		sqe->opcode = IORING_OP_RECV;
+	}
+	sqe->user_data = TNT_URING_DATA(c->slot, TNT_URING_RECV);
+	c->recv = 1;
+	return 0;
+}
+
+struct tnt_uring *
+tnt_uring_new(uint32_t entries)
+{
+	struct tnt_uring *ring = tnt_mem_alloc_tag(sizeof(struct tnt_uring),
+						   TNT_MEM_IOB);
+	if (ring == NULL)
+		return NULL;
+	memset(ring, 0, sizeof(struct tnt_uring));
+	ring->sq_ring = MAP_FAILED;
+	ring->cq_ring = MAP_FAILED;
+	ring->sqes = MAP_FAILED;
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	ring->fd = tnt_uring_setup(entries, &p);
+	if (ring->fd == -1)
+		goto error;
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	ring->cq_ring_size = p.cq_off.cqes +
+			     p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_CQ_RING);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+	    ring->sqes == MAP_FAILED)
+		goto error;
+	char *sq = ring->sq_ring, *cq = ring->cq_ring;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_entries = p.sq_entries;
+	ring->tail = *ring->sq_tail;
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	/* every stream may have send and recv in flight */
+	ring->size = p.sq_entries / 2;
+	ring->conns = tnt_mem_alloc_tag(ring->size * sizeof(*ring->conns),
+					TNT_MEM_IOB);
+	if (ring->conns == NULL)
+		goto error;
+	memset(ring->conns, 0, ring->size * sizeof(*ring->conns));
+	ring->fixed = (tnt_uring_register_table(ring) == 0);
+	return ring;
+error:
+	tnt_uring_free(ring);
+	return NULL;
+}
+
+void
+tnt_uring_free(struct tnt_uring *ring)
+{
+	if (ring == NULL)
+		return;
+	int i;
+	/* parked connections are leaked, kernel may still use buffers */
+	for (i = 0; ring->conns && i < ring->size; i++)
+		if (ring->conns[i] && ring->conns[i]->s)
+			tnt_uring_detach(ring->conns[i]->s);
+	tnt_mem_free(ring->conns);
+	if (ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != MAP_FAILED)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->fd != -1)
+		close(ring->fd);
+	tnt_mem_free(ring);
+}
+
+int
+tnt_uring_attach(struct tnt_uring *ring, struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	int slot;
+	for (slot = 0; slot < ring->size; slot++)
+		if (ring->conns[slot] == NULL)
+			break;
+	if (slot == ring->size) {
+		sn->error = TNT_EBIG;
+		return -1;
+	}
+	if (!sn->nonblock &&
+	    (sn->error = tnt_io_set_nonblock(sn, 1)) != TNT_EOK)
+		return -1;
+	struct tnt_uring_conn *c = tnt_mem_alloc_tag(sizeof(struct tnt_uring_conn),
+						     TNT_MEM_IOB);
+	if (c == NULL) {
+		sn->error = TNT_EMEMORY;
+		return -1;
+	}
+	memset(c, 0, sizeof(struct tnt_uring_conn));
+	c->ring = ring;
+	c->s = s;
+	c->slot = slot;
+	c->fixed = ring->fixed;
+	ring->conns[slot] = c;
+	sn->uring = c;
+	return 0;
+}
+
+/**
+ * Ring can't wait for requests of connection anymore, so buffers, that
+ * kernel may write into or read from, are handed over to connection and
+ * stream gets empty ones.
+ */
+static void
+tnt_uring_park(struct tnt_uring_conn *c)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(c->s);
+	tnt_uring_fail(c, errno);
+	c->park[0] = sn->sbuf;
+	c->park[1] = sn->rbuf;
+	sn->sbuf.buf = sn->rbuf.buf = NULL;
+	sn->sbuf.chunk = sn->rbuf.chunk = NULL;
+	sn->sbuf.size = sn->sbuf.off = sn->sbuf.top = 0;
+	sn->rbuf.size = sn->rbuf.off = sn->rbuf.top = 0;
+	sn->sendq.count = 0;
+	sn->uring = NULL;
+	c->s = NULL;
+}
+
+struct tnt_uring *
+tnt_uring_detach(struct tnt_stream *s)
+{
+	struct tnt_stream_net *sn = TNT_SNET_CAST(s);
+	struct tnt_uring_conn *c = sn->uring;
+	if (c == NULL)
+		return NULL;
+	struct tnt_uring *ring = c->ring;
+	if (c->recv) {
+		struct io_uring_sqe *sqe;
+		/* queue is full, until kernel takes entries */
+		while ((sqe = tnt_uring_sqe(ring)) == NULL) {
+			if (tnt_uring_submit(ring, 0) == -1)
+				break;
+			tnt_uring_reap(ring);
+		}
+		if (sqe != NULL) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = TNT_URING_DATA(c->slot, TNT_URING_RECV);
+			sqe->user_data = TNT_URING_DATA(c->slot,
+							TNT_URING_CANCEL);
+		}
+	}
+	/* buffers may be freed only after recv and send are completed */
+	while (c->recv || c->send) {
+		if (tnt_uring_submit(ring, 1) == -1) {
+			tnt_uring_park(c);
+			return ring;
+		}
+		tnt_uring_reap(ring);
+	}
+	if (c->reg[0].iov_base != NULL)
+		tnt_uring_update(c, 0, NULL, 0);
+	if (c->reg[1].iov_base != NULL)
+		tnt_uring_update(c, 1, NULL, 0);
+	ring->conns[c->slot] = NULL;
+	tnt_mem_free(c->iov);
+	tnt_mem_free(c);
+	sn->uring = NULL;
+	return ring;
+}
+
+int
+tnt_uring_run(struct tnt_uring *ring, int wait)
+{
+	int i;
+	for (i = 0; i < ring->size; i++) {
+		struct tnt_uring_conn *c = ring->conns[i];
+		if (c == NULL || c->failed)
+			continue;
+		struct tnt_stream_net *sn = TNT_SNET_CAST(c->s);
+		/* send, that isn't submitted yet, is refreshed */
+		int send = !c->send ||
+			   !tnt_uring_submitted(ring, c->send_seq);
+		if (send && (sn->sbuf.off > 0 || sn->sendq.count > 0) &&
+		    tnt_uring_prep_send(c) == -1)
+			c->failed = 1;
+		if (!c->recv && !c->failed &&
+		    pm_atomic_load(&c->s->wrcnt) > 0 &&
+		    tnt_uring_prep_recv(c) == -1)
+			c->failed = 1;
+	}
+	/* sends and receives of all streams are submitted at once */
+	if (tnt_uring_submit(ring, (wait && ring->inflight > 0) ? 1 : 0) == -1)
+		return -1;
+	tnt_uring_reap(ring);
+	/*
+	 * Submitted sends don't wait for socket, so they're completed. Sends,
+	 * that kernel hasn't taken, are waited for only if caller may block,
+	 * else they're submitted again on the next run.
+	 */
+	while (wait && ring->sends > 0) {
+		if (tnt_uring_submit(ring, 1) == -1)
+			return -1;
+		tnt_uring_reap(ring);
+	}
+	int processed = 0;
+	for (i = 0; i < ring->size; i++) {
+		struct tnt_uring_conn *c = ring->conns[i];
+		if (c == NULL)
+			continue;
+		struct tnt_stream *s = c->s;
+		if (s == NULL)
+			continue;
+		if (c->failed) {
+			tnt_async_fail(s, TNT_SNET_CAST(s)->error);
+			continue;
+		}
+		if (!c->ready) {
+			/* fail requests, that are past their deadlines */
+			processed += tnt_async_expire(s);
+			continue;
+		}
+		c->ready = 0;
+		/* callbacks may close stream, it detaches connection */
+		int rc = tnt_async_process(s, 0);
+		if (rc == -1) {
+			if (ring->conns[i] == c)
+				c->failed = 1;
+			continue;
+		}
+		processed += rc;
+	}
+	return processed;
+}
+
+#else /* TNT_HAVE_IO_URING */
+
+struct tnt_uring *
+tnt_uring_new(uint32_t entries)
+{
+	(void)entries;
+	errno = ENOSYS;
+	return NULL;
+}
+
+void
+tnt_uring_free(struct tnt_uring *ring)
+{
+	(void)ring;
+}
+
+int
+tnt_uring_run(struct tnt_uring *ring, int wait)
+{
+	(void)ring;
+	(void)wait;
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+tnt_uring_attach(struct tnt_uring *ring, struct tnt_stream *s)
+{
+	(void)ring;
+	TNT_SNET_CAST(s)->error = TNT_EBADVAL;
+	return -1;
+}
+
+struct tnt_uring *
+tnt_uring_detach(struct tnt_stream *s)
+{
+	(void)s;
+	return NULL;
+}
+
+#endif /* TNT_HAVE_IO_URING */
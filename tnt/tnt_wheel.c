@@ -0,0 +1,152 @@
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tnt_wheel.h"
+
+static inline void
+tnt_wheel_link(struct tnt_timer **head, struct tnt_timer *t)
+{
+	t->next = *head;
+	if (t->next != NULL)
+		t->next->pprev = &t->next;
+	t->pprev = head;
+	*head = t;
+}
+
+static inline void
+tnt_wheel_unlink(struct tnt_timer *t)
+{
+	*t->pprev = t->next;
+	if (t->next != NULL)
+		t->next->pprev = t->pprev;
+	t->next = NULL;
+	t->pprev = NULL;
+}
+
+void
+tnt_wheel_init(struct tnt_wheel *w, uint64_t now)
+{
+	memset(w, 0, sizeof(struct tnt_wheel));
+	w->now = now;
+}
+
+/* Put timer into slot by its distance from the current tick */
+static void
+tnt_wheel_place(struct tnt_wheel *w, struct tnt_timer *t)
+{
+	uint64_t expire = t->expire;
+	if (expire < w->now)
+		expire = w->now;
+	uint64_t delta = expire - w->now;
+	int level = 0;
+	while (level < TNT_WHEEL_LEVELS - 1 &&
+	       delta >= (1ULL << (TNT_WHEEL_BITS * (level + 1))))
+		level++;
+	uint64_t max = (1ULL << (TNT_WHEEL_BITS * TNT_WHEEL_LEVELS)) - 1;
+	if (delta > max)
+		expire = w->now + max;
+	uint32_t slot = (expire >> (TNT_WHEEL_BITS * level)) & TNT_WHEEL_MASK;
+	tnt_wheel_link(&w->slots[level][slot], t);
+}
+
+void
+tnt_wheel_add(struct tnt_wheel *w, struct tnt_timer *t, uint64_t expire)
+{
+	t->expire = expire;
+	tnt_wheel_place(w, t);
+	w->count++;
+}
+
+void
+tnt_wheel_del(struct tnt_wheel *w, struct tnt_timer *t)
+{
+	if (t->pprev == NULL)
+		return;
+	tnt_wheel_unlink(t);
+	w->count--;
+}
+
+/* Move timers of slot to lower levels, returns index of slot */
+static uint32_t
+tnt_wheel_cascade(struct tnt_wheel *w, int level)
+{
+	uint32_t slot = (w->now >> (TNT_WHEEL_BITS * level)) & TNT_WHEEL_MASK;
+	struct tnt_timer *t = w->slots[level][slot];
+	w->slots[level][slot] = NULL;
+	while (t != NULL) {
+		struct tnt_timer *next = t->next;
+		tnt_wheel_place(w, t);
+		t = next;
+	}
+	return slot;
+}
+
+void
+tnt_wheel_advance(struct tnt_wheel *w, uint64_t now)
+{
+	if (w->count == 0) {
+		if (now >= w->now)
+			w->now = now + 1;
+		return;
+	}
+	while (w->now <= now) {
+		uint32_t slot = w->now & TNT_WHEEL_MASK;
+		for (int level = 1; slot == 0 && level < TNT_WHEEL_LEVELS;
+		     level++)
+			slot = tnt_wheel_cascade(w, level);
+		slot = w->now & TNT_WHEEL_MASK;
+		while (w->slots[0][slot] != NULL) {
+			struct tnt_timer *t = w->slots[0][slot];
+			tnt_wheel_unlink(t);
+			tnt_wheel_link(&w->expired, t);
+		}
+		w->now++;
+	}
+}
+
+uint64_t
+tnt_wheel_next(struct tnt_wheel *w)
+{
+	if (w->expired != NULL)
+		return w->now - 1;
+	if (w->count == 0)
+		return UINT64_MAX;
+	uint64_t tick = w->now;
+	do {
+		if (w->slots[0][tick & TNT_WHEEL_MASK] != NULL)
+			return tick;
+		tick++;
+	} while ((tick & TNT_WHEEL_MASK) != 0);
+	/* timers of higher levels are cascaded there */
+	return tick;
+}
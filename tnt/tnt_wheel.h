@@ -0,0 +1,48 @@
+#ifndef TNT_WHEEL_H_INCLUDED
+#define TNT_WHEEL_H_INCLUDED
+
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel. Level 0 has a slot per tick, a slot of level n
+ * covers 64^n ticks; timers are moved to lower levels, when the wheel
+ * reaches their slot. Adding, deleting and expiring a timer is O(1).
+ */
+
+#define TNT_WHEEL_BITS   6
+#define TNT_WHEEL_SIZE   (1 << TNT_WHEEL_BITS)
+#define TNT_WHEEL_MASK   (TNT_WHEEL_SIZE - 1)
+#define TNT_WHEEL_LEVELS 4
+
+struct tnt_timer {
+	struct tnt_timer *next;
+	struct tnt_timer **pprev; /* NULL if timer isn't armed */
+	uint64_t expire; /* tick */
+};
+
+struct tnt_wheel {
+	struct tnt_timer *slots[TNT_WHEEL_LEVELS][TNT_WHEEL_SIZE];
+	struct tnt_timer *expired; /* timers, that are due */
+	uint64_t now; /* the next tick to process */
+	uint32_t count; /* count of armed timers */
+};
+
+void
+tnt_wheel_init(struct tnt_wheel *w, uint64_t now);
+
+/* Arm timer to expire at tick expire (not earlier than the next tick) */
+void
+tnt_wheel_add(struct tnt_wheel *w, struct tnt_timer *t, uint64_t expire);
+
+void
+tnt_wheel_del(struct tnt_wheel *w, struct tnt_timer *t);
+
+/* Move timers, that are due at tick now, to w->expired */
+void
+tnt_wheel_advance(struct tnt_wheel *w, uint64_t now);
+
+/* Tick, that the wheel must be advanced to next, UINT64_MAX if empty */
+uint64_t
+tnt_wheel_next(struct tnt_wheel *w);
+
+#endif /* TNT_WHEEL_H_INCLUDED */